@@ -0,0 +1,829 @@
+// Benchmark suite for the per-frame hot paths, from 1e2 to 1e7 items:
+//
+//   orbit   solorsystem06's body placement, recursive and as a flat scene
+//           graph, and the batched Kepler solver behind solorsystem04/05/07
+//   stars   the blackhole01 orbit loop and the blackhole03 StarField step
+//   draw    CircleBatch fill (blackhole01/03, solorsystem06), per-star shapes,
+//           BVH culling (solorsystem06), motion trails (blackhole03) and the
+//           generated starfield background (blackhole02/03)
+//   lens    CPU Schwarzschild tracer and displacement map bake
+//   io      snapshot write and read, trajectory export, sky cache read
+//
+// --gpu adds cases that need a display: per-star window.draw against one
+// batched draw, precessing orbit paths rewritten in their vertex buffer, and
+// the lens_distortion.frag pass, each timed to glFinish.
+//
+// Every case runs until --min-time seconds and at least 5 samples have passed;
+// the results go out as JSON with per-iteration percentiles so runs on the same
+// machine can be compared across releases. Cases whose working set would pass
+// --max-bytes are listed as skipped rather than left to swap.
+//
+//   g++ -O2 -pthread benchmarks/bench_suite.cpp -o benchmarks/bench_suite -lsfml-graphics -lsfml-window -lsfml-system -lGL
+//   ./benchmarks/bench_suite [--filter TEXT] [--min-n N] [--max-n N] [--min-time S] [--max-bytes B]
+//                            [--gpu] [--assets DIR] [--out FILE]
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../common/bvh.hpp"
+#include "../common/circle_batch.hpp"
+#include "../common/displacement_map.hpp"
+#include "../common/kepler.hpp"
+#include "../common/lensing.hpp"
+#include "../common/orbit_paths.hpp"
+#include "../common/scene_graph.hpp"
+#include "../common/simd.hpp"
+#include "../common/sky.hpp"
+#include "../common/snapshot.hpp"
+#include "../common/star_collisions.hpp"
+#include "../common/star_field.hpp"
+#include "../common/task_scheduler.hpp"
+#include "../common/trails.hpp"
+#include "../common/trajectory.hpp"
+
+#ifdef __VERSION__
+#define BENCH_COMPILER __VERSION__
+#else
+#define BENCH_COMPILER "unknown"
+#endif
+
+namespace {
+
+struct Options {
+    std::string filter;
+    std::size_t minN = 100, maxN = 10000000;
+    double minTime = 0.25;
+    double maxBytes = 2e9;
+    bool gpu = false;
+    std::string assets = ".";
+    std::string out;
+};
+
+// Deterministic uniform numbers in [0, 1), the same on every platform.
+struct Random {
+    std::uint64_t state;
+    float next() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return float(state >> 40) * (1.f / 16777216.f);
+    }
+};
+
+// One case: setup(n) builds the state for n items outside the timing and
+// returns the work of one iteration.
+struct Case {
+    std::string group, name;
+    std::function<double(std::size_t)> bytes;   // working set estimate for n items
+    std::function<std::function<void()>(std::size_t)> setup;
+    bool gpu = false;
+};
+
+struct Result {
+    std::string group, name;
+    std::size_t n = 0;
+    std::vector<double> ms;     // one sample per iteration, sorted
+    std::string skipped;
+};
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    const std::size_t rank = std::size_t(std::ceil(p / 100.0 * double(sorted.size())));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+Result measure(const Case& c, std::size_t n, const Options& opt) {
+    using clock = std::chrono::steady_clock;
+    Result r{c.group, c.name, n, {}, {}};
+    if (c.bytes(n) > opt.maxBytes) {
+        r.skipped = "working set over --max-bytes";
+        return r;
+    }
+    std::function<void()> iteration = c.setup(n);
+    if (!iteration) {
+        r.skipped = "setup failed";
+        return r;
+    }
+    iteration(); // warm caches, pools and lazily built tables
+    double total = 0.0;
+    while (r.ms.size() < 5 || (total < opt.minTime && r.ms.size() < 1000)) {
+        const auto t0 = clock::now();
+        iteration();
+        const double s = std::chrono::duration<double>(clock::now() - t0).count();
+        r.ms.push_back(s * 1e3);
+        total += s;
+    }
+    std::sort(r.ms.begin(), r.ms.end());
+    return r;
+}
+
+void writeJson(std::ostream& os, const std::vector<Result>& results) {
+    char stamp[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    os.precision(6);
+    os << "{\n  \"suite\": \"gravity-sims\",\n  \"version\": 1,\n  \"timestamp\": \"" << stamp << "\",\n"
+       << "  \"host\": {\"threads\": " << grav::TaskScheduler::instance().threadCount() << ", \"simd\": \""
+       << grav::simdName(grav::simdLevel()) << "\", \"compiler\": \"" << BENCH_COMPILER << "\"},\n"
+       << "  \"unit\": \"ms\",\n  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        os << (i ? ",\n" : "\n") << "    {\"group\": \"" << r.group << "\", \"name\": \"" << r.name << "\", \"n\": " << r.n;
+        if (!r.skipped.empty()) {
+            os << ", \"skipped\": \"" << r.skipped << "\"}";
+            continue;
+        }
+        double mean = 0.0;
+        for (double v : r.ms) mean += v;
+        mean /= double(r.ms.size());
+        const double p50 = percentile(r.ms, 50);
+        os << ", \"samples\": " << r.ms.size() << ", \"min\": " << r.ms.front() << ", \"p50\": " << p50
+           << ", \"p90\": " << percentile(r.ms, 90) << ", \"p99\": " << percentile(r.ms, 99)
+           << ", \"max\": " << r.ms.back() << ", \"mean\": " << mean
+           << ", \"items_per_s\": " << (p50 > 0.0 ? double(r.n) / (p50 * 1e-3) : 0.0) << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+// --- orbit -----------------------------------------------------------------
+
+// Body positions as solorsystem06's physics thread hands them over.
+struct Snapshot {
+    std::vector<double> x, y;
+};
+
+// The recursive CelestialBody solorsystem06 drew from before its scene graph,
+// cut down to what updatePosition touched; kept as the baseline for scene_graph.
+struct OrbitBody {
+    std::size_t body = 0;
+    const OrbitBody* parent = nullptr;
+    double displayScale = 1.0;
+    sf::Vector2f position;
+    sf::CircleShape shape;
+    std::vector<OrbitBody> moons;
+
+    void updatePosition(const sf::Vector2f& parentPos, const Snapshot& sim) {
+        double dx = sim.x[body];
+        double dy = sim.y[body];
+        if (parent != nullptr) {
+            dx -= sim.x[parent->body];
+            dy -= sim.y[parent->body];
+        }
+        position = parentPos + sf::Vector2f(float(dx * displayScale), float(dy * displayScale));
+        shape.setPosition(position);
+        for (auto& moon : moons)
+            moon.updatePosition(position, sim);
+    }
+};
+
+// A sun, n / 9 planets and eight moons per planet: solorsystem06's hierarchy
+// grown to n bodies.
+Case orbitUpdate() {
+    Case c;
+    c.group = "orbit";
+    c.name = "update_position";
+    c.bytes = [](std::size_t n) { return double(n) * (sizeof(OrbitBody) + 2 * sizeof(double)); };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        struct State {
+            OrbitBody sun;
+            Snapshot sim;
+        };
+        auto s = std::make_shared<State>();
+        Random rng{1};
+        s->sim.x.resize(n);
+        s->sim.y.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            s->sim.x[i] = 400.0 * rng.next();
+            s->sim.y[i] = 400.0 * rng.next();
+        }
+        const std::size_t planets = std::max<std::size_t>(1, (n - 1) / 9);
+        std::size_t next = 1;
+        s->sun.moons.resize(std::min(planets, n - 1));
+        for (OrbitBody& planet : s->sun.moons) {
+            planet.body = next++;
+            planet.parent = &s->sun;
+            planet.shape.setRadius(5.f);
+        }
+        for (std::size_t p = 0; next < n; p = (p + 1) % s->sun.moons.size()) {
+            OrbitBody& planet = s->sun.moons[p];
+            planet.moons.emplace_back();
+            planet.moons.back().body = next++;
+            planet.moons.back().parent = &planet;
+        }
+        return [s] { s->sun.updatePosition(sf::Vector2f(700.f, 500.f), s->sim); };
+    };
+    return c;
+}
+
+// The same hierarchy as a flat SceneGraph, placed and updated the way
+// solorsystem06 does every frame.
+Case sceneGraphUpdate() {
+    Case c;
+    c.group = "orbit";
+    c.name = "scene_graph";
+    c.bytes = [](std::size_t n) { return double(n) * 50.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        struct State {
+            grav::SceneGraph scene;
+            Snapshot sim;
+        };
+        auto s = std::make_shared<State>();
+        Random rng{1};
+        s->sim.x.resize(n);
+        s->sim.y.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            s->sim.x[i] = 400.0 * rng.next();
+            s->sim.y[i] = 400.0 * rng.next();
+        }
+        const std::size_t planets = std::min(std::max<std::size_t>(1, (n - 1) / 9), n - 1);
+        s->scene.reserve(n);
+        s->scene.add(grav::SceneGraph::NO_PARENT);
+        for (std::size_t i = 1; i < n; ++i)
+            s->scene.add(i <= planets ? 0 : std::uint32_t(1 + (i - 1 - planets) % planets));
+        return [s] {
+            // Every body moves every frame, as in an N-body run
+            grav::SceneGraph& scene = s->scene;
+            const Snapshot& sim = s->sim;
+            const float jitter = scene.worldX(0) == 700.f ? 0.5f : 0.f;
+            scene.setLocal(0, 700.f + jitter, 500.f);
+            for (std::uint32_t i = 1; i < scene.size(); ++i) {
+                const std::uint32_t p = scene.parent(i);
+                scene.setLocal(i, float(sim.x[i] - sim.x[p]) + jitter, float(sim.y[i] - sim.y[p]));
+            }
+            scene.update();
+        };
+    };
+    return c;
+}
+
+// Eccentric, inclined orbits evaluated at a new time every iteration, as
+// solorsystem04/05 do once per frame.
+Case keplerPropagate() {
+    Case c;
+    c.group = "orbit";
+    c.name = "kepler_propagate";
+    c.bytes = [](std::size_t n) { return double(n) * 56.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        auto orbits = std::make_shared<grav::KeplerOrbits>();
+        Random rng{7};
+        orbits->reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            orbits->add(50.0 + 400.0 * rng.next(), 0.3 * rng.next(), 50.0 + 5000.0 * rng.next(), 6.283 * rng.next(),
+                        0.3 * rng.next(), 6.283 * rng.next(), 6.283 * rng.next());
+        auto t = std::make_shared<double>(0.0);
+        return [orbits, t] { orbits->propagate(*t += 0.37); };
+    };
+    return c;
+}
+
+// --- stars -----------------------------------------------------------------
+
+// blackhole01: advance every angle on the physics thread, then turn them into
+// screen positions for the snapshot in parallel.
+Case blackhole01Stars() {
+    Case c;
+    c.group = "stars";
+    c.name = "blackhole01_orbits";
+    c.bytes = [](std::size_t n) { return double(n) * 20.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        struct Star {
+            float angle, distance, speed;
+        };
+        struct State {
+            std::vector<Star> stars;
+            std::vector<sf::Vector2f> out;
+        };
+        auto s = std::make_shared<State>();
+        Random rng{2};
+        for (std::size_t i = 0; i < n; ++i)
+            s->stars.push_back({360.f * rng.next(), 150.f + 150.f * rng.next(), 10.f + 40.f * rng.next()});
+        s->out.resize(n);
+        return [s] {
+            const float dt = 0.001f;
+            for (auto& star : s->stars) star.angle += star.speed * dt;
+            const sf::Vector2f hole(400.f, 300.f);
+            grav::TaskScheduler::instance().parallelFor(0, s->stars.size(), 1024, [&](std::size_t first, std::size_t last) {
+                for (std::size_t i = first; i < last; ++i) {
+                    const float rad = s->stars[i].angle * 3.14159f / 180.f;
+                    s->out[i] = hole + sf::Vector2f(std::cos(rad), std::sin(rad)) * s->stars[i].distance;
+                }
+            });
+        };
+    };
+    return c;
+}
+
+// blackhole03: one physics step, the SIMD star update then the collisions.
+Case blackhole03Stars() {
+    Case c;
+    c.group = "stars";
+    c.name = "blackhole03_step";
+    c.bytes = [](std::size_t n) { return double(n) * 64.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        struct State {
+            grav::StarField stars;
+            grav::Hole hole;
+            grav::StarCollisions collisions;
+        };
+        auto s = std::make_shared<State>();
+        Random rng{3};
+        s->stars.reserve(n);
+        s->stars.infallRate = 20.f;
+        s->stars.minRadius = 0.f;
+        for (std::size_t i = 0; i < n; ++i)
+            s->stars.add(360.f * rng.next(), 150.f + 150.f * rng.next(), 0.6f + rng.next() / 3.f, 255.f,
+                         std::uint32_t(i * 2654435761u + 1), 0.1f + 1.9f * rng.next());
+        s->hole.x = 400.f;
+        s->hole.y = 300.f;
+        s->stars.update(0.f, s->hole.x, s->hole.y);
+        return [s] {
+            grav::TaskScheduler::instance().parallelFor(0, s->stars.size(), 16384, [&](std::size_t first, std::size_t last) {
+                s->stars.update(0.001f, s->hole.x, s->hole.y, first, last);
+            });
+            s->collisions.resolve(s->stars, s->hole);
+        };
+    };
+    return c;
+}
+
+// --- draw ------------------------------------------------------------------
+
+std::vector<sf::Vector2f> scatter(std::size_t n, unsigned side, std::uint64_t seed) {
+    Random rng{seed};
+    std::vector<sf::Vector2f> p(n);
+    for (auto& v : p) v = sf::Vector2f(float(side) * rng.next(), float(side) * rng.next());
+    return p;
+}
+
+// The frame loop's submission work: every 2 px star tessellated into one
+// vertex array. Without --gpu this is the CPU side only.
+Case batchFill() {
+    Case c;
+    c.group = "draw";
+    c.name = "circle_batch_fill";
+    c.bytes = [](std::size_t n) {
+        return double(n) * (3.0 * grav::CircleBatch::segmentsFor(2.f) * sizeof(sf::Vertex) + sizeof(sf::Vector2f));
+    };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        auto stars = std::make_shared<std::vector<sf::Vector2f>>(scatter(n, 1000, 4));
+        auto batch = std::make_shared<grav::CircleBatch>();
+        return [stars, batch] {
+            batch->clear();
+            for (const sf::Vector2f& p : *stars) batch->addDisc(p, 2.f, sf::Color::White);
+        };
+    };
+    return c;
+}
+
+// n moving bodies spread over a field 100 windows wide, with the window on one
+// corner of it: refitting the CircleBvh and finding what the window shows, as
+// solorsystem06 does every frame before batching.
+Case cullVisible() {
+    Case c;
+    c.group = "draw";
+    c.name = "bvh_cull";
+    c.bytes = [](std::size_t n) { return double(n) * 40.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        struct State {
+            std::vector<sf::Vector2f> pos;
+            grav::CircleBvh tree;
+            std::size_t visible = 0;
+        };
+        auto s = std::make_shared<State>();
+        s->pos = scatter(n, 100000, 5);
+        return [s] {
+            for (sf::Vector2f& p : s->pos) p.x += 0.01f;
+            s->tree.update(s->pos.size(), [&](std::uint32_t i) {
+                return grav::CircleBvh::Circle{s->pos[i].x, s->pos[i].y, 2.f};
+            });
+            s->visible = 0;
+            s->tree.query({0.f, 0.f, 1400.f, 1000.f}, 2.f, [&](std::uint32_t) { ++s->visible; },
+                          [&](float, float, std::uint32_t, std::uint32_t) { ++s->visible; });
+        };
+    };
+    return c;
+}
+
+// One frame of 64-sample trails on n moving bodies: pushing their positions
+// into the ring and rebuilding the faded strip, as blackhole03 does.
+Case trailFrame() {
+    Case c;
+    c.group = "draw";
+    c.name = "trail_push_build";
+    c.bytes = [](std::size_t n) { return double(n) * 64.0 * (2.0 * sizeof(float) + sizeof(sf::Vertex)); };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        struct State {
+            std::vector<float> x, y;
+            grav::Trails trails;
+        };
+        auto s = std::make_shared<State>();
+        for (const sf::Vector2f& p : scatter(n, 1000, 6)) {
+            s->x.push_back(p.x);
+            s->y.push_back(p.y);
+        }
+        s->trails.reset(n, 64);
+        return [s] {
+            for (float& x : s->x) x += 0.5f;
+            s->trails.push(s->x.data(), s->y.data());
+            s->trails.build(s->x.data(), s->y.data(), [](std::size_t) { return sf::Color(255, 255, 200); });
+        };
+    };
+    return c;
+}
+
+// What the per-star window.draw loop paid before batching, minus the driver:
+// positioning one shape per star.
+Case shapeSetup() {
+    Case c;
+    c.group = "draw";
+    c.name = "circle_shape_setup";
+    c.bytes = [](std::size_t n) { return double(n) * sizeof(sf::Vector2f); };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        auto stars = std::make_shared<std::vector<sf::Vector2f>>(scatter(n, 1000, 5));
+        auto shape = std::make_shared<sf::CircleShape>(2.f);
+        auto sink = std::make_shared<float>(0.f);
+        return [stars, shape, sink] {
+            for (const sf::Vector2f& p : *stars) {
+                shape->setPosition(p);
+                *sink += shape->getTransform().getMatrix()[12];
+            }
+        };
+    };
+    return c;
+}
+
+// Offscreen target shared by the GPU cases; created on first use.
+sf::RenderTexture* gpuTarget(unsigned side) {
+    static std::unique_ptr<sf::RenderTexture> target;
+    static unsigned size = 0;
+    if (!target || size != side) {
+        target = std::make_unique<sf::RenderTexture>();
+        if (!target->create(side, side)) {
+            target.reset();
+            return nullptr;
+        }
+        size = side;
+    }
+    target->setActive(true);
+    return target.get();
+}
+
+Case gpuDraw(bool batched) {
+    Case c;
+    c.group = "draw";
+    c.name = batched ? "circle_batch_gpu" : "circle_shape_gpu";
+    c.gpu = true;
+    c.bytes = [batched](std::size_t n) {
+        return double(n) * (batched ? 3.0 * grav::CircleBatch::segmentsFor(2.f) * sizeof(sf::Vertex) : 0.0) +
+               double(n) * sizeof(sf::Vector2f);
+    };
+    c.setup = [batched](std::size_t n) -> std::function<void()> {
+        sf::RenderTexture* target = gpuTarget(1024);
+        if (!target) return {};
+        auto stars = std::make_shared<std::vector<sf::Vector2f>>(scatter(n, 1024, 6));
+        if (batched) {
+            auto batch = std::make_shared<grav::CircleBatch>();
+            return [target, stars, batch] {
+                target->clear();
+                batch->clear();
+                for (const sf::Vector2f& p : *stars) batch->addDisc(p, 2.f, sf::Color::White);
+                batch->draw(*target);
+                glFinish();
+            };
+        }
+        auto shape = std::make_shared<sf::CircleShape>(2.f);
+        return [target, stars, shape] {
+            target->clear();
+            for (const sf::Vector2f& p : *stars) {
+                shape->setPosition(p);
+                target->draw(*shape);
+            }
+            glFinish();
+        };
+    };
+    return c;
+}
+
+// n precessing orbits around one centre, as solorsystem04/05 draw them, each
+// turned far enough per iteration that setTime() rewrites every one.
+Case orbitPrecess() {
+    Case c;
+    c.group = "draw";
+    c.name = "orbit_precess_gpu";
+    c.gpu = true;
+    c.bytes = [](std::size_t n) { return double(n) * 2.0 * 64.0 * sizeof(sf::Vertex); };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        sf::RenderTexture* target = gpuTarget(1024);
+        if (!target) return {};
+        auto orbits = std::make_shared<grav::KeplerOrbits>();
+        auto paths = std::make_shared<grav::OrbitPaths>();
+        Random rng{7};
+        orbits->reserve(n);
+        const std::size_t group = paths->addGroup(sf::Vector2f(512.f, 512.f));
+        for (std::size_t i = 0; i < n; ++i) {
+            orbits->add(50.0 + 400.0 * rng.next(), 0.3 * rng.next(), 50.0 + 5000.0 * rng.next(), 6.283 * rng.next(),
+                        0.0, 6.283 * rng.next(), 0.0, 0.01);
+            paths->add(group, *orbits, i, sf::Color(80, 80, 80));
+        }
+        auto t = std::make_shared<double>(0.0);
+        return [target, paths, t] {
+            target->clear();
+            paths->setTime(*t += 1.0);
+            paths->draw(*target);
+            glFinish();
+        };
+    };
+    return c;
+}
+
+// --- lens ------------------------------------------------------------------
+
+unsigned sideFor(std::size_t pixels) { return std::max(8u, unsigned(std::lround(std::sqrt(double(pixels))))); }
+
+// n is the pixel count of a square frame.
+Case lensTrace() {
+    Case c;
+    c.group = "lens";
+    c.name = "cpu_trace";
+    c.bytes = [](std::size_t n) { return double(n) * 8.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        const unsigned side = sideFor(n);
+        auto tracer = std::make_shared<grav::LensTracer>();
+        std::vector<std::uint32_t> background(std::size_t(side) * side);
+        Random rng{7};
+        for (auto& p : background) p = std::uint32_t(rng.next() * 16777216.f) | 0xff000000u;
+        tracer->setBackground(background.data(), int(side), int(side));
+        tracer->schwarzschildRadius = float(side) / 50.f;
+        tracer->sourceDistance = float(side) / 2.f;
+        auto out = std::make_shared<std::vector<std::uint32_t>>(background.size());
+        return [tracer, out, side] { tracer->render(float(side) / 2.f, float(side) / 2.f, out->data()); };
+    };
+    return c;
+}
+
+grav::LensParams lensFor(std::size_t n) {
+    grav::LensParams p;
+    p.profile = grav::LensProfile::Inverse;
+    p.strength = 0.25f;
+    p.softening = 0.1f;
+    p.width = p.height = sideFor(n);
+    return p;
+}
+
+// The map is 2 x 2 screens, so n screen pixels bake 4n texels.
+Case lensBake() {
+    Case c;
+    c.group = "lens";
+    c.name = "displacement_bake";
+    c.bytes = [](std::size_t n) { return double(n) * 48.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        const grav::LensParams p = lensFor(n);
+        return [p] { grav::DisplacementMap::bake(p); };
+    };
+    return c;
+}
+
+grav::SkyParams skyFor(std::size_t n) {
+    grav::SkyParams p;
+    p.width = p.height = sideFor(n);
+    p.nebula = 0.5f;
+    return p;
+}
+
+// blackhole03's background: stars and a five-layer nebula over n pixels.
+Case skyRender() {
+    Case c;
+    c.group = "draw";
+    c.name = "sky_render";
+    c.bytes = [](std::size_t n) { return double(n) * 4.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        const grav::SkyParams p = skyFor(n);
+        return [p] { grav::SkyImage::render(p); };
+    };
+    return c;
+}
+
+// blackhole02's post-process: the scene through lens_distortion.frag.
+Case lensShader(const std::string& assets) {
+    Case c;
+    c.group = "lens";
+    c.name = "shader_pass_gpu";
+    c.gpu = true;
+    c.bytes = [](std::size_t n) { return double(n) * 24.0; };
+    c.setup = [assets](std::size_t n) -> std::function<void()> {
+        const unsigned side = sideFor(n);
+        if (side > sf::Texture::getMaximumSize() / 2) return {};
+        sf::RenderTexture* target = gpuTarget(side);
+        if (!target) return {};
+        struct State {
+            sf::Shader shader;
+            sf::Texture scene, map;
+            float range = 1.f;
+        };
+        auto s = std::make_shared<State>();
+        if (!s->shader.loadFromFile(assets + "/blackhole02/lens_distortion.frag", sf::Shader::Fragment)) return {};
+        const grav::DisplacementMap map = grav::DisplacementMap::bake(lensFor(n));
+        std::vector<std::uint8_t> pixels(std::size_t(side) * side * 4);
+        Random rng{8};
+        for (auto& v : pixels) v = std::uint8_t(255.f * rng.next());
+        if (!s->scene.create(side, side) || !s->map.create(map.width(), map.height())) return {};
+        s->scene.update(pixels.data());
+        s->map.update(map.pixels());
+        s->shader.setUniform("texture", s->scene);
+        s->shader.setUniform("displacement", s->map);
+        s->shader.setUniform("displacementRange", map.range());
+        s->shader.setUniform("resolution", sf::Vector2f(float(side), float(side)));
+        s->shader.setUniform("blackHolePos", sf::Vector2f(float(side) / 2.f, float(side) / 2.f));
+        s->shader.setUniform("time", 0.f);
+        return [target, s] {
+            sf::Sprite sprite(s->scene);
+            target->draw(sprite, &s->shader);
+            glFinish();
+        };
+    };
+    return c;
+}
+
+// --- io --------------------------------------------------------------------
+
+std::string scratchPath(const std::string& name) {
+    std::error_code ec;
+    const std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+    return ((ec ? std::filesystem::path(".") : dir) / name).string();
+}
+
+// A 2-D N-body state the size of n bodies: what a checkpoint holds.
+struct BodyColumns {
+    std::vector<double> px, py, vx, vy, mass;
+    explicit BodyColumns(std::size_t n) : px(n), py(n), vx(n), vy(n), mass(n) {
+        Random rng{9};
+        for (std::size_t i = 0; i < n; ++i) {
+            px[i] = rng.next();
+            py[i] = rng.next();
+            vx[i] = rng.next();
+            vy[i] = rng.next();
+            mass[i] = rng.next();
+        }
+    }
+};
+
+// Written, synced and renamed into place, as a checkpoint is.
+Case snapshotWrite() {
+    Case c;
+    c.group = "io";
+    c.name = "snapshot_write";
+    c.bytes = [](std::size_t n) { return double(n) * 40.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        auto state = std::make_shared<BodyColumns>(n);
+        const std::string path = scratchPath("bench_suite.snap");
+        return [state, path] {
+            grav::SnapshotWriter out;
+            out.info.count = state->px.size();
+            out.info.dims = 2;
+            out.column("pos0", state->px);
+            out.column("pos1", state->py);
+            out.column("vel0", state->vx);
+            out.column("vel1", state->vy);
+            out.column("mass", state->mass);
+            if (!out.write(path)) std::cerr << "Failed to write " << path << "\n";
+        };
+    };
+    return c;
+}
+
+// Mapped and copied column by column, as a restart reads it.
+Case snapshotRead() {
+    Case c;
+    c.group = "io";
+    c.name = "snapshot_read";
+    c.bytes = [](std::size_t n) { return double(n) * 80.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        const std::string path = scratchPath("bench_suite_read.snap");
+        {
+            BodyColumns state(n);
+            grav::SnapshotWriter out;
+            out.info.count = n;
+            out.column("pos0", state.px);
+            out.column("pos1", state.py);
+            out.column("vel0", state.vx);
+            out.column("vel1", state.vy);
+            out.column("mass", state.mass);
+            if (!out.write(path)) return {};
+        }
+        auto into = std::make_shared<std::vector<double>>();
+        return [path, into] {
+            grav::SnapshotFile in(path);
+            for (const char* name : {"pos0", "pos1", "vel0", "vel1", "mass"}) in.read(name, *into);
+        };
+    };
+    return c;
+}
+
+// The same sky read back from the cache, as every run after the first does.
+Case skyCacheRead() {
+    Case c;
+    c.group = "io";
+    c.name = "sky_cache_read";
+    c.bytes = [](std::size_t n) { return double(n) * 8.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        const grav::SkyParams p = skyFor(n);
+        const std::string path = scratchPath("bench_suite.sky");
+        if (!grav::SkyImage::render(p).save(path)) return {};
+        return [p, path] {
+            grav::SkyImage sky;
+            sky.load(path, p);
+        };
+    };
+    return c;
+}
+
+// Eight frames of x, y, vx, vy for n bodies, from open to close.
+Case trajectoryExport() {
+    Case c;
+    c.group = "io";
+    c.name = "trajectory_export";
+    c.bytes = [](std::size_t n) { return double(n) * 32.0 * 9.0; };
+    c.setup = [](std::size_t n) -> std::function<void()> {
+        auto state = std::make_shared<BodyColumns>(n);
+        const std::string path = scratchPath("bench_suite.traj");
+        return [state, path] {
+            grav::TrajectoryWriter out;
+            grav::TrajectoryOptions opt;
+            if (!out.open(path, state->px.size(), opt.fields({"x", "y", "vx", "vy"}))) return;
+            for (int frame = 0; frame < 8; ++frame)
+                out.append(frame * 0.001, {state->px.data(), state->py.data(), state->vx.data(), state->vy.data()});
+            out.close();
+        };
+    };
+    return c;
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool more = i + 1 < argc;
+        if (arg == "--gpu") opt.gpu = true;
+        else if (arg == "--filter" && more) opt.filter = argv[++i];
+        else if (arg == "--min-n" && more) opt.minN = std::size_t(std::strtod(argv[++i], nullptr));
+        else if (arg == "--max-n" && more) opt.maxN = std::size_t(std::strtod(argv[++i], nullptr));
+        else if (arg == "--min-time" && more) opt.minTime = std::strtod(argv[++i], nullptr);
+        else if (arg == "--max-bytes" && more) opt.maxBytes = std::strtod(argv[++i], nullptr);
+        else if (arg == "--assets" && more) opt.assets = argv[++i];
+        else if (arg == "--out" && more) opt.out = argv[++i];
+    }
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const Options opt = parseOptions(argc, argv);
+    std::vector<Case> cases = {orbitUpdate(),      sceneGraphUpdate(), keplerPropagate(),       blackhole01Stars(),
+                               blackhole03Stars(), batchFill(),        cullVisible(),           trailFrame(),
+                               shapeSetup(),       gpuDraw(false),     gpuDraw(true),           orbitPrecess(),
+                               lensTrace(),        lensBake(),         lensShader(opt.assets),  skyRender(),
+                               snapshotWrite(),    snapshotRead(),     skyCacheRead(),          trajectoryExport()};
+
+    std::vector<Result> results;
+    for (const Case& c : cases) {
+        const std::string id = c.group + "/" + c.name;
+        if (c.gpu && !opt.gpu) continue;
+        if (!opt.filter.empty() && id.find(opt.filter) == std::string::npos) continue;
+        for (std::size_t n = 100; n <= opt.maxN; n *= 10) {
+            if (n < opt.minN) continue;
+            results.push_back(measure(c, n, opt));
+            const Result& r = results.back();
+            std::clog << id << " n=" << n << ": ";
+            if (r.skipped.empty()) std::clog << percentile(r.ms, 50) << " ms p50, " << percentile(r.ms, 99) << " ms p99\n";
+            else std::clog << "skipped (" << r.skipped << ")\n";
+        }
+    }
+    std::remove(scratchPath("bench_suite.snap").c_str());
+    std::remove(scratchPath("bench_suite_read.snap").c_str());
+    std::remove(scratchPath("bench_suite.traj").c_str());
+    std::remove(scratchPath("bench_suite.sky").c_str());
+
+    if (opt.out.empty()) {
+        writeJson(std::cout, results);
+        return 0;
+    }
+    std::ofstream out(opt.out);
+    writeJson(out, results);
+    if (!out) {
+        std::cerr << "Cannot write " << opt.out << "\n";
+        return 1;
+    }
+    std::clog << "wrote " << opt.out << "\n";
+    return 0;
+}
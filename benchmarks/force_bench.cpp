@@ -0,0 +1,115 @@
+// Force backend benchmark: direct summation, Barnes-Hut and the fast multipole
+// method on the disk distributions of blackhole02 and blackhole03, from 1e3
+// bodies up to --max-n (default 1e6), or on the bodies of a scenario file with
+// --scenario (it must give x, y, vx and vy; see tools/scenario_tool). The
+// solorsystem06 planets and moons are covered by `solar_system_full --bench-forces`.
+//
+//   g++ -O2 -pthread benchmarks/force_bench.cpp -o benchmarks/force_bench
+//   ./benchmarks/force_bench [--max-n N] [--theta T] [--sample S] [--scenario PATH]
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../common/bodies.hpp"
+#include "../common/force_bench.hpp"
+#include "../common/scenario.hpp"
+
+using Disk = grav::Bodies<double, 2>;
+
+namespace {
+
+constexpr double PI = 3.14159265358979;
+
+// Deterministic uniform numbers in [0, 1), the same on every platform.
+struct Random {
+    std::uint64_t state;
+    double next() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return double(state >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// blackhole02's accretion ring: 30 filled discs of radius 100 - 2.5 i drawn
+// additively with alpha 8 + 3 (30 - i), so the surface density at a radius is
+// the summed alpha of every disc that reaches it. Equal-mass bodies.
+Disk accretionRing(std::size_t n, Random& rng) {
+    double weight[30], total = 0.0;
+    for (int i = 0; i < 30; ++i) {
+        const double r = 100.0 - i * 2.5;
+        weight[i] = (8 + (30 - i) * 3) * r * r;
+        total += weight[i];
+    }
+    Disk d;
+    d.reserve(n);
+    for (std::size_t b = 0; b < n; ++b) {
+        double pick = rng.next() * total;
+        int i = 0;
+        while (i < 29 && pick >= weight[i]) pick -= weight[i++];
+        const double r = (100.0 - i * 2.5) * std::sqrt(rng.next());
+        const double a = 2.0 * PI * rng.next();
+        double pos[2] = {r * std::cos(a), r * std::sin(a)};
+        double vel[2] = {0.0, 0.0};
+        d.add(pos, vel, 1.0 / double(n));
+    }
+    return d;
+}
+
+// blackhole03's star field: spawn radius uniform in [150, 300), uniform angle,
+// around a central hole as heavy as all the stars together.
+Disk starAnnulus(std::size_t n, Random& rng) {
+    Disk d;
+    d.reserve(n + 1);
+    double origin[2] = {0.0, 0.0};
+    d.add(origin, origin, 1.0);
+    for (std::size_t b = 0; b < n; ++b) {
+        const double r = 150.0 + 150.0 * rng.next();
+        const double a = 2.0 * PI * rng.next();
+        double pos[2] = {r * std::cos(a), r * std::sin(a)};
+        double vel[2] = {0.0, 0.0};
+        d.add(pos, vel, 1.0 / double(n));
+    }
+    return d;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t maxN = 1000000;
+    grav::ForceBenchOptions opt;
+    std::string scenarioPath;
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--max-n") maxN = std::strtoull(argv[i + 1], nullptr, 10);
+        if (arg == "--theta") opt.theta = std::strtod(argv[i + 1], nullptr);
+        if (arg == "--sample") opt.sample = std::strtoull(argv[i + 1], nullptr, 10);
+        if (arg == "--scenario") scenarioPath = argv[i + 1];
+    }
+
+    grav::Scenario scenario;
+    std::string error;
+    if (!scenarioPath.empty() && !grav::loadScenario(scenarioPath, scenario, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    if (!scenarioPath.empty() && !scenario.has(grav::Scenario::X)) {
+        std::cerr << scenarioPath << ": no x, y, vx, vy columns\n";
+        return 1;
+    }
+
+    std::cout.precision(3);
+    std::clog << grav::TaskScheduler::instance().threadCount() << " threads\n";
+    grav::printForceBenchHeader(std::cout);
+    if (!scenarioPath.empty()) {
+        grav::benchForceBackends("scenario", scenario.state, 1.0, 0.0, opt, std::cout);
+        return 0;
+    }
+    for (std::size_t n = 1000; n <= maxN; n *= 10) {
+        Random rng{n};
+        grav::benchForceBackends("blackhole02", accretionRing(n, rng), 1.0, 0.0, opt, std::cout);
+        grav::benchForceBackends("blackhole03", starAnnulus(n, rng), 1.0, 0.0, opt, std::cout);
+        std::cout.flush();
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Trajectory logging benchmark: bodies on circular orbits logged every step
+// through TrajectoryWriter, then read back at random frames. Reports what the
+// stepping loop pays per frame, the encoders' throughput, the compression
+// ratio and the largest error against the exact values.
+//
+//   g++ -O2 -pthread benchmarks/trajectory_bench.cpp -o benchmarks/trajectory_bench
+//   ./benchmarks/trajectory_bench [--bodies N] [--frames F] [--threads T] [--out PATH]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../common/trajectory.hpp"
+
+int main(int argc, char** argv) {
+    std::size_t bodies = 100000, frames = 1000;
+    int threads = int(std::max(1u, std::thread::hardware_concurrency() / 2));
+    std::string path = "trajectory_bench.traj";
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--bodies") bodies = std::strtoull(argv[i + 1], nullptr, 10);
+        if (arg == "--frames") frames = std::strtoull(argv[i + 1], nullptr, 10);
+        if (arg == "--threads") threads = std::atoi(argv[i + 1]);
+        if (arg == "--out") path = argv[i + 1];
+    }
+
+    // Radius 50..450 px, Keplerian angular speed, 1 ms per frame
+    const double dt = 0.001, quantum = 1e-6;
+    std::vector<double> radius(bodies), omega(bodies), phase(bodies);
+    for (std::size_t i = 0; i < bodies; ++i) {
+        radius[i] = 50.0 + 400.0 * double(i) / double(std::max<std::size_t>(1, bodies - 1));
+        omega[i] = 2e3 / std::pow(radius[i], 1.5);
+        phase[i] = 2.399963 * double(i);
+    }
+    auto state = [&](std::size_t t, std::vector<double>& x, std::vector<double>& y, std::vector<double>& vx,
+                     std::vector<double>& vy) {
+        for (std::size_t i = 0; i < bodies; ++i) {
+            const double a = phase[i] + omega[i] * dt * double(t);
+            x[i] = radius[i] * std::cos(a);
+            y[i] = radius[i] * std::sin(a);
+            vx[i] = -radius[i] * omega[i] * std::sin(a);
+            vy[i] = radius[i] * omega[i] * std::cos(a);
+        }
+    };
+
+    grav::TrajectoryWriter writer;
+    writer.threads = threads;
+    if (!writer.open(path, bodies, {{"x", quantum}, {"y", quantum}, {"vx", quantum}, {"vy", quantum}})) {
+        std::cerr << "Cannot write " << path << "\n";
+        return 1;
+    }
+    std::vector<double> x(bodies), y(bodies), vx(bodies), vy(bodies);
+    using clock = std::chrono::steady_clock;
+    double appendSeconds = 0.0;
+    const auto start = clock::now();
+    for (std::size_t t = 0; t < frames; ++t) {
+        state(t, x, y, vx, vy);
+        const auto t0 = clock::now();
+        writer.append(double(t) * dt, {x.data(), y.data(), vx.data(), vy.data()});
+        appendSeconds += std::chrono::duration<double>(clock::now() - t0).count();
+    }
+    const double raw = double(writer.rawBytes());
+    writer.close();
+    const double total = std::chrono::duration<double>(clock::now() - start).count();
+    const double written = double(writer.bytesWritten());
+
+    std::cout.precision(4);
+    std::cout << bodies << " bodies, " << frames << " frames, " << threads << " encoder threads\n"
+              << "append       " << appendSeconds / double(frames) * 1e3 << " ms/frame ("
+              << writer.waitSeconds() * 1e3 << " ms waiting on encoders)\n"
+              << "throughput   " << double(frames) / total << " frames/s, " << raw / total / 1e6 << " MB/s raw\n"
+              << "size         " << written / 1e6 << " MB, " << raw / written << "x smaller than raw doubles\n";
+
+    // Random access: read frames in a scattered order and check them
+    grav::TrajectoryReader reader;
+    if (!reader.open(path) || reader.frames() != frames) {
+        std::cerr << "Cannot read back " << path << "\n";
+        return 1;
+    }
+    std::vector<double> values;
+    double worst = 0.0, time = 0.0;
+    const std::size_t probes = std::min<std::size_t>(frames, 50);
+    const auto r0 = clock::now();
+    for (std::size_t k = 0; k < probes; ++k) {
+        const std::size_t t = (k * 7919) % frames;
+        reader.frame(t, time, values);
+        state(t, x, y, vx, vy);
+        for (std::size_t i = 0; i < bodies; ++i) {
+            worst = std::max({worst, std::abs(values[i] - x[i]), std::abs(values[bodies + i] - y[i]),
+                              std::abs(values[2 * bodies + i] - vx[i]), std::abs(values[3 * bodies + i] - vy[i])});
+        }
+    }
+    const double seekMs = std::chrono::duration<double, std::milli>(clock::now() - r0).count() / double(probes);
+    std::cout << "random read  " << seekMs << " ms/frame, max error " << worst << " (quantum " << quantum << ")\n";
+    std::remove(path.c_str());
+    return 0;
+}
@@ -1,71 +1,240 @@
 #include <SFML/Graphics.hpp>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
 
-int main() {
-    sf::RenderWindow window(sf::VideoMode(1200, 800), "Small Movable Black Hole");
+#include "../common/asset_cache.hpp"
+#include "../common/headless.hpp"
+#include "../common/lensing.hpp"
+#include "../common/physics_thread.hpp"
+#include "../common/profiler_overlay.hpp"
+#include "../common/triple_buffer.hpp"
+
+constexpr double PHYSICS_DT = 0.001; // seconds per physics step (1000 Hz)
+
+// Nearest-neighbour resize of an image to w x h, as 32-bit RGBA pixels.
+std::vector<std::uint32_t> resample(const sf::Image& image, unsigned w, unsigned h) {
+    const sf::Vector2u size = image.getSize();
+    const sf::Uint8* src = image.getPixelsPtr();
+    std::vector<std::uint32_t> out(std::size_t(w) * h);
+    for (unsigned y = 0; y < h; ++y) {
+        const unsigned sy = unsigned(std::uint64_t(y) * size.y / h);
+        for (unsigned x = 0; x < w; ++x) {
+            const unsigned sx = unsigned(std::uint64_t(x) * size.x / w);
+            std::memcpy(&out[std::size_t(y) * w + x], src + (std::size_t(sy) * size.x + sx) * 4, 4);
+        }
+    }
+    return out;
+}
+
+// Hole size and lens distance in pixels, proportional to the frame width so
+// the Einstein ring covers the same share of the picture at any resolution.
+void fitLens(grav::LensTracer& lens, unsigned width) {
+    lens.schwarzschildRadius = float(width) / 50.f;
+    lens.sourceDistance = float(width) / 2.f;
+}
+
+// --bench-lens N: render N frames on the CPU without a window, with the hole
+// sweeping across the middle, and save the last one. With `sky` the background
+// is generated at w x h rather than stretched from stars.jpg.
+int benchLens(int frames, unsigned w, unsigned h, bool sky, grav::SkyParams skyParams) {
+    grav::LensTracer lens;
+    fitLens(lens, w);
+    if (sky) {
+        skyParams.width = w;
+        skyParams.height = h;
+        const grav::SkyImage image = grav::SkyImage::cached(skyParams);
+        std::clog << "sky " << grav::SkyImage::cacheName(skyParams) << " " << image.millis() << " ms"
+                  << (image.fromDisk() ? " (cached)" : "") << "\n";
+        lens.setBackground(image.rgba(), int(w), int(h));
+    } else {
+        sf::Image stars;
+        if (!stars.loadFromFile("stars.jpg")) {
+            std::cerr << "Failed to load stars.jpg\n";
+            return -1;
+        }
+        lens.setBackground(resample(stars, w, h).data(), int(w), int(h));
+    }
+    std::vector<std::uint32_t> pixels(std::size_t(w) * h);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f)
+        lens.render(float(w) * (0.25f + 0.5f * float(f) / float(frames)), float(h) * 0.5f, pixels.data());
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << w << "x" << h << " " << grav::simdName(grav::simdLevel()) << " "
+              << grav::TaskScheduler::instance().threadCount() << " threads: "
+              << seconds / frames * 1e3 << " ms/frame, " << frames / seconds << " fps, "
+              << double(w) * h * frames / seconds * 1e-6 << " Mpx/s\n";
+
+    sf::Image frame;
+    frame.create(w, h, reinterpret_cast<const sf::Uint8*>(pixels.data()));
+    frame.saveToFile("lens_bench.png");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const grav::HeadlessOptions headless = grav::parseHeadless(argc, argv);
+    const grav::ProfileOptions profile = grav::parseProfile(argc, argv);
+
+    // --cpu-lens traces the lensing on the CPU instead of the fragment shader;
+    // --bench-lens N [--size WxH] times it without a window; --sky generates
+    // the background instead of loading stars.jpg
+    bool cpuLens = false;
+    bool sky = false;
+    int benchFrames = 0;
+    unsigned benchW = 1920, benchH = 1080;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--cpu-lens") cpuLens = true;
+        if (arg == "--sky") sky = true;
+        if (arg == "--bench-lens" && i + 1 < argc) benchFrames = std::atoi(argv[++i]);
+        if (arg == "--size" && i + 1 < argc) {
+            char* end = nullptr;
+            benchW = unsigned(std::strtoul(argv[++i], &end, 10));
+            if (*end == 'x') benchH = unsigned(std::strtoul(end + 1, nullptr, 10));
+        }
+    }
+    const grav::SkyParams skyParams = grav::parseSkyParams(argc, argv, grav::SkyParams());
+    if (benchFrames > 0) return benchLens(benchFrames, benchW, benchH, sky, skyParams);
+
+    const sf::Vector2f windowSize(1200.f, 800.f);
+    sf::Vector2f bh_pos = windowSize * 0.5f;
+    float speed = 200.f;  // Pixels per second
+
+    // Movement keys, as a direction, from the render thread
+    grav::TripleBuffer<sf::Vector2f> steering;
+
+    auto step = [&](double dt) {
+        steering.update();
+        bh_pos += steering.read() * (speed * float(dt));
+
+        // Clamp to screen bounds
+        bh_pos.x = std::max(0.f, std::min(bh_pos.x, windowSize.x));
+        bh_pos.y = std::max(0.f, std::min(bh_pos.y, windowSize.y));
+    };
+
+    if (headless.enabled)
+        return grav::runHeadless("blackhole_shader", headless, PHYSICS_DT, 1, step, [&](std::ostream& os) {
+            os << "blackhole " << bh_pos.x << " " << bh_pos.y << "\n";
+        });
+
+    sf::RenderWindow window(sf::VideoMode(unsigned(windowSize.x), unsigned(windowSize.y)), "Small Movable Black Hole");
     window.setFramerateLimit(60);
 
-    // Load background
-    sf::Texture backgroundTexture;
-    if (!backgroundTexture.loadFromFile("stars.jpg")) {
-        std::cerr << "Failed to load stars.jpg\n";
+    grav::AssetCache& assets = grav::AssetCache::instance();
+
+    // Load or generate the background
+    grav::SkyParams windowSky = skyParams;
+    windowSky.width = window.getSize().x;
+    windowSky.height = window.getSize().y;
+    const sf::Texture* backgroundTexture = sky ? assets.sky(windowSky) : assets.texture("stars.jpg");
+    if (!backgroundTexture) {
+        std::cerr << (sky ? "Failed to create the background\n" : "Failed to load stars.jpg\n");
         return -1;
     }
 
-    sf::Sprite background(backgroundTexture);
+    sf::Sprite background(*backgroundTexture);
     background.setScale(
-        static_cast<float>(window.getSize().x) / backgroundTexture.getSize().x,
-        static_cast<float>(window.getSize().y) / backgroundTexture.getSize().y
+        static_cast<float>(window.getSize().x) / backgroundTexture->getSize().x,
+        static_cast<float>(window.getSize().y) / backgroundTexture->getSize().y
     );
 
     // Load shader
-    sf::Shader shader;
-    if (!shader.loadFromFile("lens_distortion.frag", sf::Shader::Fragment)) {
+    sf::Shader* shader = assets.shader("lens_distortion.frag", sf::Shader::Fragment);
+    if (!shader) {
         std::cerr << "Failed to load lens_distortion.frag\n";
         return -1;
     }
 
-    sf::Vector2f bh_pos = sf::Vector2f(window.getSize()) * 0.5f;
-    float speed = 200.f;  // Pixels per second
+    // Lens offsets, baked once per --lens-* setting
+    grav::LensParams lensParams;
+    lensParams.width = window.getSize().x;
+    lensParams.height = window.getSize().y;
+    const grav::LensTexture* lensMap = assets.lens(grav::parseLensParams(argc, argv, lensParams));
+    if (!lensMap) {
+        std::cerr << "Failed to create the lens displacement map\n";
+        return -1;
+    }
+    lensMap->bind(*shader);
+    assets.report(std::clog);
+
+    // CPU path: the tracer writes into a streaming texture drawn in place of the background
+    grav::LensTracer lens;
+    sf::Texture lensTexture;
+    sf::Sprite lensSprite;
+    std::vector<std::uint32_t> lensPixels;
+    if (cpuLens) {
+        const sf::Vector2u size = window.getSize();
+        fitLens(lens, size.x);
+        lens.setBackground(resample(backgroundTexture->copyToImage(), size.x, size.y).data(), int(size.x), int(size.y));
+        lensPixels.resize(std::size_t(size.x) * size.y);
+        lensTexture.create(size.x, size.y);
+        lensSprite.setTexture(lensTexture, true);
+        std::clog << "CPU lensing, " << grav::simdName(grav::simdLevel()) << "\n";
+    }
+
+    grav::PhysicsThread<sf::Vector2f> physics(PHYSICS_DT, step, [&](sf::Vector2f& out) { out = bh_pos; });
+    physics.setRate(1.0 / PHYSICS_DT);
+    physics.start();
+
     sf::Clock clock;
+    profile.apply();
+    grav::ProfilerOverlay overlay(profile.overlay);
 
     while (window.isOpen()) {
+        grav::ProfilePhases phase("events");
         sf::Event event;
         while (window.pollEvent(event)) {
+            overlay.handle(event);
             if (event.type == sf::Event::Closed)
                 window.close();
         }
 
-        // Time step
-        float dt = clock.restart().asSeconds();
-
         // Keyboard movement
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))  bh_pos.x -= speed * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) bh_pos.x += speed * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))    bh_pos.y -= speed * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))  bh_pos.y += speed * dt;
+        sf::Vector2f dir(0.f, 0.f);
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))  dir.x -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) dir.x += 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))    dir.y -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))  dir.y += 1.f;
+        steering.write() = dir;
+        steering.publish();
 
-        // Clamp to screen bounds
-        bh_pos.x = std::max(0.f, std::min(bh_pos.x, static_cast<float>(window.getSize().x)));
-        bh_pos.y = std::max(0.f, std::min(bh_pos.y, static_cast<float>(window.getSize().y)));
+        // Blend the two latest physics snapshots
+        phase.next("scene");
+        physics.poll();
+        const float t = float(physics.alpha());
+        const sf::Vector2f pos = physics.previous().state + (physics.current().state - physics.previous().state) * t;
 
         // Convert to normalized coordinates [0, 1]
         sf::Vector2f bh_uv = sf::Vector2f(
-            bh_pos.x / window.getSize().x,
-            bh_pos.y / window.getSize().y
+            pos.x / window.getSize().x,
+            pos.y / window.getSize().y
         );
 
-        // Set shader uniforms
-        shader.setUniform("texture", backgroundTexture);
-        shader.setUniform("blackHolePos", bh_uv);
-        shader.setUniform("time", clock.getElapsedTime().asSeconds());
-
-        // Draw
+        phase.next("shader");
         window.clear();
-        window.draw(background, &shader);
+        if (cpuLens) {
+            lens.render(pos.x, pos.y, lensPixels.data());
+            lensTexture.update(reinterpret_cast<const sf::Uint8*>(lensPixels.data()));
+            window.draw(lensSprite);
+        } else {
+            // Set shader uniforms
+            shader->setUniform("texture", *backgroundTexture);
+            shader->setUniform("blackHolePos", bh_uv);
+            shader->setUniform("time", clock.getElapsedTime().asSeconds());
+            window.draw(background, shader);
+        }
+        phase.next("display");
+        overlay.draw(window);
         window.display();
     }
 
+    profile.writeTrace(std::clog);
     return 0;
 }
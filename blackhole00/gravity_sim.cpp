@@ -1,7 +1,37 @@
 #include <SFML/Graphics.hpp>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "../common/double_float.hpp"
+#include "../common/headless.hpp"
+#include "../common/physics_thread.hpp"
+#include "../common/profiler_overlay.hpp"
+#include "../common/triple_buffer.hpp"
 
 constexpr float SCALE = 1e-9f;
+constexpr double PHYSICS_DT = 0.001; // wall-clock seconds per physics step (1000 Hz)
+constexpr double SIM_DT = 0.01;      // simulated seconds per physics step
+constexpr double THRUST = 2e7;       // m/s^2 on the sun while an arrow key is held
+constexpr float ZOOM_RATE = 18.7f;   // 1.05^60: scale factor per second while +/- is held
+constexpr double C = 2.998e8;        // speed of light, m/s
+
+// Keys held on the render thread
+struct Controls {
+    sf::Vector2f move;
+    float zoom = 0.f;
+    unsigned resets = 0;
+};
+
+// What the renderer needs from the physics thread
+struct Snapshot {
+    sf::Vector2f sunPos;
+    float scale = SCALE;
+};
 
 class Sun {
 public:
@@ -60,43 +90,224 @@ public:
     }
 };
 
-int main() {
-    sf::RenderWindow window(sf::VideoMode(1200, 800), "Black Hole Light Bending Demo");
-    window.setFramerateLimit(60);
+// The sun's orbit around the black hole in SI units, integrated with
+// kick-drift-kick leapfrog in the scalar type Real: float, double or
+// grav::DoubleFloat. Only the published position is narrowed to float for
+// drawing, so a long run in double costs nothing in the render path.
+class OrbitEngine {
+public:
+    virtual ~OrbitEngine() = default;
+    virtual void reset() = 0;
+    virtual void step(double dt, const sf::Vector2f& thrust) = 0;
+    virtual sf::Vector2f position() const = 0;
+    virtual void state(double (&s)[4]) const = 0;   // x, y, vx, vy
+
+    // Specific orbital energy, evaluated in double from the stored state.
+    double energy() const {
+        double s[4];
+        state(s);
+        return 0.5 * (s[2] * s[2] + s[3] * s[3]) - gm_ / std::hypot(s[0], s[1]);
+    }
+
+protected:
+    OrbitEngine(double gm, double start, double horizon) : gm_(gm), start_(start), horizon_(horizon) {}
+    double gm_, start_, horizon_;
+};
+
+template <typename Real>
+class Orbit : public OrbitEngine {
+public:
+    Orbit(double gm, double start, double horizon) : OrbitEngine(gm, start, horizon), gm(gm) { reset(); }
+
+    // Circular orbit starting on the +x axis.
+    void reset() override {
+        x = Real(start_);
+        y = Real(0.0);
+        vx = Real(0.0);
+        vy = Real(std::sqrt(gm_ / start_));
+        accelerate();
+    }
+
+    void step(double h, const sf::Vector2f& thrust) override {
+        const Real dt(h), half(0.5 * h);
+        const Real tx(thrust.x * THRUST), ty(thrust.y * THRUST);
+        vx += (ax + tx) * half;
+        vy += (ay + ty) * half;
+        x += vx * dt;
+        y += vy * dt;
+        accelerate();
+        vx += (ax + tx) * half;
+        vy += (ay + ty) * half;
+
+        // Swallowed by the hole: start over.
+        if (double(x) * double(x) + double(y) * double(y) < horizon_ * horizon_) reset();
+    }
+
+    sf::Vector2f position() const override { return sf::Vector2f(float(x), float(y)); }
+
+    void state(double (&s)[4]) const override {
+        s[0] = double(x);
+        s[1] = double(y);
+        s[2] = double(vx);
+        s[3] = double(vy);
+    }
+
+private:
+    Real gm;
+    Real x, y, vx, vy, ax, ay;
+
+    void accelerate() {
+        using std::sqrt;
+        const Real r2 = x * x + y * y;
+        const Real r = sqrt(r2);
+        const Real s = -gm / (r2 * r);
+        ax = s * x;
+        ay = s * y;
+    }
+};
+
+// Scalar names accepted by --scalar.
+inline std::unique_ptr<OrbitEngine> makeOrbit(const std::string& scalar, double gm, double start, double horizon) {
+    if (scalar == "float") return std::make_unique<Orbit<float>>(gm, start, horizon);
+    if (scalar == "double") return std::make_unique<Orbit<double>>(gm, start, horizon);
+    if (scalar == "double-float") return std::make_unique<Orbit<grav::DoubleFloat>>(gm, start, horizon);
+    return nullptr;
+}
+
+// --bench: the same orbit in every scalar type, reporting speed and energy drift.
+int benchScalars(std::uint64_t steps, double gm, double start, double horizon) {
+    std::cout << std::left << std::setw(14) << "scalar" << std::setw(16) << "steps/s"
+              << std::setw(16) << "max |dE/E|" << "final dE/E\n";
+    for (const char* name : {"float", "double-float", "double"}) {
+        std::unique_ptr<OrbitEngine> orbit = makeOrbit(name, gm, start, horizon);
+        const double e0 = orbit->energy();
+        double worst = 0.0;
+        double seconds = 0.0;
+        const std::uint64_t batch = 10000;
+        for (std::uint64_t done = 0; done < steps; done += batch) {
+            const auto t0 = std::chrono::steady_clock::now();
+            for (std::uint64_t i = 0; i < batch && done + i < steps; ++i) orbit->step(SIM_DT, sf::Vector2f(0.f, 0.f));
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            worst = std::max(worst, std::abs((orbit->energy() - e0) / e0));
+        }
+        const double stepsPerSec = seconds > 0.0 ? double(steps) / seconds : 0.0;
+        std::cout << std::left << std::setw(14) << name << std::setw(16) << stepsPerSec
+                  << std::setw(16) << worst << (orbit->energy() - e0) / e0 << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const grav::HeadlessOptions headless = grav::parseHeadless(argc, argv);
+    const grav::ProfileOptions profile = grav::parseProfile(argc, argv);
+
+    // --scalar picks the precision of the orbit state, --bench compares them all
+    // (over --steps N, or ten million steps when not given)
+    std::string scalar = "double";
+    bool bench = false, stepsGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--scalar" && i + 1 < argc) scalar = argv[++i];
+        if (arg == "--bench") bench = true;
+        if (arg == "--steps") stepsGiven = true;
+    }
 
     BlackHole blackHole(sf::Vector2f(0, 0), 4e9f); // Large black hole
     Sun sun(sf::Vector2f(6e9f, 0), 1.5e9f);         // Sun to the side
 
+    // Schwarzschild radius r = 2GM/c^2 gives the hole's GM
+    const double gm = 0.5 * double(blackHole.eventHorizonRadius) * C * C;
+    if (bench)
+        return benchScalars(stepsGiven ? headless.steps : 10000000, gm, sun.position.x, blackHole.eventHorizonRadius);
+
+    std::unique_ptr<OrbitEngine> orbit = makeOrbit(scalar, gm, sun.position.x, blackHole.eventHorizonRadius);
+    if (!orbit) {
+        std::cerr << "Unknown scalar " << scalar << " (float, double, double-float)\n";
+        return 1;
+    }
+
     float scale = SCALE;
+    unsigned resetsApplied = 0;
+    grav::TripleBuffer<Controls> controls;
+
+    auto step = [&](double dt) {
+        controls.update();
+        const Controls& in = controls.read();
+        orbit->step(dt, in.move);
+        scale *= std::pow(ZOOM_RATE, in.zoom * float(PHYSICS_DT));
+        if (resetsApplied != in.resets) {
+            resetsApplied = in.resets;
+            orbit->reset();
+            scale = SCALE;
+        }
+    };
+
+    if (headless.enabled)
+        return grav::runHeadless("gravity_sim", headless, SIM_DT, 1, step, [&](std::ostream& os) {
+            double s[4];
+            orbit->state(s);
+            os << "sun " << s[0] << " " << s[1] << " " << s[2] << " " << s[3]
+               << " energy " << orbit->energy() << " scale " << scale << "\n";
+        });
+
+    sf::RenderWindow window(sf::VideoMode(1200, 800), "Black Hole Light Bending Demo");
+    window.setFramerateLimit(60);
+
+    grav::PhysicsThread<Snapshot> physics(SIM_DT, step,
+        [&](Snapshot& out) {
+            out.sunPos = orbit->position();
+            out.scale = scale;
+        });
+    physics.setRate(1.0 / PHYSICS_DT);
+    physics.start();
+
+    Controls input;
     sf::Clock clock;
+    profile.apply();
+    grav::ProfilerOverlay overlay(profile.overlay);
 
     while (window.isOpen()) {
+        grav::ProfilePhases phase("events");
         sf::Event event;
         while (window.pollEvent(event)) {
+            overlay.handle(event);
             if (event.type == sf::Event::Closed)
                 window.close();
         }
 
         // Keyboard controls
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) sun.position.x -= 1e8f;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) sun.position.x += 1e8f;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up)) sun.position.y -= 1e8f;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) sun.position.y += 1e8f;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Add)) scale *= 1.05f;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Subtract)) scale *= 0.95f;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::R)) {
-            sun.position = sf::Vector2f(6e9f, 0);
-            scale = SCALE;
-        }
+        input.move = sf::Vector2f(0.f, 0.f);
+        input.zoom = 0.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) input.move.x -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) input.move.x += 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up)) input.move.y -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) input.move.y += 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Add)) input.zoom += 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Subtract)) input.zoom -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::R)) ++input.resets;
+        controls.write() = input;
+        controls.publish();
+
+        // Blend the two latest physics snapshots
+        phase.next("scene");
+        physics.poll();
+        const Snapshot& prev = physics.previous().state;
+        const Snapshot& curr = physics.current().state;
+        const float t = float(physics.alpha());
+        Sun shownSun(prev.sunPos + (curr.sunPos - prev.sunPos) * t, sun.radius);
+        const float shownScale = prev.scale + (curr.scale - prev.scale) * t;
 
         window.clear(sf::Color(5, 5, 20));
 
         float time = clock.getElapsedTime().asSeconds();
-        sun.draw(window, scale);
-        blackHole.draw(window, scale, time);
+        shownSun.draw(window, shownScale);
+        blackHole.draw(window, shownScale, time);
 
+        phase.next("display");
+        overlay.draw(window);
         window.display();
     }
 
+    profile.writeTrace(std::clog);
     return 0;
 }
@@ -1,23 +1,17 @@
 // lens_distortion.frag
 uniform sampler2D texture;
+uniform sampler2D displacement;  // baked lens offsets, see common/displacement_map.hpp
+uniform float displacementRange;
 uniform vec2 blackHolePos; // Normalized [0,1] screen space position
 uniform float time;
 
+// Offset for a pixel at delta from the hole: the map centred on the hole
+vec2 lensOffset(vec2 delta) {
+    vec4 c = texture2D(displacement, delta * 0.5 + 0.5) * 255.0;
+    return (vec2(c.r * 256.0 + c.g, c.b * 256.0 + c.a) / 32767.5 - 1.0) * displacementRange;
+}
+
 void main() {
     vec2 uv = gl_TexCoord[0].xy;
-    vec2 delta = uv - blackHolePos;
-    float dist = length(delta);
-
-    float radius = 0.2;
-    float strength = 0.03;
-
-    vec2 distortedUV = uv;
-
-    if (dist < radius) {
-        float distortion = strength / (dist + 0.01);
-        distortion *= (1.0 - dist / radius);  // Fade out near edge
-        distortedUV += normalize(delta) * distortion;
-    }
-
-    gl_FragColor = texture2D(texture, distortedUV);
+    gl_FragColor = texture2D(texture, uv + lensOffset(uv - blackHolePos));
 }
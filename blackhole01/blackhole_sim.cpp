@@ -3,110 +3,210 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
+#include <string>
+
+#include "../common/circle_batch.hpp"
+#include "../common/asset_cache.hpp"
+#include "../common/headless.hpp"
+#include "../common/physics_thread.hpp"
+#include "../common/task_scheduler.hpp"
+#include "../common/profiler_overlay.hpp"
+#include "../common/triple_buffer.hpp"
+
+constexpr double PHYSICS_DT = 0.001; // seconds per physics step (1000 Hz)
+
+// Snapshot handed from the physics thread to the renderer
+struct Snapshot {
+    sf::Vector2f bhPos;
+    std::vector<sf::Vector2f> stars;
+};
+
+int main(int argc, char** argv) {
+    // --stars N picks the number of orbiting stars; --sky generates the
+    // background instead of loading stars.jpg
+    std::size_t starCount = 20;
+    bool sky = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--stars" && i + 1 < argc) starCount = std::strtoul(argv[i + 1], nullptr, 10);
+        if (std::string(argv[i]) == "--sky") sky = true;
+    }
+
+    const grav::HeadlessOptions headless = grav::parseHeadless(argc, argv);
+    const grav::ProfileOptions profile = grav::parseProfile(argc, argv);
+
+    const sf::Vector2f windowSize(1200.f, 800.f);
+    sf::Vector2f bh_pos = windowSize * 0.5f;
+    sf::Vector2f velocity(0.f, 0.f);
+    float acceleration = 800.f;
+    float drag = 0.9f; // velocity kept per 1/60 s
+    float ringRotation = 0;
+
+    // Orbiting stars
+    struct Star {
+        float angle, distance, speed;
+    };
+    std::vector<Star> orbitStars;
+    for (std::size_t i = 0; i < starCount; ++i) {
+        float d = 50 + rand() % 200;
+        float a = rand() % 360;
+        float s = 10 + rand() % 40;
+        orbitStars.push_back({a, d, s});
+    }
+
+    // Movement keys, as a direction, from the render thread
+    grav::TripleBuffer<sf::Vector2f> steering;
+
+    auto step = [&](double h) {
+        const float dt = float(h);
+        steering.update();
+        velocity += steering.read() * (acceleration * dt);
+        velocity *= std::pow(drag, dt * 60.f);
+        bh_pos += velocity * dt;
+
+        // Clamp
+        bh_pos.x = std::clamp(bh_pos.x, 0.f, windowSize.x);
+        bh_pos.y = std::clamp(bh_pos.y, 0.f, windowSize.y);
+
+        // Update orbiting stars
+        for (auto& star : orbitStars)
+            star.angle += star.speed * dt;
+    };
 
-int main() {
-    sf::RenderWindow window(sf::VideoMode(1200, 800), "🔥 Black Hole Simulation");
+    if (headless.enabled)
+        return grav::runHeadless("blackhole_sim", headless, PHYSICS_DT, orbitStars.size() + 1, step, [&](std::ostream& os) {
+            os << "blackhole " << bh_pos.x << " " << bh_pos.y << " " << velocity.x << " " << velocity.y << "\n";
+            for (const Star& star : orbitStars) {
+                float rad = star.angle * 3.14159f / 180.f;
+                sf::Vector2f p = bh_pos + sf::Vector2f(std::cos(rad), std::sin(rad)) * star.distance;
+                os << "star " << p.x << " " << p.y << "\n";
+            }
+        });
+
+    sf::RenderWindow window(sf::VideoMode(unsigned(windowSize.x), unsigned(windowSize.y)), "🔥 Black Hole Simulation");
     window.setFramerateLimit(60);
 
-    // Load background
-    sf::Texture bgTex;
-    if (!bgTex.loadFromFile("stars.jpg")) {
-        std::cerr << "Missing stars.jpg\n";
+    grav::AssetCache& assets = grav::AssetCache::instance();
+
+    // Load or generate the background
+    grav::SkyParams skyParams = grav::parseSkyParams(argc, argv, grav::SkyParams());
+    skyParams.width = window.getSize().x;
+    skyParams.height = window.getSize().y;
+    const sf::Texture* bgTex = sky ? assets.sky(skyParams) : assets.texture("stars.jpg");
+    if (!bgTex) {
+        std::cerr << (sky ? "Couldn't create the background\n" : "Missing stars.jpg\n");
         return 1;
     }
-    sf::Sprite background(bgTex);
+    sf::Sprite background(*bgTex);
     background.setScale(
-        (float)window.getSize().x / bgTex.getSize().x,
-        (float)window.getSize().y / bgTex.getSize().y
+        (float)window.getSize().x / bgTex->getSize().x,
+        (float)window.getSize().y / bgTex->getSize().y
     );
 
     // Load accretion ring
-    sf::Texture ringTex;
-    if (!ringTex.loadFromFile("ring.png")) {
+    const sf::Texture* ringTex = assets.texture("ring.png", true);
+    if (!ringTex) {
         std::cerr << "Missing ring.png\n";
         return 1;
     }
-    ringTex.setSmooth(true);
-    sf::Sprite ring(ringTex);
-    ring.setOrigin(ringTex.getSize().x / 2, ringTex.getSize().y / 2);
+    sf::Sprite ring(*ringTex);
+    ring.setOrigin(ringTex->getSize().x / 2, ringTex->getSize().y / 2);
     ring.setScale(0.3f, 0.3f);
 
     // Shader
-    sf::Shader shader;
-    if (!shader.loadFromFile("lens_distortion.frag", sf::Shader::Fragment)) {
+    sf::Shader* shader = assets.shader("lens_distortion.frag", sf::Shader::Fragment);
+    if (!shader) {
         std::cerr << "Missing lens_distortion.frag\n";
         return 1;
     }
 
-    sf::Vector2f bh_pos(window.getSize().x / 2, window.getSize().y / 2);
-    sf::Vector2f velocity(0.f, 0.f);
-    float acceleration = 800.f;
-    float drag = 0.9f;
-    float ringRotation = 0;
-
-    // Orbiting stars
-    struct Star {
-        sf::CircleShape shape;
-        float angle, distance, speed;
-    };
-    std::vector<Star> orbitStars;
-    for (int i = 0; i < 20; ++i) {
-        float d = 50 + rand() % 200;
-        float a = rand() % 360;
-        float s = 10 + rand() % 40;
-        sf::CircleShape shape(2.f);
-        shape.setFillColor(sf::Color::White);
-        orbitStars.push_back({shape, a, d, s});
+    // Lens offsets, baked once per --lens-* setting
+    grav::LensParams lensParams;
+    lensParams.profile = grav::LensProfile::FadeSquared;
+    lensParams.width = window.getSize().x;
+    lensParams.height = window.getSize().y;
+    const grav::LensTexture* lensMap = assets.lens(grav::parseLensParams(argc, argv, lensParams));
+    if (!lensMap) {
+        std::cerr << "Failed to create the lens displacement map\n";
+        return 1;
     }
-
+    lensMap->bind(*shader);
+    assets.report(std::clog);
+
+    grav::PhysicsThread<Snapshot> physics(PHYSICS_DT, step,
+        [&](Snapshot& out) {
+            out.bhPos = bh_pos;
+            out.stars.resize(orbitStars.size());
+            grav::TaskScheduler::instance().parallelFor(0, orbitStars.size(), 1024, [&](std::size_t first, std::size_t last) {
+                for (std::size_t i = first; i < last; ++i) {
+                    const Star& star = orbitStars[i];
+                    float rad = star.angle * 3.14159f / 180.f;
+                    out.stars[i] = bh_pos + sf::Vector2f(std::cos(rad), std::sin(rad)) * star.distance;
+                }
+            });
+        });
+    physics.setRate(1.0 / PHYSICS_DT);
+    physics.start();
+
+    grav::CircleBatch starLayer;
     sf::Clock clock;
+    profile.apply();
+    grav::ProfilerOverlay overlay(profile.overlay);
     while (window.isOpen()) {
+        grav::ProfilePhases phase("events");
         float dt = clock.restart().asSeconds();
 
         sf::Event event;
-        while (window.pollEvent(event))
+        while (window.pollEvent(event)) {
+            overlay.handle(event);
             if (event.type == sf::Event::Closed)
                 window.close();
+        }
 
         // Movement input
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))  velocity.x -= acceleration * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) velocity.x += acceleration * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))    velocity.y -= acceleration * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))  velocity.y += acceleration * dt;
-
-        velocity *= drag;
-        bh_pos += velocity * dt;
-
-        // Clamp
-        bh_pos.x = std::clamp(bh_pos.x, 0.f, (float)window.getSize().x);
-        bh_pos.y = std::clamp(bh_pos.y, 0.f, (float)window.getSize().y);
+        sf::Vector2f dir(0.f, 0.f);
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))  dir.x -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) dir.x += 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))    dir.y -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))  dir.y += 1.f;
+        steering.write() = dir;
+        steering.publish();
+
+        // Blend the two latest physics snapshots
+        phase.next("scene");
+        physics.poll();
+        const Snapshot& prev = physics.previous().state;
+        const Snapshot& curr = physics.current().state;
+        const float t = float(physics.alpha());
+        const sf::Vector2f bh = prev.bhPos + (curr.bhPos - prev.bhPos) * t;
+
+        // All stars go into one batch; the offset keeps the old top-left circle origin
+        starLayer.clear();
+        for (std::size_t i = 0; i < curr.stars.size() && i < prev.stars.size(); ++i)
+            starLayer.addDisc(prev.stars[i] + (curr.stars[i] - prev.stars[i]) * t + sf::Vector2f(2.f, 2.f), 2.f, sf::Color::White);
 
         // Shader uniforms
-        sf::Vector2f bh_uv(bh_pos.x / window.getSize().x, bh_pos.y / window.getSize().y);
-        shader.setUniform("texture", bgTex);
-        shader.setUniform("blackHolePos", bh_uv);
-        shader.setUniform("time", clock.getElapsedTime().asSeconds());
-
-        // Update orbiting stars
-        for (auto& star : orbitStars) {
-            star.angle += star.speed * dt;
-            float rad = star.angle * 3.14159f / 180.f;
-            sf::Vector2f p = bh_pos + sf::Vector2f(std::cos(rad), std::sin(rad)) * star.distance;
-            star.shape.setPosition(p);
-        }
+        sf::Vector2f bh_uv(bh.x / window.getSize().x, bh.y / window.getSize().y);
+        shader->setUniform("texture", *bgTex);
+        shader->setUniform("blackHolePos", bh_uv);
+        shader->setUniform("time", clock.getElapsedTime().asSeconds());
 
         // Accretion disk rotation
-        ring.setPosition(bh_pos);
+        ring.setPosition(bh);
         ringRotation += 20 * dt;
         ring.setRotation(ringRotation);
 
         // Render
+        phase.next("shader");
         window.clear();
-        window.draw(background, &shader);
-        for (auto& star : orbitStars) window.draw(star.shape);
+        window.draw(background, shader);
+        phase.next("draw");
+        starLayer.draw(window);
         window.draw(ring); // Draw on top of distortion
+        phase.next("display");
+        overlay.draw(window);
         window.display();
     }
 
+    profile.writeTrace(std::clog);
     return 0;
 }
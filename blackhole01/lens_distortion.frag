@@ -1,22 +1,19 @@
 // lens_distortion.frag
 uniform sampler2D texture;
+uniform sampler2D displacement;  // baked lens offsets, see common/displacement_map.hpp
+uniform float displacementRange;
 uniform vec2 blackHolePos; // [0,1]
 uniform float time;
 
+// Offset for a pixel at delta from the hole: the map centred on the hole
+vec2 lensOffset(vec2 delta) {
+    vec4 c = texture2D(displacement, delta * 0.5 + 0.5) * 255.0;
+    return (vec2(c.r * 256.0 + c.g, c.b * 256.0 + c.a) / 32767.5 - 1.0) * displacementRange;
+}
+
 void main() {
     vec2 uv = gl_TexCoord[0].xy;
-    vec2 delta = uv - blackHolePos;
-    float dist = length(delta);
-
-    float radius = 0.2;
-    float strength = 0.03;
-
-    vec2 offset = vec2(0.0);
-    if (dist < radius) {
-        float factor = (1.0 - dist / radius);
-        float distortion = strength * factor * factor;
-        offset = normalize(delta) * distortion;
-    }
+    vec2 offset = lensOffset(uv - blackHolePos);
 
     vec4 color;
     color.r = texture2D(texture, uv + offset * 1.02).r;
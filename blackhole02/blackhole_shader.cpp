@@ -3,32 +3,71 @@
 #include <cmath>
 #include <iostream>
 
-int main() {
+#include "../common/asset_cache.hpp"
+#include "../common/headless.hpp"
+#include "../common/physics_thread.hpp"
+#include "../common/profiler_overlay.hpp"
+#include "../common/triple_buffer.hpp"
+
+constexpr double PHYSICS_DT = 0.001; // seconds per physics step (1000 Hz)
+
+int main(int argc, char** argv) {
+    const grav::HeadlessOptions headless = grav::parseHeadless(argc, argv);
+    const grav::ProfileOptions profile = grav::parseProfile(argc, argv);
+
+    // Black hole position
+    sf::Vector2f bhPos(400.f, 300.f);
+    float speed = 200.f;
+
+    // Movement keys, as a direction, from the render thread
+    grav::TripleBuffer<sf::Vector2f> steering;
+
+    auto step = [&](double dt) {
+        steering.update();
+        bhPos += steering.read() * (speed * float(dt));
+
+        // Keep on screen
+        bhPos.x = std::clamp(bhPos.x, 0.f, 800.f);
+        bhPos.y = std::clamp(bhPos.y, 0.f, 600.f);
+    };
+
+    if (headless.enabled)
+        return grav::runHeadless("blackhole_shader", headless, PHYSICS_DT, 1, step, [&](std::ostream& os) {
+            os << "blackhole " << bhPos.x << " " << bhPos.y << "\n";
+        });
+
     sf::RenderWindow window(sf::VideoMode(800, 600), "Black Hole Visual FX");
     window.setFramerateLimit(60);
 
     // Load shader
-    sf::Shader shader;
-    if (!shader.loadFromFile("lens_distortion.frag", sf::Shader::Fragment)) {
+    sf::Shader* shader = grav::AssetCache::instance().shader("lens_distortion.frag", sf::Shader::Fragment);
+    if (!shader) {
         std::cerr << "Error: Couldn't load lens_distortion.frag\n";
         return -1;
     }
 
-    // Background
-    sf::Texture bgTexture;
-    bgTexture.create(800, 600);
-    sf::Image bgImage;
-    bgImage.create(800, 600, sf::Color::Black);
-
-    // Fill with stars
-    for (int i = 0; i < 400; ++i) {
-        int x = rand() % 800;
-        int y = rand() % 600;
-        bgImage.setPixel(x, y, sf::Color(200 + rand() % 55, 200 + rand() % 55, 255));
+    // Lens offsets, baked once per --lens-* setting
+    grav::LensParams lensParams;
+    lensParams.profile = grav::LensProfile::Inverse;
+    lensParams.strength = 0.25f;
+    lensParams.softening = 0.1f;
+    const grav::LensTexture* lensMap = grav::AssetCache::instance().lens(grav::parseLensParams(argc, argv, lensParams));
+    if (!lensMap) {
+        std::cerr << "Error: Couldn't create the lens displacement map\n";
+        return -1;
     }
-
-    bgTexture.update(bgImage);
-    sf::Sprite background(bgTexture);
+    lensMap->bind(*shader);
+
+    // Starfield background, generated once per --sky-* setting
+    grav::SkyParams skyParams;
+    skyParams.stars = 1500.f;
+    const sf::Texture* bgTexture = grav::AssetCache::instance().sky(grav::parseSkyParams(argc, argv, skyParams));
+    if (!bgTexture) {
+        std::cerr << "Error: Couldn't create the background\n";
+        return -1;
+    }
+    sf::Sprite background(*bgTexture);
+    grav::AssetCache::instance().report(std::clog);
 
     // Accretion ring generation
     sf::RenderTexture ringRender;
@@ -63,34 +102,42 @@ int main() {
     sf::RenderTexture scene;
     scene.create(800, 600);
 
-    // Black hole position
-    sf::Vector2f bhPos(400.f, 300.f);
-    float speed = 200.f;
+    grav::PhysicsThread<sf::Vector2f> physics(PHYSICS_DT, step, [&](sf::Vector2f& out) { out = bhPos; });
+    physics.setRate(1.0 / PHYSICS_DT);
+    physics.start();
 
     sf::Clock clock;
+    profile.apply();
+    grav::ProfilerOverlay overlay(profile.overlay);
 
     while (window.isOpen()) {
-        float dt = clock.restart().asSeconds();
+        grav::ProfilePhases phase("events");
         sf::Event event;
         while (window.pollEvent(event)) {
+            overlay.handle(event);
             if (event.type == sf::Event::Closed) window.close();
         }
 
         // Movement
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) bhPos.x -= speed * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) bhPos.x += speed * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up)) bhPos.y -= speed * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) bhPos.y += speed * dt;
-
-        // Keep on screen
-        bhPos.x = std::clamp(bhPos.x, 0.f, 800.f);
-        bhPos.y = std::clamp(bhPos.y, 0.f, 600.f);
+        sf::Vector2f dir(0.f, 0.f);
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) dir.x -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) dir.x += 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up)) dir.y -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) dir.y += 1.f;
+        steering.write() = dir;
+        steering.publish();
+
+        // Blend the two latest physics snapshots
+        phase.next("scene");
+        physics.poll();
+        const float t = float(physics.alpha());
+        const sf::Vector2f pos = physics.previous().state + (physics.current().state - physics.previous().state) * t;
 
         // Accretion ring pulsing
         float pulse = 1.0f + 0.1f * std::sin(clock.getElapsedTime().asSeconds() * 4);
         ring.setScale(pulse, pulse);
         ring.setRotation(clock.getElapsedTime().asSeconds() * 20);
-        ring.setPosition(bhPos);
+        ring.setPosition(pos);
 
         // Render scene to texture
         scene.clear();
@@ -99,18 +146,22 @@ int main() {
         scene.display();
 
         // Apply shader with black hole position
-        shader.setUniform("texture", scene.getTexture());
-        shader.setUniform("resolution", sf::Vector2f(800, 600));
-        shader.setUniform("blackHolePos", bhPos);
-        shader.setUniform("time", clock.getElapsedTime().asSeconds());
+        phase.next("shader");
+        shader->setUniform("texture", scene.getTexture());
+        shader->setUniform("resolution", sf::Vector2f(800, 600));
+        shader->setUniform("blackHolePos", pos);
+        shader->setUniform("time", clock.getElapsedTime().asSeconds());
 
         // Final draw
         sf::Sprite screenSprite(scene.getTexture());
 
         window.clear();
-        window.draw(screenSprite, &shader);
+        window.draw(screenSprite, shader);
+        phase.next("display");
+        overlay.draw(window);
         window.display();
     }
 
+    profile.writeTrace(std::clog);
     return 0;
 }
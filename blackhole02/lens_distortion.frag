@@ -1,26 +1,26 @@
 // lens_distortion.frag
 uniform sampler2D texture;
+uniform sampler2D displacement;  // baked lens offsets, see common/displacement_map.hpp
+uniform float displacementRange;
 uniform vec2 resolution;
 uniform vec2 blackHolePos;
 uniform float time;
 
+// Offset for a pixel at delta from the hole: the map centred on the hole
+vec2 lensOffset(vec2 delta) {
+    vec4 c = texture2D(displacement, delta * 0.5 + 0.5) * 255.0;
+    return (vec2(c.r * 256.0 + c.g, c.b * 256.0 + c.a) / 32767.5 - 1.0) * displacementRange;
+}
+
 void main() {
     vec2 uv = gl_FragCoord.xy / resolution;
-    vec2 bh = blackHolePos / resolution;
-
-    vec2 dir = uv - bh;
-    float r = length(dir);
-
-    float strength = 0.25;
-    float distortion = strength / (r + 0.1); // avoid divide-by-zero
-
-    vec2 offset = dir * distortion;
+    vec2 offset = lensOffset(uv - blackHolePos / resolution);
 
     // chromatic aberration (RGB channels offset slightly)
     vec3 col;
-    col.r = texture2D(texture, uv - offset * 0.98).r;
-    col.g = texture2D(texture, uv - offset).g;
-    col.b = texture2D(texture, uv - offset * 1.02).b;
+    col.r = texture2D(texture, uv + offset * 0.98).r;
+    col.g = texture2D(texture, uv + offset).g;
+    col.b = texture2D(texture, uv + offset * 1.02).b;
 
     gl_FragColor = vec4(col, 1.0);
 }
@@ -5,40 +5,200 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
 
-struct Star {
-    sf::Vector2f position;
-    float angle;
-    float radius;
-    float speed;
-    float fade;
+#include "../common/asset_cache.hpp"
+#include "../common/frame_recorder.hpp"
+#include "../common/headless.hpp"
+#include "../common/physics_thread.hpp"
+#include "../common/snapshot.hpp"
+#include "../common/star_collisions.hpp"
+#include "../common/star_field.hpp"
+#include "../common/task_scheduler.hpp"
+#include "../common/profiler_overlay.hpp"
+#include "../common/trails.hpp"
+#include "../common/triple_buffer.hpp"
+
+constexpr double PHYSICS_DT = 0.001; // seconds per physics step (1000 Hz)
+
+// Keyboard state handed from the render thread to the physics thread
+struct Controls {
+    float moveX = 0.f, moveY = 0.f;
+    unsigned spawned = 0, removed = 0; // running totals of A / D presses
+};
+
+// What the renderer needs from the physics thread
+struct Snapshot {
+    sf::Vector2f bhPos;
+    float horizon = 40.f;
+    double holeMass = 0.0;
+    grav::CollisionStats events;
+    std::vector<float> x, y, fade;
 };
 
-int main() {
+int main(int argc, char** argv) {
+    // --stars N picks the initial star count, --trail N the frames of trail kept per star
+    std::size_t starCount = 40;
+    std::size_t trailLength = 32;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--stars") starCount = std::strtoul(argv[i + 1], nullptr, 10);
+        if (std::string(argv[i]) == "--trail") trailLength = std::strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    const grav::HeadlessOptions headless = grav::parseHeadless(argc, argv);
+    const grav::ProfileOptions profile = grav::parseProfile(argc, argv);
+    const grav::RecordOptions record = grav::parseRecord(argc, argv);
+    const grav::CheckpointOptions checkpoint = grav::parseCheckpoint(argc, argv);
+
+    // Stars
+    grav::StarField stars;
+    stars.reserve(starCount);
+    stars.infallRate = 20.f; // fast enough that a share of the stars reaches the hole before fading
+    stars.minRadius = 0.f;   // the hole's horizon and tidal radius decide, see StarCollisions
+    auto spawnStar = [&]() {
+        stars.add(static_cast<float>(rand() % 360),
+                  150.f + static_cast<float>(rand() % 150),
+                  0.6f + static_cast<float>(rand() % 100) / 300.f,
+                  255.f,
+                  static_cast<std::uint32_t>(rand()),
+                  stars.massMin + (stars.massMax - stars.massMin) * static_cast<float>(rand() % 1000) / 1000.f);
+    };
+    for (std::size_t i = 0; i < starCount; ++i) spawnStar();
+    std::clog << stars.size() << " stars, " << grav::simdName(grav::simdLevel()) << " update kernel, "
+              << grav::TaskScheduler::instance().threadCount() << " threads\n";
+
+    // Physics state, owned by the physics thread once it starts
+    sf::Vector2f bhPos(400.f, 300.f);
+    float speed = 200.f;
+    unsigned spawnedApplied = 0, removedApplied = 0;
+    grav::TripleBuffer<Controls> controls;
+    grav::Hole hole;
+    grav::StarCollisions collisions;
+    std::uint64_t stepCount = 0;
+    stars.update(0.f, bhPos.x, bhPos.y); // place the stars before the first step
+
+    // Checkpoints hold every star field plus the hole and the event counts
+    auto saveCheckpoint = [&]() {
+        grav::SnapshotWriter out;
+        out.info.count = stars.size();
+        out.info.step = stepCount;
+        out.info.time = double(stepCount) * PHYSICS_DT;
+        out.info.dims = 2;
+        out.info.units = "length=px time=s mass=Msun";
+        const double holeState[3] = {bhPos.x, bhPos.y, hole.mass};
+        const std::uint64_t events[3] = {collisions.stats.accreted, collisions.stats.disrupted, collisions.stats.merged};
+        out.column("x", stars.x);
+        out.column("y", stars.y);
+        out.column("angle", stars.angle);
+        out.column("radius", stars.radius);
+        out.column("speed", stars.speed);
+        out.column("fade", stars.fade);
+        out.column("mass", stars.mass);
+        out.column("starRadius", stars.starRadius);
+        out.column("rng", stars.rng);
+        out.column("hole", holeState, 3);
+        out.column("events", events, 3);
+        return out.write(checkpoint.path);
+    };
+    auto restoreCheckpoint = [&]() {
+        grav::SnapshotFile in(checkpoint.restart);
+        std::size_t n = 0;
+        const double* holeState = in.column<double>("hole", &n);
+        const std::uint64_t* events = in.column<std::uint64_t>("events");
+        if (!in.isOpen() || !holeState || n != 3 || !events) return false;
+        grav::StarField loaded = stars;
+        bool ok = in.read("x", loaded.x) && in.read("y", loaded.y) && in.read("angle", loaded.angle) &&
+                  in.read("radius", loaded.radius) && in.read("speed", loaded.speed) && in.read("fade", loaded.fade) &&
+                  in.read("mass", loaded.mass) && in.read("starRadius", loaded.starRadius) && in.read("rng", loaded.rng);
+        for (const auto* v : {&loaded.x, &loaded.y, &loaded.radius, &loaded.speed, &loaded.fade, &loaded.mass, &loaded.starRadius})
+            ok = ok && v->size() == loaded.size();
+        if (!ok || loaded.rng.size() != loaded.size() || loaded.size() != in.info().count) return false;
+        stars = std::move(loaded);
+        bhPos = sf::Vector2f(float(holeState[0]), float(holeState[1]));
+        hole.x = bhPos.x;
+        hole.y = bhPos.y;
+        hole.mass = holeState[2];
+        collisions.stats = {events[0], events[1], events[2]};
+        stepCount = in.info().step;
+        return true;
+    };
+    if (!checkpoint.restart.empty()) {
+        if (!restoreCheckpoint()) {
+            std::cerr << "Cannot restart from " << checkpoint.restart << "\n";
+            return 1;
+        }
+        std::clog << "restarted from " << checkpoint.restart << " at step " << stepCount << ", " << stars.size() << " stars\n";
+    }
+
+    auto step = [&](double dt) {
+        controls.update();
+        const Controls& in = controls.read();
+        for (; spawnedApplied < in.spawned; ++spawnedApplied) spawnStar();
+        for (; removedApplied < in.removed; ++removedApplied)
+            if (stars.size() > 0) stars.pop_back();
+
+        bhPos.x = std::clamp(bhPos.x + in.moveX * speed * float(dt), 0.f, 800.f);
+        bhPos.y = std::clamp(bhPos.y + in.moveY * speed * float(dt), 0.f, 600.f);
+
+        // Update stars in parallel chunks (a multiple of the widest SIMD width)
+        grav::TaskScheduler::instance().parallelFor(0, stars.size(), 16384, [&](std::size_t first, std::size_t last) {
+            stars.update(float(dt), bhPos.x, bhPos.y, first, last);
+        });
+
+        // Accretion, tidal disruption and mergers
+        hole.x = bhPos.x;
+        hole.y = bhPos.y;
+        collisions.resolve(stars, hole);
+
+        if (checkpoint.due(++stepCount) && !saveCheckpoint())
+            std::cerr << "Failed to write checkpoint " << checkpoint.path << "\n";
+    };
+
+    if (headless.enabled)
+        return grav::runHeadless("blackhole_simulation", headless, PHYSICS_DT, stars.size(), step, [&](std::ostream& os) {
+            const grav::CollisionStats& e = collisions.stats;
+            os << "blackhole " << bhPos.x << " " << bhPos.y << " mass " << hole.mass << " horizon " << hole.horizon()
+               << " accreted " << e.accreted << " disrupted " << e.disrupted << " merged " << e.merged << "\n";
+            for (std::size_t i = 0; i < stars.size(); ++i)
+                os << "star " << stars.x[i] << " " << stars.y[i] << " " << stars.fade[i] << "\n";
+        });
+
     sf::RenderWindow window(sf::VideoMode(800, 600), "2D Black Hole Simulation");
-    window.setFramerateLimit(60);
+    window.setFramerateLimit(record.enabled ? 0 : 60);
 
-    sf::Shader shader;
-    if (!shader.loadFromFile("lens_distortion.frag", sf::Shader::Fragment)) {
+    sf::Shader* shader = grav::AssetCache::instance().shader("lens_distortion.frag", sf::Shader::Fragment);
+    if (!shader) {
         std::cerr << "Failed to load shader\n";
         return -1;
     }
 
-    sf::RenderTexture scene;
-    scene.create(800, 600);
+    // Lens offsets, baked once per --lens-* setting
+    grav::LensParams lensParams;
+    lensParams.profile = grav::LensProfile::Inverse;
+    lensParams.strength = 0.3f;
+    lensParams.softening = 0.05f;
+    const grav::LensTexture* lensMap = grav::AssetCache::instance().lens(grav::parseLensParams(argc, argv, lensParams));
+    if (!lensMap) {
+        std::cerr << "Failed to create the lens displacement map\n";
+        return -1;
+    }
+    lensMap->bind(*shader);
 
-    // Nebula Background
-    sf::Image bgImage;
-    bgImage.create(800, 600, sf::Color::Black);
-    for (int i = 0; i < 1000; ++i) {
-        int x = rand() % 800;
-        int y = rand() % 600;
-        sf::Color c(rand() % 255, rand() % 255, rand() % 255, 150);
-        bgImage.setPixel(x, y, c);
+    // Nebula background, generated once per --sky-* setting
+    grav::SkyParams skyParams;
+    skyParams.nebula = 0.5f;
+    const sf::Texture* bgTexture = grav::AssetCache::instance().sky(grav::parseSkyParams(argc, argv, skyParams));
+    if (!bgTexture) {
+        std::cerr << "Failed to create the background\n";
+        return -1;
     }
-    sf::Texture bgTexture;
-    bgTexture.loadFromImage(bgImage);
-    sf::Sprite background(bgTexture);
+    sf::Sprite background(*bgTexture);
+    grav::AssetCache::instance().report(std::clog);
+
+    sf::RenderTexture scene;
+    scene.create(800, 600);
 
     // Accretion disk
     sf::RenderTexture ringRender;
@@ -57,90 +217,168 @@ int main() {
     sf::Sprite ring(ringRender.getTexture());
     ring.setOrigin(center);
 
-    // Stars
-    std::vector<Star> stars;
-    auto spawnStar = [&]() {
-        Star s;
-        s.angle = static_cast<float>(rand() % 360);
-        s.radius = 150.f + static_cast<float>(rand() % 150);
-        s.speed = 0.6f + static_cast<float>(rand() % 100) / 300.f;
-        s.fade = 255.f;
-        stars.push_back(s);
+    // Light arcs: every star's recent path, fading behind it
+    grav::Trails trails(stars.x.size(), trailLength);
+    std::vector<float> trailX, trailY;
+
+    auto publish = [&](Snapshot& out) {
+        out.bhPos = bhPos;
+        out.horizon = hole.horizon();
+        out.holeMass = hole.mass;
+        out.events = collisions.stats;
+        out.x.assign(stars.x.begin(), stars.x.end());
+        out.y.assign(stars.y.begin(), stars.y.end());
+        out.fade.assign(stars.fade.begin(), stars.fade.end());
     };
-    for (int i = 0; i < 40; ++i) spawnStar();
 
-    // Light arcs (curved lines)
-    sf::VertexArray arcs(sf::LinesStrip);
+    // Recording renders offline: the physics steps on this thread, exactly
+    // 1 / fps simulated seconds per frame, and frames go to the recorder
+    // from an offscreen target however long they take.
+    grav::PhysicsThread<Snapshot> physics(PHYSICS_DT, step, publish);
+    grav::FrameRecorder recorder;
+    sf::RenderTexture output;
+    Snapshot recorded;
+    std::uint64_t stepsDone = 0;
+    if (record.enabled) {
+        output.create(800, 600);
+        if (!recorder.open(record, 800, 600)) {
+            std::cerr << "Failed to open " << record.path << "\n";
+            return -1;
+        }
+        publish(recorded);
+        std::clog << "recording to " << record.path << " (" << grav::videoFormatName(record.format) << ", "
+                  << record.fps << " fps" << (recorder.usesPixelBuffers() ? ", async readback" : "") << ")\n";
+    } else {
+        physics.setRate(1.0 / PHYSICS_DT);
+        physics.start();
+    }
 
-    sf::Vector2f bhPos(400.f, 300.f);
-    float speed = 200.f;
+    // E saves the scene as frame_NNN.png. With one buffer the readback is mapped
+    // at once on the render thread; only the PNG encoding happens off it
+    grav::FrameRecorder screenshots;
+    screenshots.buffers = 1;
+
+    Controls input;
     sf::Clock clock;
-    int frameCount = 0;
+    sf::Clock titleClock;
+    profile.apply();
+    grav::ProfilerOverlay overlay(profile.overlay);
 
     while (window.isOpen()) {
-        float dt = clock.restart().asSeconds();
-
+        grav::ProfilePhases phase("events");
         sf::Event event;
         while (window.pollEvent(event)) {
+            overlay.handle(event);
             if (event.type == sf::Event::Closed) window.close();
             if (event.type == sf::Event::KeyPressed) {
                 if (event.key.code == sf::Keyboard::E) {
-                    std::ostringstream ss;
-                    ss << "frame_" << std::setw(3) << std::setfill('0') << frameCount++ << ".png";
-                    scene.getTexture().copyToImage().saveToFile(ss.str());
-                    std::cout << "Saved " << ss.str() << "\n";
+                    if (!screenshots.isOpen()) {
+                        grav::RecordOptions png;
+                        png.path = "frame_%03d.png";
+                        png.format = grav::VideoFormat::Png;
+                        screenshots.open(png, 800, 600);
+                    }
+                    char name[32];
+                    std::snprintf(name, sizeof(name), "frame_%03d.png", int(screenshots.captured()));
+                    screenshots.capture(scene);
+                    std::clog << "Saving " << name << "\n";
                 }
-                if (event.key.code == sf::Keyboard::A) spawnStar();
-                if (event.key.code == sf::Keyboard::D && !stars.empty()) stars.pop_back();
+                if (event.key.code == sf::Keyboard::A) ++input.spawned;
+                if (event.key.code == sf::Keyboard::D) ++input.removed;
             }
         }
 
         // Keyboard movement
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) bhPos.x -= speed * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) bhPos.x += speed * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up)) bhPos.y -= speed * dt;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) bhPos.y += speed * dt;
-
-        bhPos.x = std::clamp(bhPos.x, 0.f, 800.f);
-        bhPos.y = std::clamp(bhPos.y, 0.f, 600.f);
-        ring.setPosition(bhPos);
-        ring.setRotation(clock.getElapsedTime().asSeconds() * 20);
-
-        // Update stars
-        for (auto& s : stars) {
-            s.angle += s.speed * dt;
-            s.radius -= 10.f * dt;
-            s.fade -= 30.f * dt;
-            if (s.radius < 40.f || s.fade <= 0) {
-                s.radius = 200.f + rand() % 150;
-                s.angle = rand() % 360;
-                s.fade = 255.f;
-            }
-            s.position = bhPos + sf::Vector2f(std::cos(s.angle) * s.radius, std::sin(s.angle) * s.radius);
+        input.moveX = float(sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) - float(sf::Keyboard::isKeyPressed(sf::Keyboard::Left));
+        input.moveY = float(sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) - float(sf::Keyboard::isKeyPressed(sf::Keyboard::Up));
+        controls.write() = input;
+        controls.publish();
+
+        // Blend the two latest physics snapshots, or step to this frame's time when recording
+        if (record.enabled) {
+            phase.next("physics");
+            const double frameTime = double(recorder.captured() + 1) / record.fps;
+            for (; double(stepsDone) * PHYSICS_DT < frameTime - 0.5 * PHYSICS_DT; ++stepsDone) step(PHYSICS_DT);
+            publish(recorded);
+        } else {
+            physics.poll();
         }
+        phase.next("scene");
+        const Snapshot& prev = record.enabled ? recorded : physics.previous().state;
+        const Snapshot& curr = record.enabled ? recorded : physics.current().state;
+        const float t = record.enabled ? 1.f : float(physics.alpha());
+        const sf::Vector2f bh = prev.bhPos + (curr.bhPos - prev.bhPos) * t;
+        const float seconds = record.enabled ? float(double(stepsDone) * PHYSICS_DT) : clock.getElapsedTime().asSeconds();
 
-        // Build arcs
-        arcs.clear();
-        for (auto& s : stars) {
-            arcs.append(sf::Vertex(s.position, sf::Color(255, 255, 200, s.fade)));
+        ring.setPosition(bh);
+        ring.setRotation(seconds * 20);
+        ring.setScale(curr.horizon / 40.f, curr.horizon / 40.f); // the disk grows with the hole
+
+        // Event counters in the title, refreshed once a second
+        if (titleClock.getElapsedTime().asSeconds() >= 1.f) {
+            titleClock.restart();
+            std::ostringstream title;
+            title << "2D Black Hole Simulation - " << std::setprecision(4) << curr.holeMass << " Msun, "
+                  << curr.events.accreted << " accreted, " << curr.events.disrupted << " disrupted, "
+                  << curr.events.merged << " merged";
+            window.setTitle(title.str());
+        }
+
+        // Extend the arcs; a star whose fade went up was respawned, so it is
+        // not blended and its trail starts over, as does a newly added star
+        trails.resize(curr.x.size());
+        trailX.resize(curr.x.size());
+        trailY.resize(curr.x.size());
+        for (std::size_t i = 0; i < curr.x.size(); ++i) {
+            sf::Vector2f p(curr.x[i], curr.y[i]);
+            if (i >= prev.x.size() || curr.fade[i] > prev.fade[i]) trails.clear(i);
+            else p = sf::Vector2f(prev.x[i], prev.y[i]) + (p - sf::Vector2f(prev.x[i], prev.y[i])) * t;
+            trailX[i] = p.x;
+            trailY[i] = p.y;
         }
+        trails.build(trailX.data(), trailY.data(), [&](std::size_t i) {
+            return sf::Color(255, 255, 200, static_cast<sf::Uint8>(curr.fade[i]));
+        });
+        trails.push(trailX.data(), trailY.data());
 
         // Render to texture
         scene.clear();
         scene.draw(background);
-        scene.draw(arcs);
+        trails.draw(scene);
         scene.draw(ring, sf::BlendAdd);
         scene.display();
 
-        shader.setUniform("texture", scene.getTexture());
-        shader.setUniform("resolution", sf::Vector2f(800, 600));
-        shader.setUniform("blackHolePos", bhPos);
+        phase.next("shader");
+        shader->setUniform("texture", scene.getTexture());
+        shader->setUniform("resolution", sf::Vector2f(800, 600));
+        shader->setUniform("blackHolePos", bh);
 
         sf::Sprite finalScene(scene.getTexture());
         window.clear();
-        window.draw(finalScene, &shader);
+        if (record.enabled) {
+            output.clear();
+            output.draw(finalScene, shader);
+            output.display();
+            phase.next("capture");
+            recorder.capture(output);
+            window.draw(sf::Sprite(output.getTexture()));
+            if (record.frames > 0 && recorder.captured() >= record.frames) window.close();
+        } else {
+            window.draw(finalScene, shader);
+        }
+        phase.next("display");
+        overlay.draw(window);
         window.display();
     }
 
+    if (record.enabled) {
+        output.setActive(true);
+        recorder.finish(&std::clog);
+    }
+    if (screenshots.isOpen()) {
+        scene.setActive(true);
+        screenshots.finish();
+    }
+    profile.writeTrace(std::clog);
     return 0;
 }
@@ -0,0 +1,139 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "displacement_map.hpp"
+#include "sky.hpp"
+
+namespace grav {
+
+// A DisplacementMap uploaded for the lens_distortion.frag shaders.
+struct LensTexture {
+    sf::Texture texture;
+    float range = 1.f;
+
+    void bind(sf::Shader& shader) const {
+        shader.setUniform("displacement", texture);
+        shader.setUniform("displacementRange", range);
+    }
+};
+
+// Process-wide cache of fonts, textures, shaders, lens maps and skies. Each file is loaded once
+// and shared as a stable pointer for the life of the process; a failed load is
+// remembered as well, so asking again every frame never touches the disk.
+// Load times are kept for report().
+class AssetCache {
+public:
+    static AssetCache& instance() {
+        static AssetCache cache;
+        return cache;
+    }
+
+    AssetCache(const AssetCache&) = delete;
+    AssetCache& operator=(const AssetCache&) = delete;
+
+    // nullptr if the file could not be loaded.
+    const sf::Font* font(const std::string& path) {
+        return get<sf::Font>(fonts_, path, [](sf::Font& f, const std::string& p) { return f.loadFromFile(p); });
+    }
+
+    const sf::Texture* texture(const std::string& path, bool smooth = false) {
+        return get<sf::Texture>(textures_, path, [smooth](sf::Texture& t, const std::string& p) {
+            if (!t.loadFromFile(p)) return false;
+            t.setSmooth(smooth);
+            return true;
+        });
+    }
+
+    // Shaders are handed out mutable so callers can set uniforms.
+    sf::Shader* shader(const std::string& path, sf::Shader::Type type) {
+        return get<sf::Shader>(shaders_, path, [type](sf::Shader& s, const std::string& p) {
+            return s.loadFromFile(p, type);
+        });
+    }
+
+    // The lens displacement map for p, from the on-disk cache or baked now.
+    const LensTexture* lens(const LensParams& p) {
+        return get<LensTexture>(lenses_, DisplacementMap::cacheName(p), [&p](LensTexture& t, const std::string&) {
+            const DisplacementMap map = DisplacementMap::cached(p);
+            if (!t.texture.create(map.width(), map.height())) return false;
+            t.texture.update(map.pixels());
+            t.range = map.range();
+            return true;
+        });
+    }
+
+    // The generated sky for p, from the on-disk cache or rendered now.
+    const sf::Texture* sky(const SkyParams& p) {
+        return get<sf::Texture>(textures_, SkyImage::cacheName(p), [&p](sf::Texture& t, const std::string&) {
+            const SkyImage sky = SkyImage::cached(p);
+            if (!t.create(sky.width(), sky.height())) return false;
+            t.update(sky.pixels());
+            return true;
+        });
+    }
+
+    // One line per asset: kind, path, load time in milliseconds, and status.
+    void report(std::ostream& os) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        double total = 0.0;
+        for (const Record& r : log_) {
+            os << r.kind << " " << r.path << " " << r.millis << " ms" << (r.ok ? "" : " (failed)") << "\n";
+            total += r.millis;
+        }
+        os << log_.size() << " assets loaded in " << total << " ms\n";
+    }
+
+private:
+    template <typename T>
+    struct Entry {
+        T asset;
+        bool ok = false;
+    };
+    template <typename T>
+    using Table = std::unordered_map<std::string, std::unique_ptr<Entry<T>>>;
+
+    struct Record {
+        const char* kind;
+        std::string path;
+        double millis;
+        bool ok;
+    };
+
+    AssetCache() = default;
+
+    mutable std::mutex mutex_;
+    Table<sf::Font> fonts_;
+    Table<sf::Texture> textures_;
+    Table<sf::Shader> shaders_;
+    Table<LensTexture> lenses_;
+    std::vector<Record> log_;
+
+    static const char* kindOf(const sf::Font*) { return "font"; }
+    static const char* kindOf(const sf::Texture*) { return "texture"; }
+    static const char* kindOf(const sf::Shader*) { return "shader"; }
+    static const char* kindOf(const LensTexture*) { return "lens"; }
+
+    template <typename T, typename Load>
+    T* get(Table<T>& table, const std::string& path, Load&& load) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = table.find(path);
+        if (it == table.end()) {
+            auto entry = std::make_unique<Entry<T>>();
+            const auto start = std::chrono::steady_clock::now();
+            entry->ok = load(entry->asset, path);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            log_.push_back({kindOf(static_cast<T*>(nullptr)), path, ms, entry->ok});
+            it = table.emplace(path, std::move(entry)).first;
+        }
+        return it->second->ok ? &it->second->asset : nullptr;
+    }
+};
+
+} // namespace grav
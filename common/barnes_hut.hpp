@@ -0,0 +1,211 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "bodies.hpp"
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Barnes-Hut tree over a Bodies store: a quadtree for D == 2, an octree for D == 3.
+// Cells whose size/distance ratio is below `theta` are replaced by their centre of
+// mass, which brings the force evaluation down to O(N log N).
+template <typename T, int D>
+class BarnesHut {
+public:
+    static constexpr int CHILDREN = 1 << D;
+
+    T theta = T(0.5);       // opening angle, 0 degenerates to direct summation
+    T softening = T(0);     // Plummer softening length
+    int leafSize = 8;       // bodies per leaf before a cell is split
+    int maxDepth = 48;      // guards against coincident bodies
+
+    struct Node {
+        T center[D];
+        T halfSize;
+        T mass;
+        T com[D];
+        std::int32_t firstChild;  // -1 for leaves, otherwise CHILDREN consecutive nodes
+        std::uint32_t begin, end; // body range inside `order`
+    };
+
+    const std::vector<Node>& nodes() const { return nodes_; }
+    const std::vector<std::uint32_t>& order() const { return order_; }
+
+    void build(const Bodies<T, D>& b) {
+        const std::size_t n = b.size();
+        nodes_.clear();
+        order_.resize(n);
+        scratch_.resize(n);
+        for (std::size_t i = 0; i < n; ++i) order_[i] = static_cast<std::uint32_t>(i);
+        if (n == 0) return;
+
+        T lo[D], hi[D];
+        for (int k = 0; k < D; ++k) {
+            auto mm = std::minmax_element(b.pos[k].begin(), b.pos[k].end());
+            lo[k] = *mm.first;
+            hi[k] = *mm.second;
+        }
+        Node root{};
+        T extent = T(0);
+        for (int k = 0; k < D; ++k) {
+            root.center[k] = (lo[k] + hi[k]) * T(0.5);
+            extent = std::max(extent, hi[k] - lo[k]);
+        }
+        root.halfSize = extent * T(0.5) * T(1.0001) + T(1e-12);
+        root.begin = 0;
+        root.end = static_cast<std::uint32_t>(n);
+        nodes_.reserve(2 * n / std::max(1, leafSize) * CHILDREN + 1);
+        nodes_.push_back(root);
+        buildNode(b, 0, 0);
+    }
+
+    // Overwrites b.acc with the gravitational acceleration on every body.
+    // The walk is split across the shared scheduler; each body is independent.
+    void computeAccelerations(Bodies<T, D>& b, T G) {
+        build(b);
+        TaskScheduler::instance().parallelFor(0, b.size(), 512, [&](std::size_t first, std::size_t last) {
+            accelerate(b, G, first, last);
+        });
+    }
+
+    // Tree walk for the body range [first, last); build() must have run.
+    void accelerate(Bodies<T, D>& b, T G, std::size_t first, std::size_t last) const {
+        if (nodes_.empty()) return;
+        const T eps2 = softening * softening;
+        const T theta2 = theta * theta;
+        std::uint32_t stack[64 * CHILDREN];
+
+        for (std::size_t i = first; i < last; ++i) {
+            T p[D], a[D];
+            for (int k = 0; k < D; ++k) {
+                p[k] = b.pos[k][i];
+                a[k] = T(0);
+            }
+
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const Node& node = nodes_[stack[--top]];
+                if (node.mass <= T(0)) continue;
+
+                if (node.firstChild < 0) {
+                    for (std::uint32_t s = node.begin; s < node.end; ++s) {
+                        const std::uint32_t j = order_[s];
+                        if (j == i) continue;
+                        T d[D];
+                        for (int k = 0; k < D; ++k) d[k] = b.pos[k][j] - p[k];
+                        addPull(a, d, b.mass[j], eps2);
+                    }
+                    continue;
+                }
+
+                T d[D], r2 = T(0);
+                bool inside = true;
+                for (int k = 0; k < D; ++k) {
+                    d[k] = node.com[k] - p[k];
+                    r2 += d[k] * d[k];
+                    inside = inside && std::abs(p[k] - node.center[k]) <= node.halfSize;
+                }
+                const T size = node.halfSize * T(2);
+                if (!inside && size * size < theta2 * r2) {
+                    addPull(a, d, node.mass, eps2);
+                } else {
+                    for (int c = 0; c < CHILDREN; ++c)
+                        stack[top++] = static_cast<std::uint32_t>(node.firstChild + c);
+                }
+            }
+
+            for (int k = 0; k < D; ++k) b.acc[k][i] = G * a[k];
+        }
+    }
+
+private:
+    std::vector<Node> nodes_;
+    std::vector<std::uint32_t> order_;
+    std::vector<std::uint32_t> scratch_;
+
+    static void addPull(T (&a)[D], const T (&d)[D], T m, T eps2) {
+        T r2 = eps2;
+        for (int k = 0; k < D; ++k) r2 += d[k] * d[k];
+        if (r2 <= T(0)) return;
+        const T inv = T(1) / std::sqrt(r2);
+        const T f = m * inv * inv * inv;
+        for (int k = 0; k < D; ++k) a[k] += f * d[k];
+    }
+
+    int childOf(const Bodies<T, D>& b, const Node& node, std::uint32_t i) const {
+        int c = 0;
+        for (int k = 0; k < D; ++k)
+            if (b.pos[k][i] >= node.center[k]) c |= 1 << k;
+        return c;
+    }
+
+    void buildNode(const Bodies<T, D>& b, std::uint32_t index, int depth) {
+        const std::uint32_t begin = nodes_[index].begin;
+        const std::uint32_t end = nodes_[index].end;
+
+        if (static_cast<int>(end - begin) <= leafSize || depth >= maxDepth) {
+            Node& leaf = nodes_[index];
+            leaf.firstChild = -1;
+            leaf.mass = T(0);
+            T weighted[D] = {};
+            for (std::uint32_t s = begin; s < end; ++s) {
+                const std::uint32_t j = order_[s];
+                leaf.mass += b.mass[j];
+                for (int k = 0; k < D; ++k) weighted[k] += b.mass[j] * b.pos[k][j];
+            }
+            for (int k = 0; k < D; ++k)
+                leaf.com[k] = leaf.mass > T(0) ? weighted[k] / leaf.mass : leaf.center[k];
+            return;
+        }
+
+        // Counting sort of the range by child cell.
+        std::uint32_t count[CHILDREN] = {};
+        for (std::uint32_t s = begin; s < end; ++s)
+            ++count[childOf(b, nodes_[index], order_[s])];
+        std::uint32_t offset[CHILDREN];
+        offset[0] = begin;
+        for (int c = 1; c < CHILDREN; ++c) offset[c] = offset[c - 1] + count[c - 1];
+        std::uint32_t cursor[CHILDREN];
+        std::copy(offset, offset + CHILDREN, cursor);
+        for (std::uint32_t s = begin; s < end; ++s) {
+            const std::uint32_t j = order_[s];
+            scratch_[cursor[childOf(b, nodes_[index], j)]++] = j;
+        }
+        std::copy(scratch_.begin() + begin, scratch_.begin() + end, order_.begin() + begin);
+
+        const std::int32_t first = static_cast<std::int32_t>(nodes_.size());
+        const T quarter = nodes_[index].halfSize * T(0.5);
+        for (int c = 0; c < CHILDREN; ++c) {
+            Node child{};
+            for (int k = 0; k < D; ++k)
+                child.center[k] = nodes_[index].center[k] + ((c >> k) & 1 ? quarter : -quarter);
+            child.halfSize = quarter;
+            child.begin = offset[c];
+            child.end = offset[c] + count[c];
+            child.firstChild = -1;
+            nodes_.push_back(child);
+        }
+        nodes_[index].firstChild = first;
+
+        T mass = T(0);
+        T weighted[D] = {};
+        for (int c = 0; c < CHILDREN; ++c) {
+            const std::uint32_t ci = static_cast<std::uint32_t>(first + c);
+            if (nodes_[ci].end > nodes_[ci].begin) {
+                buildNode(b, ci, depth + 1);
+            }
+            mass += nodes_[ci].mass;
+            for (int k = 0; k < D; ++k) weighted[k] += nodes_[ci].mass * nodes_[ci].com[k];
+        }
+        Node& node = nodes_[index];
+        node.mass = mass;
+        for (int k = 0; k < D; ++k)
+            node.com[k] = mass > T(0) ? weighted[k] / mass : node.center[k];
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace grav {
+
+// Structure-of-arrays body store: one contiguous array per component.
+template <typename T, int D>
+struct Bodies {
+    std::vector<T> pos[D];
+    std::vector<T> vel[D];
+    std::vector<T> acc[D];
+    std::vector<T> mass;
+
+    std::size_t size() const { return mass.size(); }
+
+    void reserve(std::size_t n) {
+        for (int k = 0; k < D; ++k) {
+            pos[k].reserve(n);
+            vel[k].reserve(n);
+            acc[k].reserve(n);
+        }
+        mass.reserve(n);
+    }
+
+    std::size_t add(const T (&p)[D], const T (&v)[D], T m) {
+        for (int k = 0; k < D; ++k) {
+            pos[k].push_back(p[k]);
+            vel[k].push_back(v[k]);
+            acc[k].push_back(T(0));
+        }
+        mass.push_back(m);
+        return mass.size() - 1;
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,189 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace grav {
+
+// Bounding-volume hierarchy over circles (bodies and their rings), for finding
+// the ones a view rectangle can see without testing every one of them.
+//
+// Nodes are axis-aligned boxes stored flat in depth-first order: a node's left
+// child follows it and its right child is at `right`. Every subtree covers a
+// contiguous run of order(), so a whole subtree can be handed out at once.
+// build() splits at the median of the longer axis down to LEAF_SIZE circles.
+// Moving circles are followed by refit(), one backward pass that regrows the
+// boxes around the same tree; update() does that every frame and rebuilds
+// only when the count changed or the refitted boxes have grown to twice the
+// area they had when built.
+//
+// query() walks the boxes that overlap the view. A subtree whose box is
+// smaller than `clusterSize` is reported once as a cluster instead of circle
+// by circle, which is how sub-pixel crowds become a single splat: a zoomed
+// out view of a million bodies costs about one visit per covered pixel.
+//
+// A circle with a negative radius is empty: it is never reported and does not
+// enlarge any box.
+class CircleBvh {
+public:
+    static constexpr std::uint32_t LEAF_SIZE = 8;
+
+    struct Circle {
+        float x, y, r;
+    };
+
+    struct Box {
+        float minX, minY, maxX, maxY;
+
+        bool overlaps(const Box& b) const {
+            return minX <= b.maxX && b.minX <= maxX && minY <= b.maxY && b.minY <= maxY;
+        }
+        float area() const { return std::max(maxX - minX, 0.f) * std::max(maxY - minY, 0.f); }
+    };
+
+    std::size_t size() const { return order_.size(); }
+    std::size_t nodeCount() const { return nodes_.size(); }
+
+    // Circle index at position k of the tree's order; clusters are runs of it.
+    std::uint32_t item(std::size_t k) const { return order_[k]; }
+
+    // Builds the tree over circles 0..n-1; circle(i) returns circle i.
+    template <typename CircleFn>
+    void build(std::size_t n, CircleFn&& circle) {
+        centers_.resize(n);
+        for (std::uint32_t i = 0; i < n; ++i) {
+            const Circle c = circle(i);
+            centers_[i] = {c.x, c.y, i};
+        }
+        nodes_.clear();
+        nodes_.reserve(n / (LEAF_SIZE / 2) * 2 + 1);
+        order_.resize(n);
+        leafOf_.resize(n);
+        if (n > 0) split(0, std::uint32_t(n));
+        refit(circle);
+        builtArea_ = area_;
+    }
+
+    // Regrows every box around the circles' current positions: the circles
+    // are read in their own order, each widening its leaf, and then the inner
+    // nodes are merged from the bottom up.
+    template <typename CircleFn>
+    void refit(CircleFn&& circle) {
+        for (Node& node : nodes_)
+            if (node.right == 0) node.box = EMPTY;
+        for (std::uint32_t i = 0; i < leafOf_.size(); ++i) {
+            const Circle c = circle(i);
+            if (c.r < 0.f) continue;
+            Box& box = nodes_[leafOf_[i]].box;
+            box.minX = std::min(box.minX, c.x - c.r);
+            box.minY = std::min(box.minY, c.y - c.r);
+            box.maxX = std::max(box.maxX, c.x + c.r);
+            box.maxY = std::max(box.maxY, c.y + c.r);
+        }
+        area_ = 0.0;
+        for (std::size_t k = nodes_.size(); k-- > 0;) {
+            Node& node = nodes_[k];
+            if (node.right != 0) {
+                const Box& a = nodes_[k + 1].box;
+                const Box& b = nodes_[node.right].box;
+                node.box = {std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::max(a.maxX, b.maxX),
+                            std::max(a.maxY, b.maxY)};
+            }
+            area_ += node.box.area();
+        }
+    }
+
+    // Refits the tree to this frame's circles, or rebuilds it if that would
+    // leave it too loose to cull well.
+    template <typename CircleFn>
+    void update(std::size_t n, CircleFn&& circle) {
+        if (n != size()) {
+            build(n, circle);
+            return;
+        }
+        refit(circle);
+        if (area_ > 2.0 * builtArea_ + 1.0) build(n, circle);
+    }
+
+    // Calls item(i) for the circles of every leaf whose box overlaps the view
+    // (so a few just outside it may come too), and cluster(x, y, first, count)
+    // for every subtree smaller than clusterSize that overlaps it: (x, y) is
+    // the centre of its box and order positions [first, first + count) the
+    // circles inside.
+    template <typename ItemFn, typename ClusterFn>
+    void query(const Box& view, float clusterSize, ItemFn&& item, ClusterFn&& cluster) const {
+        if (nodes_.empty()) return;
+        std::uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const std::uint32_t k = stack[--top];
+            const Node& node = nodes_[k];
+            if (!node.box.overlaps(view)) continue;
+            const Box& b = node.box;
+            if (node.count > 1 && b.maxX - b.minX < clusterSize && b.maxY - b.minY < clusterSize) {
+                cluster(0.5f * (b.minX + b.maxX), 0.5f * (b.minY + b.maxY), node.first, node.count);
+                continue;
+            }
+            if (node.right != 0) {
+                stack[top++] = node.right;
+                stack[top++] = k + 1;
+                continue;
+            }
+            for (std::uint32_t j = node.first; j < node.first + node.count; ++j) item(order_[j]);
+        }
+    }
+
+private:
+    struct Node {
+        Box box;
+        std::uint32_t first, count;     // the circles under this node: order_[first, first + count)
+        std::uint32_t right;            // right child, or 0 for a leaf; the left child is the next node
+    };
+
+    struct Center {
+        float x, y;
+        std::uint32_t index;
+    };
+
+    static constexpr Box EMPTY = {3.4e38f, 3.4e38f, -3.4e38f, -3.4e38f};
+
+    std::vector<Node> nodes_;
+    std::vector<std::uint32_t> order_;
+    std::vector<Center> centers_;       // circle centres, sorted into tree order by build()
+    std::vector<std::uint32_t> leafOf_; // leaf node of every circle
+    double area_ = 0.0;                 // summed box areas after the last refit
+    double builtArea_ = 0.0;            // and after the last build
+
+    std::uint32_t split(std::uint32_t first, std::uint32_t last) {
+        const auto k = std::uint32_t(nodes_.size());
+        nodes_.push_back({EMPTY, first, last - first, 0});
+        if (last - first <= LEAF_SIZE) {
+            for (std::uint32_t j = first; j < last; ++j) {
+                order_[j] = centers_[j].index;
+                leafOf_[centers_[j].index] = k;
+            }
+            return k;
+        }
+
+        float minX = 3.4e38f, minY = 3.4e38f, maxX = -3.4e38f, maxY = -3.4e38f;
+        for (std::uint32_t j = first; j < last; ++j) {
+            const Center& c = centers_[j];
+            minX = std::min(minX, c.x);
+            maxX = std::max(maxX, c.x);
+            minY = std::min(minY, c.y);
+            maxY = std::max(maxY, c.y);
+        }
+        const bool alongX = maxX - minX >= maxY - minY;
+        const std::uint32_t mid = first + (last - first) / 2;
+        const auto by = [alongX](const Center& a, const Center& b) { return alongX ? a.x < b.x : a.y < b.y; };
+        std::nth_element(centers_.begin() + first, centers_.begin() + mid, centers_.begin() + last, by);
+        split(first, mid);
+        const std::uint32_t right = split(mid, last);
+        nodes_[k].right = right;
+        return k;
+    }
+};
+
+} // namespace grav
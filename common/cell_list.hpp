@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Uniform grid over 2D discs for finding contacts in O(N). build() counting-
+// sorts the bodies by cell and gathers their coordinates in that order, so the
+// 3x3 cells around a body are three contiguous runs of memory (one per row).
+//
+// The cell size adapts to the bodies on every build: never below the largest
+// diameter, so the 3x3 stencil cannot miss a contact, and otherwise about the
+// mean spacing, which keeps roughly one body per cell whether there are ten of
+// them or ten million. That also bounds the grid at O(N) cells, so it is
+// stored densely rather than hashed.
+class CellList {
+public:
+    using Pair = std::pair<std::uint32_t, std::uint32_t>;
+
+    float occupancy = 1.f;     // target bodies per cell in sparse scenes
+
+    float cellSize() const { return cell_; }
+    std::size_t cellCount() const { return std::size_t(cols_) * rows_; }
+
+    // Bins n discs centred on (x[i], y[i]) with radius r[i].
+    void build(const float* x, const float* y, const float* r, std::size_t n) {
+        n_ = n;
+        cellOf_.resize(n);
+        order_.resize(n);
+        sx_.resize(n);
+        sy_.resize(n);
+        sr_.resize(n);
+        sc_.resize(n);
+        if (n == 0) {
+            cols_ = rows_ = 0;
+            start_.assign(1, 0);
+            return;
+        }
+
+        float loX = x[0], hiX = x[0], loY = y[0], hiY = y[0], rMax = 0.f;
+        for (std::size_t i = 0; i < n; ++i) {
+            loX = std::min(loX, x[i]);
+            hiX = std::max(hiX, x[i]);
+            loY = std::min(loY, y[i]);
+            hiY = std::max(hiY, y[i]);
+            rMax = std::max(rMax, r[i]);
+        }
+        const float w = hiX - loX, h = hiY - loY;
+        cell_ = std::max(2.f * rMax, std::sqrt(occupancy * w * h / float(n)));
+        cell_ = std::max(cell_, std::max(w, h) / float(n)); // thin scenes: at most n cells per side
+        if (!(cell_ > 0.f)) cell_ = 1.f;
+        const float inv = 1.f / cell_;
+        cols_ = std::uint32_t(w * inv) + 1;
+        rows_ = std::uint32_t(h * inv) + 1;
+
+        TaskScheduler::instance().parallelFor(0, n, 16384, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                const std::uint32_t cx = std::min(std::uint32_t((x[i] - loX) * inv), cols_ - 1);
+                const std::uint32_t cy = std::min(std::uint32_t((y[i] - loY) * inv), rows_ - 1);
+                cellOf_[i] = cy * cols_ + cx;
+            }
+        });
+
+        const std::size_t cells = cellCount();
+        start_.assign(cells + 1, 0);
+        for (std::size_t i = 0; i < n; ++i) ++start_[cellOf_[i] + 1];
+        for (std::size_t c = 0; c < cells; ++c) start_[c + 1] += start_[c];
+        fill_.assign(start_.begin(), start_.end() - 1);
+        for (std::size_t i = 0; i < n; ++i) order_[fill_[cellOf_[i]]++] = std::uint32_t(i);
+
+        TaskScheduler::instance().parallelFor(0, n, 16384, [&](std::size_t first, std::size_t last) {
+            for (std::size_t k = first; k < last; ++k) {
+                sx_[k] = x[order_[k]];
+                sy_[k] = y[order_[k]];
+                sr_[k] = r[order_[k]];
+                sc_[k] = cellOf_[order_[k]];
+            }
+        });
+    }
+
+    // Every pair of overlapping discs once, as (lower index, higher index), in
+    // cell order. Runs in parallel; the result does not depend on the thread count.
+    const std::vector<Pair>& findOverlaps() {
+        pairs_.clear();
+        if (n_ == 0) return pairs_;
+        constexpr std::size_t GRAIN = 8192;
+        const std::size_t chunks = (n_ + GRAIN - 1) / GRAIN;
+        if (chunkPairs_.size() < chunks) chunkPairs_.resize(chunks);
+
+        TaskScheduler::instance().parallelFor(0, n_, GRAIN, [&](std::size_t first, std::size_t last) {
+            std::vector<Pair>& out = chunkPairs_[first / GRAIN];
+            out.clear();
+            for (std::size_t k = first; k < last; ++k) {
+                const std::uint32_t c = sc_[k];
+                const std::uint32_t cx = c % cols_, cy = c / cols_;
+                const std::uint32_t x0 = cx > 0 ? cx - 1 : 0, x1 = std::min(cx + 1, cols_ - 1);
+                const std::uint32_t y0 = cy > 0 ? cy - 1 : 0, y1 = std::min(cy + 1, rows_ - 1);
+                for (std::uint32_t row = y0; row <= y1; ++row) {
+                    // Each pair is met from both sides; keep the visit from the earlier slot.
+                    const std::size_t begin = std::max<std::size_t>(start_[row * cols_ + x0], k + 1);
+                    const std::size_t end = start_[row * cols_ + x1 + 1];
+                    for (std::size_t m = begin; m < end; ++m) {
+                        const float ex = sx_[m] - sx_[k], ey = sy_[m] - sy_[k], reach = sr_[k] + sr_[m];
+                        if (ex * ex + ey * ey < reach * reach)
+                            out.emplace_back(std::min(order_[k], order_[m]), std::max(order_[k], order_[m]));
+                    }
+                }
+            }
+        });
+
+        for (std::size_t c = 0; c < chunks; ++c) pairs_.insert(pairs_.end(), chunkPairs_[c].begin(), chunkPairs_[c].end());
+        return pairs_;
+    }
+
+private:
+    std::size_t n_ = 0;
+    float cell_ = 1.f;
+    std::uint32_t cols_ = 0, rows_ = 0;
+    std::vector<std::uint32_t> cellOf_;      // cell of each body, row-major
+    std::vector<std::uint32_t> start_;       // cell c holds slots start_[c] .. start_[c + 1]
+    std::vector<std::uint32_t> fill_;
+    std::vector<std::uint32_t> order_;       // body in each slot
+    std::vector<float> sx_, sy_, sr_;        // x, y, r gathered into slot order
+    std::vector<std::uint32_t> sc_;          // and the cell
+    std::vector<Pair> pairs_;
+    std::vector<std::vector<Pair>> chunkPairs_;
+};
+
+} // namespace grav
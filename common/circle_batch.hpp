@@ -0,0 +1,98 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace grav {
+
+// Collects the filled circles and circle outlines of one frame into a single
+// vertex array that is drawn with one draw call. The array persists across
+// frames, so after the first frame a batch no longer allocates.
+//
+// Circles are tessellated into triangles with just enough segments to keep the
+// edge within a quarter pixel of the true circle: a 2 px star costs 7 segments,
+// a 300 px orbit ring about 80.
+class CircleBatch {
+public:
+    static constexpr unsigned MIN_SEGMENTS = 4;
+    static constexpr unsigned MAX_SEGMENTS = 256;
+
+    CircleBatch() : vertices_(sf::Triangles) {}
+
+    void clear() { vertices_.clear(); }
+    std::size_t vertexCount() const { return vertices_.getVertexCount(); }
+
+    // Filled circle of radius r (pixels) around c.
+    void addDisc(const sf::Vector2f& c, float r, const sf::Color& color) {
+        if (r <= 0.f) return;
+        const std::vector<sf::Vector2f>& u = unitCircle(segmentsFor(r));
+        for (std::size_t i = 0; i + 1 < u.size(); ++i) {
+            vertices_.append(sf::Vertex(c, color));
+            vertices_.append(sf::Vertex(c + u[i] * r, color));
+            vertices_.append(sf::Vertex(c + u[i + 1] * r, color));
+        }
+    }
+
+    // Band from radius r out to r + thickness, like an sf::CircleShape outline.
+    void addRing(const sf::Vector2f& c, float r, float thickness, const sf::Color& color) {
+        if (thickness <= 0.f || r + thickness <= 0.f) return;
+        const float outer = r + thickness;
+        const std::vector<sf::Vector2f>& u = unitCircle(segmentsFor(outer));
+        for (std::size_t i = 0; i + 1 < u.size(); ++i) {
+            const sf::Vector2f a0 = c + u[i] * r, a1 = c + u[i + 1] * r;
+            const sf::Vector2f b0 = c + u[i] * outer, b1 = c + u[i + 1] * outer;
+            vertices_.append(sf::Vertex(a0, color));
+            vertices_.append(sf::Vertex(b0, color));
+            vertices_.append(sf::Vertex(b1, color));
+            vertices_.append(sf::Vertex(a0, color));
+            vertices_.append(sf::Vertex(b1, color));
+            vertices_.append(sf::Vertex(a1, color));
+        }
+    }
+
+    // Square of side `size` pixels around c, for circles too small to show as
+    // circles: two triangles instead of MIN_SEGMENTS.
+    void addPoint(const sf::Vector2f& c, const sf::Color& color, float size = 1.f) {
+        const float h = 0.5f * size;
+        const sf::Vector2f a(c.x - h, c.y - h), b(c.x + h, c.y - h), d(c.x - h, c.y + h), e(c.x + h, c.y + h);
+        vertices_.append(sf::Vertex(a, color));
+        vertices_.append(sf::Vertex(b, color));
+        vertices_.append(sf::Vertex(e, color));
+        vertices_.append(sf::Vertex(a, color));
+        vertices_.append(sf::Vertex(e, color));
+        vertices_.append(sf::Vertex(d, color));
+    }
+
+    void draw(sf::RenderTarget& target, const sf::RenderStates& states = sf::RenderStates::Default) const {
+        if (vertices_.getVertexCount() > 0) target.draw(vertices_, states);
+    }
+
+    // Segments for a circle of radius r whose chords stay within 0.25 px of it.
+    static unsigned segmentsFor(float r, unsigned maxSegments = MAX_SEGMENTS) {
+        if (r <= 0.25f) return MIN_SEGMENTS;
+        const float n = std::ceil(3.14159265f / std::acos(1.f - 0.25f / r));
+        return unsigned(std::clamp(n, float(MIN_SEGMENTS), float(maxSegments)));
+    }
+
+private:
+    sf::VertexArray vertices_;
+    std::vector<std::vector<sf::Vector2f>> unit_;
+
+    // Points on the unit circle for n segments, first point repeated at the end.
+    const std::vector<sf::Vector2f>& unitCircle(unsigned n) {
+        if (unit_.size() <= n) unit_.resize(n + 1);
+        std::vector<sf::Vector2f>& u = unit_[n];
+        if (u.empty()) {
+            u.resize(n + 1);
+            for (unsigned i = 0; i <= n; ++i) {
+                const float a = 6.28318531f * float(i % n) / float(n);
+                u[i] = sf::Vector2f(std::cos(a), std::sin(a));
+            }
+        }
+        return u;
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,48 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+
+#include "bodies.hpp"
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Pairwise O(N^2) gravity: exact up to rounding, the reference the tree and
+// multipole backends are measured against.
+template <typename T, int D>
+class DirectSum {
+public:
+    T softening = T(0);     // Plummer softening length
+
+    // Overwrites b.acc with the gravitational acceleration on every body.
+    void computeAccelerations(Bodies<T, D>& b, T G) const {
+        TaskScheduler::instance().parallelFor(0, b.size(), 64, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                T a[D];
+                accelerationOf(b, G, i, a);
+                for (int k = 0; k < D; ++k) b.acc[k][i] = a[k];
+            }
+        });
+    }
+
+    // Acceleration on body i from all the others, without touching b.
+    void accelerationOf(const Bodies<T, D>& b, T G, std::size_t i, T (&a)[D]) const {
+        const T eps2 = softening * softening;
+        for (int k = 0; k < D; ++k) a[k] = T(0);
+        for (std::size_t j = 0; j < b.size(); ++j) {
+            if (j == i) continue;
+            T d[D], r2 = eps2;
+            for (int k = 0; k < D; ++k) {
+                d[k] = b.pos[k][j] - b.pos[k][i];
+                r2 += d[k] * d[k];
+            }
+            if (r2 <= T(0)) continue;
+            const T inv = T(1) / std::sqrt(r2);
+            const T f = b.mass[j] * inv * inv * inv;
+            for (int k = 0; k < D; ++k) a[k] += f * d[k];
+        }
+        for (int k = 0; k < D; ++k) a[k] *= G;
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Radial falloffs of the lens_distortion.frag shaders. r is the distance from
+// the hole in normalised screen units; each gives the length of the offset
+// added to the texture coordinate, pointing away from the hole unless noted.
+enum class LensProfile {
+    Fade,        // blackhole00: strength / (r + softening) * (1 - r / radius), inside radius
+    FadeSquared, // blackhole01: strength * (1 - r / radius)^2, inside radius
+    Inverse,     // blackhole02/03: strength * r / (r + softening), towards the hole, everywhere
+};
+
+struct LensParams {
+    LensProfile profile = LensProfile::Fade;
+    float radius = 0.2f;
+    float strength = 0.03f;
+    float softening = 0.01f;
+    unsigned width = 800, height = 600;  // screen resolution in pixels
+};
+
+// --lens-radius, --lens-strength and --lens-softening override the defaults,
+// so the distortion can be tuned without touching the shader.
+inline LensParams parseLensParams(int argc, char** argv, LensParams params) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--lens-radius") params.radius = std::strtof(argv[i + 1], nullptr);
+        if (arg == "--lens-strength") params.strength = std::strtof(argv[i + 1], nullptr);
+        if (arg == "--lens-softening") params.softening = std::strtof(argv[i + 1], nullptr);
+    }
+    return params;
+}
+
+// The lens offset for every possible pixel-to-hole difference, baked once so
+// the shader does a single lookup instead of length, normalize and a divide
+// per fragment. The map spans differences of [-1, 1) in normalised screen
+// units at one texel per screen pixel (2 width x 2 height texels); the shader
+// reads it at (uv - hole) / 2 + 1/2, which is the map translated to the hole.
+//
+// Texels are RGBA8 so SFML can upload them as an ordinary texture: x in R
+// (high byte) and G (low byte), y in B and A, each a 16-bit fixed point value
+// over [-range(), range()]. Sample with nearest filtering; blending the bytes
+// separately would corrupt the values.
+//
+// cached() keeps baked maps on disk keyed by the parameters, so a parameter
+// set is only ever baked once.
+class DisplacementMap {
+public:
+    const LensParams& params() const { return params_; }
+    unsigned width() const { return 2 * params_.width; }
+    unsigned height() const { return 2 * params_.height; }
+    float range() const { return range_; }
+    const std::uint8_t* pixels() const { return texels_.data(); }
+    bool fromDisk() const { return fromDisk_; }
+    double millis() const { return millis_; }
+
+    // Offset for a difference (dx, dy) in normalised screen units.
+    static void offset(const LensParams& p, float dx, float dy, float& ox, float& oy) {
+        const float r = std::sqrt(dx * dx + dy * dy);
+        float length = 0.f;
+        switch (p.profile) {
+            case LensProfile::Fade:
+                if (r < p.radius) length = p.strength / (r + p.softening) * (1.f - r / p.radius);
+                break;
+            case LensProfile::FadeSquared:
+                if (r < p.radius) length = p.strength * (1.f - r / p.radius) * (1.f - r / p.radius);
+                break;
+            case LensProfile::Inverse:
+                length = -p.strength * r / (r + p.softening);
+                break;
+        }
+        ox = r > 0.f ? dx / r * length : 0.f;
+        oy = r > 0.f ? dy / r * length : 0.f;
+    }
+
+    static DisplacementMap bake(const LensParams& p) {
+        DisplacementMap map;
+        map.params_ = p;
+        const auto start = std::chrono::steady_clock::now();
+        const unsigned w = map.width(), h = map.height();
+        std::vector<float> field(std::size_t(w) * h * 2);
+        TaskScheduler::instance().parallelFor(0, h, 16, [&](std::size_t first, std::size_t last) {
+            for (std::size_t y = first; y < last; ++y) {
+                const float dy = (float(y) + 0.5f) / float(p.height) - 1.f;
+                for (unsigned x = 0; x < w; ++x) {
+                    const float dx = (float(x) + 0.5f) / float(p.width) - 1.f;
+                    float* o = &field[(y * w + x) * 2];
+                    offset(p, dx, dy, o[0], o[1]);
+                }
+            }
+        });
+
+        float range = 0.f;
+        for (float v : field) range = std::max(range, std::abs(v));
+        map.range_ = range > 0.f ? range : 1.f;
+        map.texels_.resize(field.size() * 2);
+        const float scale = 32767.5f / map.range_;
+        for (std::size_t i = 0; i < field.size(); ++i) {
+            const long q = std::lround(field[i] * scale + 32767.5f);
+            const unsigned v = unsigned(std::clamp(q, 0L, 65535L));
+            map.texels_[i * 2] = std::uint8_t(v >> 8);
+            map.texels_[i * 2 + 1] = std::uint8_t(v & 0xff);
+        }
+        map.millis_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return map;
+    }
+
+    // The map for p from dir if an earlier run baked it, otherwise baked now
+    // and written there for next time.
+    static DisplacementMap cached(const LensParams& p, const std::string& dir = ".cache") {
+        const auto start = std::chrono::steady_clock::now();
+        const std::string path = dir + "/" + cacheName(p);
+        DisplacementMap map;
+        if (map.load(path, p)) {
+            map.millis_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return map;
+        }
+        map = bake(p);
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        map.save(path);
+        return map;
+    }
+
+    // File name unique to a parameter set.
+    static std::string cacheName(const LensParams& p) {
+        char name[96];
+        std::snprintf(name, sizeof(name), "displacement_%d_%ux%u_%08x.map", int(p.profile), p.width, p.height,
+                      unsigned(hash(p)));
+        return name;
+    }
+
+    // Written to a temporary file and renamed into place, so a run killed
+    // mid-write never leaves a torn map behind.
+    bool save(const std::string& path) const {
+        const std::string temp = path + ".tmp";
+        std::ofstream out(temp, std::ios::binary);
+        const Header header = headerFor(params_, range_);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(texels_.data()), std::streamsize(texels_.size()));
+        out.close();
+        const bool ok = !out.fail() && std::rename(temp.c_str(), path.c_str()) == 0;
+        if (!ok) std::remove(temp.c_str());
+        return ok;
+    }
+
+    // False unless path holds a map baked with exactly p.
+    bool load(const std::string& path, const LensParams& p) {
+        std::ifstream in(path, std::ios::binary);
+        Header header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+        const Header expected = headerFor(p, header.range);
+        if (std::memcmp(&header, &expected, sizeof(header)) != 0) return false;
+        params_ = p;
+        range_ = header.range;
+        texels_.resize(std::size_t(width()) * height() * 4);
+        if (!in.read(reinterpret_cast<char*>(texels_.data()), std::streamsize(texels_.size()))) return false;
+        fromDisk_ = true;
+        return true;
+    }
+
+private:
+    LensParams params_;
+    float range_ = 1.f;
+    std::vector<std::uint8_t> texels_;
+    bool fromDisk_ = false;
+    double millis_ = 0.0;
+
+    static constexpr std::uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version, profile, width, height;
+        float radius, strength, softening, range;
+    };
+
+    static Header headerFor(const LensParams& p, float range) {
+        Header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, "GRAVDMAP", 8);
+        h.version = VERSION;
+        h.profile = std::uint32_t(p.profile);
+        h.width = p.width;
+        h.height = p.height;
+        h.radius = p.radius;
+        h.strength = p.strength;
+        h.softening = p.softening;
+        h.range = range;
+        return h;
+    }
+
+    // FNV-1a over the header fields that identify a parameter set.
+    static std::uint32_t hash(const LensParams& p) {
+        const Header h = headerFor(p, 0.f);
+        const auto* bytes = reinterpret_cast<const unsigned char*>(&h);
+        std::uint32_t x = 2166136261u;
+        for (std::size_t i = 0; i < sizeof(h); ++i) x = (x ^ bytes[i]) * 16777619u;
+        return x;
+    }
+};
+
+} // namespace grav
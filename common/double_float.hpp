@@ -0,0 +1,117 @@
+#pragma once
+#include <cmath>
+#include <ostream>
+
+namespace grav {
+
+// Double-float arithmetic: a value is the unevaluated sum hi + lo of two floats,
+// about 48 bits of mantissa while every operation stays in single precision.
+// Additions are error-free transformations (Knuth's TwoSum), so long runs of
+// small increments accumulate without the loss plain float suffers, like
+// Kahan-compensated summation. Products use an FMA when the target has one.
+//
+// Must be compiled without -ffast-math, which would optimise the error terms away.
+struct DoubleFloat {
+    float hi = 0.f;
+    float lo = 0.f;
+
+    DoubleFloat() = default;
+    DoubleFloat(double d) : hi(float(d)), lo(float(d - double(float(d)))) {}
+    DoubleFloat(float h, float l) : hi(h), lo(l) {}
+
+    explicit operator double() const { return double(hi) + double(lo); }
+    explicit operator float() const { return hi + lo; }
+
+    DoubleFloat operator-() const { return {-hi, -lo}; }
+
+    DoubleFloat& operator+=(const DoubleFloat& b) { return *this = *this + b; }
+    DoubleFloat& operator-=(const DoubleFloat& b) { return *this = *this - b; }
+    DoubleFloat& operator*=(const DoubleFloat& b) { return *this = *this * b; }
+    DoubleFloat& operator/=(const DoubleFloat& b) { return *this = *this / b; }
+
+    friend DoubleFloat operator+(const DoubleFloat& a, const DoubleFloat& b) {
+        float e;
+        float s = twoSum(a.hi, b.hi, e);
+        float f;
+        const float t = twoSum(a.lo, b.lo, f);
+        e += t;
+        s = quickTwoSum(s, e, e);
+        e += f;
+        s = quickTwoSum(s, e, e);
+        return {s, e};
+    }
+
+    friend DoubleFloat operator-(const DoubleFloat& a, const DoubleFloat& b) { return a + (-b); }
+
+    friend DoubleFloat operator*(const DoubleFloat& a, const DoubleFloat& b) {
+        float e;
+        float p = twoProd(a.hi, b.hi, e);
+        e += a.hi * b.lo + a.lo * b.hi;
+        p = quickTwoSum(p, e, e);
+        return {p, e};
+    }
+
+    friend DoubleFloat operator/(const DoubleFloat& a, const DoubleFloat& b) {
+        const float q1 = a.hi / b.hi;
+        const DoubleFloat r = a - b * DoubleFloat(q1, 0.f);
+        const float q2 = r.hi / b.hi;
+        float e;
+        const float q = quickTwoSum(q1, q2, e);
+        return {q, e};
+    }
+
+    friend bool operator<(const DoubleFloat& a, const DoubleFloat& b) { return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo); }
+    friend bool operator>(const DoubleFloat& a, const DoubleFloat& b) { return b < a; }
+    friend bool operator<=(const DoubleFloat& a, const DoubleFloat& b) { return !(b < a); }
+    friend bool operator>=(const DoubleFloat& a, const DoubleFloat& b) { return !(a < b); }
+    friend bool operator==(const DoubleFloat& a, const DoubleFloat& b) { return a.hi == b.hi && a.lo == b.lo; }
+    friend bool operator!=(const DoubleFloat& a, const DoubleFloat& b) { return !(a == b); }
+
+    // One Newton step on the float square root.
+    friend DoubleFloat sqrt(const DoubleFloat& a) {
+        if (a.hi <= 0.f) return {};
+        const float x = std::sqrt(a.hi);
+        float e;
+        const float p = twoProd(x, x, e);
+        const DoubleFloat r = a - DoubleFloat(p, e);
+        const float c = r.hi / (2.f * x);
+        const float s = quickTwoSum(x, c, e);
+        return {s, e};
+    }
+
+    friend DoubleFloat abs(const DoubleFloat& a) { return a.hi < 0.f ? -a : a; }
+
+    friend std::ostream& operator<<(std::ostream& os, const DoubleFloat& a) { return os << double(a); }
+
+private:
+    // s = a + b rounded, err = the exact rounding error.
+    static float twoSum(float a, float b, float& err) {
+        const float s = a + b;
+        const float v = s - a;
+        err = (a - (s - v)) + (b - v);
+        return s;
+    }
+
+    // Same, for |a| >= |b|.
+    static float quickTwoSum(float a, float b, float& err) {
+        const float s = a + b;
+        err = b - (s - a);
+        return s;
+    }
+
+    static float twoProd(float a, float b, float& err) {
+        const float p = a * b;
+#ifdef __FMA__
+        err = std::fma(a, b, -p);
+#else
+        // Dekker's split into 12-bit halves.
+        const float ca = 4097.f * a, cb = 4097.f * b;
+        const float ah = ca - (ca - a), al = a - ah;
+        const float bh = cb - (cb - b), bl = b - bh;
+        err = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+#endif
+        return p;
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,418 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "barnes_hut.hpp"
+#include "bodies.hpp"
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Fast multipole method for Newtonian gravity in Cartesian Taylor expansions
+// of 1/r up to a configurable `order` p, in the style of Dehnen's falcON:
+//
+//   upward      P2M in the leaves, then M2M level by level towards the root
+//   traversal   dual tree walk; cells whose radii satisfy rA + rB < theta * |cA - cB|
+//               interact through one M2L, near leaves by direct summation (P2P)
+//   downward    L2L level by level towards the leaves, then L2P
+//
+// Every pass is split across the shared scheduler. The cost is O(N) for a
+// fixed order and theta; the error falls roughly like theta^(p + 1). Cells
+// come from the Barnes-Hut tree, expanded about their centre of mass.
+// Softening is applied in the near field only.
+template <typename T, int D>
+class Fmm {
+public:
+    int order = 4;          // highest power kept in the expansions
+    T theta = T(0.5);       // opening criterion for the dual walk
+    T softening = T(0);     // Plummer softening length, near field only
+    int leafSize = 16;      // bodies per leaf cell
+
+    struct Stats {
+        std::uint64_t m2l = 0;  // cell-cell expansions in the last evaluation
+        std::uint64_t p2p = 0;  // body-body pulls in the last evaluation
+    };
+    Stats stats;
+
+    // Overwrites b.acc with the gravitational acceleration on every body.
+    void computeAccelerations(Bodies<T, D>& b, T G) {
+        const std::size_t n = b.size();
+        for (int k = 0; k < D; ++k) std::fill(b.acc[k].begin(), b.acc[k].end(), T(0));
+        stats = Stats{};
+        if (n == 0) return;
+
+        prepareTables();
+        tree_.leafSize = leafSize;
+        tree_.build(b);
+        const auto& nodes = tree_.nodes();
+        multipole_.assign(nodes.size() * nc_, T(0));
+        local_.assign(nodes.size() * nc_, T(0));
+        radius_.assign(nodes.size(), T(0));
+        sortLevels();
+
+        upward(b);
+        traverse(b);
+        downward(b);
+
+        TaskScheduler::instance().parallelFor(0, n, 4096, [&](std::size_t first, std::size_t last) {
+            for (int k = 0; k < D; ++k)
+                for (std::size_t i = first; i < last; ++i) b.acc[k][i] *= G;
+        });
+    }
+
+private:
+    using Index = std::array<int, D>;
+    using Node = typename BarnesHut<T, D>::Node;
+
+    // Coefficient tables for the current order.
+    struct Shift { std::uint32_t to, from, by; };                   // to += from * power[by]
+    struct Cross { std::uint32_t local, multi, kernel; T scale; };  // L[local] += scale * X[multi] * a[kernel]
+    struct Grad { std::uint32_t term, lower; int axis; T scale; };  // g[axis] += scale * L[term] * e^lower
+    struct Recurrence { int once[D], twice[D]; T first, second; };  // terms n - e_k, n - 2e_k (or -1)
+
+    int tableOrder_ = -1;
+    std::size_t nc_ = 0;
+    std::vector<Index> terms_;              // multi-indices, by total degree
+    std::vector<int> lookup_;               // dense (p+1)^D map back to terms_
+    std::vector<T> invFact_;                // 1 / n!
+    std::vector<Shift> m2m_;
+    std::vector<Cross> m2l_, l2l_;
+    std::vector<Grad> grad_;
+    std::vector<Recurrence> recurrence_;
+
+    BarnesHut<T, D> tree_;
+    std::vector<T> multipole_, local_, radius_;
+    std::vector<std::vector<std::uint32_t>> levels_;
+    std::vector<std::uint32_t> frontier_;
+
+    int find(const Index& n) const {
+        int code = 0;
+        for (int k = D - 1; k >= 0; --k) {
+            if (n[k] < 0 || n[k] > order) return -1;
+            code = code * (order + 1) + n[k];
+        }
+        return lookup_[code];
+    }
+
+    static int degree(const Index& n) {
+        int s = 0;
+        for (int k = 0; k < D; ++k) s += n[k];
+        return s;
+    }
+
+    void prepareTables() {
+        if (order < 0) order = 0;
+        if (order == tableOrder_) return;
+        tableOrder_ = order;
+
+        terms_.clear();
+        std::size_t dense = 1;
+        for (int k = 0; k < D; ++k) dense *= std::size_t(order + 1);
+        for (std::size_t code = 0; code < dense; ++code) {
+            Index n;
+            std::size_t c = code;
+            for (int k = 0; k < D; ++k) {
+                n[k] = int(c % std::size_t(order + 1));
+                c /= std::size_t(order + 1);
+            }
+            if (degree(n) <= order) terms_.push_back(n);
+        }
+        std::stable_sort(terms_.begin(), terms_.end(), [](const Index& a, const Index& b) { return degree(a) < degree(b); });
+        nc_ = terms_.size();
+        lookup_.assign(dense, -1);
+        for (std::size_t t = 0; t < nc_; ++t) {
+            int code = 0;
+            for (int k = D - 1; k >= 0; --k) code = code * (order + 1) + terms_[t][k];
+            lookup_[std::size_t(code)] = int(t);
+        }
+
+        auto factorial = [](const Index& n) {
+            T f = T(1);
+            for (int k = 0; k < D; ++k)
+                for (int j = 2; j <= n[k]; ++j) f *= T(j);
+            return f;
+        };
+        invFact_.resize(nc_);
+        for (std::size_t t = 0; t < nc_; ++t) invFact_[t] = T(1) / factorial(terms_[t]);
+
+        recurrence_.assign(nc_, Recurrence{});
+        for (std::size_t t = 1; t < nc_; ++t) {
+            Recurrence& rc = recurrence_[t];
+            const int s = degree(terms_[t]);
+            rc.first = -T(2 * s - 1) / T(s);
+            rc.second = -T(s - 1) / T(s);
+            for (int k = 0; k < D; ++k) {
+                Index m = terms_[t];
+                m[k] -= 1;
+                rc.once[k] = find(m);
+                m[k] -= 1;
+                rc.twice[k] = find(m);
+            }
+        }
+
+        m2m_.clear();
+        l2l_.clear();
+        m2l_.clear();
+        grad_.clear();
+        for (std::size_t a = 0; a < nc_; ++a) {
+            for (std::size_t c = 0; c < nc_; ++c) {
+                Index sum, diff;
+                bool below = true;
+                for (int k = 0; k < D; ++k) {
+                    sum[k] = terms_[a][k] + terms_[c][k];
+                    diff[k] = terms_[a][k] - terms_[c][k];
+                    below = below && diff[k] >= 0;
+                }
+                // M2M: M'[a] += M[c] * (-delta)^(a-c) / (a-c)!, c <= a
+                // L2L: L'[c] += L[a] * a!/c! * delta^(a-c) / (a-c)!, c <= a
+                if (below) {
+                    const std::uint32_t by = std::uint32_t(find(diff));
+                    m2m_.push_back({std::uint32_t(a), std::uint32_t(c), by});
+                    l2l_.push_back({std::uint32_t(c), std::uint32_t(a), by, factorial(terms_[a]) * invFact_[c]});
+                }
+                // M2L: L[a] += (a+c)!/a! * M[c] * a_(a+c)
+                if (degree(sum) <= order)
+                    m2l_.push_back({std::uint32_t(a), std::uint32_t(c), std::uint32_t(find(sum)),
+                                    factorial(sum) * invFact_[a]});
+            }
+            for (int k = 0; k < D; ++k) {
+                if (terms_[a][k] == 0) continue;
+                Index lower = terms_[a];
+                --lower[k];
+                grad_.push_back({std::uint32_t(a), std::uint32_t(find(lower)), k, T(terms_[a][k])});
+            }
+        }
+    }
+
+    // out[t] = d^t, divided by t! when `factorial`.
+    void powers(const T (&d)[D], bool factorial, T* out) const {
+        T p1[D][32];
+        const int p = std::min(order, 31);
+        for (int k = 0; k < D; ++k) {
+            p1[k][0] = T(1);
+            for (int j = 1; j <= p; ++j) p1[k][j] = p1[k][j - 1] * d[k] / (factorial ? T(j) : T(1));
+        }
+        for (std::size_t t = 0; t < nc_; ++t) {
+            T v = T(1);
+            for (int k = 0; k < D; ++k) v *= p1[k][terms_[t][k]];
+            out[t] = v;
+        }
+    }
+
+    // Taylor coefficients a_n = (1/n!) d^n (1/|r|) / dr^n by the standard recurrence
+    //   |n| r^2 a_n = -(2|n| - 1) sum_k r_k a_(n-e_k) - (|n| - 1) sum_k a_(n-2e_k).
+    void kernel(const T (&r)[D], T* a) const {
+        T r2 = T(0);
+        for (int k = 0; k < D; ++k) r2 += r[k] * r[k];
+        a[0] = T(1) / std::sqrt(r2);
+        const T inv2 = T(1) / r2;
+        for (std::size_t t = 1; t < nc_; ++t) {
+            const Recurrence& rc = recurrence_[t];
+            T first = T(0), second = T(0);
+            for (int k = 0; k < D; ++k) {
+                if (rc.once[k] >= 0) first += r[k] * a[rc.once[k]];
+                if (rc.twice[k] >= 0) second += a[rc.twice[k]];
+            }
+            a[t] = (rc.first * first + rc.second * second) * inv2;
+        }
+    }
+
+    void sortLevels() {
+        const auto& nodes = tree_.nodes();
+        levels_.assign(1, std::vector<std::uint32_t>(1, 0));
+        while (true) {
+            std::vector<std::uint32_t> next;
+            for (std::uint32_t c : levels_.back())
+                if (nodes[c].firstChild >= 0)
+                    for (int q = 0; q < BarnesHut<T, D>::CHILDREN; ++q) next.push_back(std::uint32_t(nodes[c].firstChild + q));
+            if (next.empty()) break;
+            levels_.push_back(std::move(next));
+        }
+    }
+
+    void upward(const Bodies<T, D>& b) {
+        const auto& nodes = tree_.nodes();
+        const auto& order = tree_.order();
+        for (std::size_t l = levels_.size(); l-- > 0;) {
+            const std::vector<std::uint32_t>& level = levels_[l];
+            TaskScheduler::instance().parallelFor(0, level.size(), 64, [&](std::size_t first, std::size_t last) {
+                std::vector<T> pw(nc_);
+                for (std::size_t q = first; q < last; ++q) {
+                    const std::uint32_t c = level[q];
+                    const Node& node = nodes[c];
+                    T* M = &multipole_[c * nc_];
+                    if (node.firstChild < 0) {
+                        T r2 = T(0);
+                        for (std::uint32_t s = node.begin; s < node.end; ++s) {
+                            const std::uint32_t j = order[s];
+                            T d[D], dist2 = T(0);
+                            for (int k = 0; k < D; ++k) {
+                                d[k] = node.com[k] - b.pos[k][j];
+                                dist2 += d[k] * d[k];
+                            }
+                            r2 = std::max(r2, dist2);
+                            powers(d, true, pw.data());
+                            for (std::size_t t = 0; t < nc_; ++t) M[t] += b.mass[j] * pw[t];
+                        }
+                        radius_[c] = std::sqrt(r2);
+                        continue;
+                    }
+                    T r = T(0);
+                    for (int ch = 0; ch < BarnesHut<T, D>::CHILDREN; ++ch) {
+                        const std::uint32_t cc = std::uint32_t(node.firstChild + ch);
+                        if (nodes[cc].end == nodes[cc].begin) continue;
+                        T d[D], dist2 = T(0);
+                        for (int k = 0; k < D; ++k) {
+                            d[k] = node.com[k] - nodes[cc].com[k];
+                            dist2 += d[k] * d[k];
+                        }
+                        r = std::max(r, radius_[cc] + std::sqrt(dist2));
+                        powers(d, true, pw.data());
+                        const T* Mc = &multipole_[cc * nc_];
+                        for (const Shift& s : m2m_) M[s.to] += Mc[s.from] * pw[s.by];
+                    }
+                    radius_[c] = r;
+                }
+            });
+        }
+    }
+
+    // Disjoint target subtrees walked in parallel; fixed by the body count
+    // alone, so the interactions do not depend on the thread count.
+    void traverse(Bodies<T, D>& b) {
+        const auto& nodes = tree_.nodes();
+        const std::size_t limit = std::max<std::size_t>(std::size_t(leafSize), b.size() / 256);
+        frontier_.clear();
+        std::vector<std::uint32_t> stack(1, 0);
+        while (!stack.empty()) {
+            const std::uint32_t c = stack.back();
+            stack.pop_back();
+            if (nodes[c].end == nodes[c].begin) continue;
+            if (nodes[c].firstChild < 0 || nodes[c].end - nodes[c].begin <= limit) {
+                frontier_.push_back(c);
+                continue;
+            }
+            for (int q = BarnesHut<T, D>::CHILDREN - 1; q >= 0; --q) stack.push_back(std::uint32_t(nodes[c].firstChild + q));
+        }
+
+        std::vector<Stats> counts(frontier_.size());
+        TaskScheduler::instance().parallelFor(0, frontier_.size(), 1, [&](std::size_t first, std::size_t last) {
+            std::vector<T> a(nc_);
+            for (std::size_t f = first; f < last; ++f) interact(b, frontier_[f], 0, a.data(), counts[f]);
+        });
+        for (const Stats& s : counts) {
+            stats.m2l += s.m2l;
+            stats.p2p += s.p2p;
+        }
+    }
+
+    // Adds the field of source cell B to the bodies and expansions of target cell A.
+    void interact(Bodies<T, D>& b, std::uint32_t A, std::uint32_t B, T* a, Stats& count) {
+        const auto& nodes = tree_.nodes();
+        const Node& na = nodes[A];
+        const Node& nb = nodes[B];
+        if (na.end == na.begin || nb.mass <= T(0)) return;
+
+        if (A != B) {
+            T r[D], dist2 = T(0);
+            for (int k = 0; k < D; ++k) {
+                r[k] = na.com[k] - nb.com[k];
+                dist2 += r[k] * r[k];
+            }
+            const T reach = radius_[A] + radius_[B];
+            if (reach * reach < theta * theta * dist2) {
+                kernel(r, a);
+                T* L = &local_[A * nc_];
+                const T* M = &multipole_[B * nc_];
+                for (const Cross& x : m2l_) L[x.local] += x.scale * M[x.multi] * a[x.kernel];
+                ++count.m2l;
+                return;
+            }
+        }
+
+        const bool leafA = na.firstChild < 0, leafB = nb.firstChild < 0;
+        if (leafA && leafB) {
+            nearField(b, na, nb);
+            count.p2p += std::uint64_t(na.end - na.begin) * (nb.end - nb.begin);
+            return;
+        }
+        if (A == B) {
+            for (int p = 0; p < BarnesHut<T, D>::CHILDREN; ++p)
+                for (int q = 0; q < BarnesHut<T, D>::CHILDREN; ++q)
+                    interact(b, std::uint32_t(na.firstChild + p), std::uint32_t(na.firstChild + q), a, count);
+            return;
+        }
+        if (leafB || (!leafA && radius_[A] >= radius_[B])) {
+            for (int p = 0; p < BarnesHut<T, D>::CHILDREN; ++p) interact(b, std::uint32_t(na.firstChild + p), B, a, count);
+        } else {
+            for (int q = 0; q < BarnesHut<T, D>::CHILDREN; ++q) interact(b, A, std::uint32_t(nb.firstChild + q), a, count);
+        }
+    }
+
+    void nearField(Bodies<T, D>& b, const Node& na, const Node& nb) const {
+        const auto& order = tree_.order();
+        const T eps2 = softening * softening;
+        for (std::uint32_t s = na.begin; s < na.end; ++s) {
+            const std::uint32_t i = order[s];
+            T acc[D] = {};
+            for (std::uint32_t t = nb.begin; t < nb.end; ++t) {
+                const std::uint32_t j = order[t];
+                if (j == i) continue;
+                T d[D], r2 = eps2;
+                for (int k = 0; k < D; ++k) {
+                    d[k] = b.pos[k][j] - b.pos[k][i];
+                    r2 += d[k] * d[k];
+                }
+                if (r2 <= T(0)) continue;
+                const T inv = T(1) / std::sqrt(r2);
+                const T f = b.mass[j] * inv * inv * inv;
+                for (int k = 0; k < D; ++k) acc[k] += f * d[k];
+            }
+            for (int k = 0; k < D; ++k) b.acc[k][i] += acc[k];
+        }
+    }
+
+    void downward(Bodies<T, D>& b) {
+        const auto& nodes = tree_.nodes();
+        const auto& order = tree_.order();
+        for (std::size_t l = 0; l < levels_.size(); ++l) {
+            const std::vector<std::uint32_t>& level = levels_[l];
+            TaskScheduler::instance().parallelFor(0, level.size(), 64, [&](std::size_t first, std::size_t last) {
+                std::vector<T> pw(nc_);
+                for (std::size_t q = first; q < last; ++q) {
+                    const std::uint32_t c = level[q];
+                    const Node& node = nodes[c];
+                    const T* L = &local_[c * nc_];
+                    if (node.firstChild >= 0) {
+                        for (int ch = 0; ch < BarnesHut<T, D>::CHILDREN; ++ch) {
+                            const std::uint32_t cc = std::uint32_t(node.firstChild + ch);
+                            if (nodes[cc].end == nodes[cc].begin) continue;
+                            T d[D];
+                            for (int k = 0; k < D; ++k) d[k] = nodes[cc].com[k] - node.com[k];
+                            powers(d, true, pw.data());
+                            T* Lc = &local_[cc * nc_];
+                            for (const Cross& s : l2l_) Lc[s.local] += s.scale * L[s.multi] * pw[s.kernel];
+                        }
+                        continue;
+                    }
+                    // L2P: the acceleration is the gradient of the local expansion.
+                    for (std::uint32_t s = node.begin; s < node.end; ++s) {
+                        const std::uint32_t i = order[s];
+                        T e[D];
+                        for (int k = 0; k < D; ++k) e[k] = b.pos[k][i] - node.com[k];
+                        powers(e, false, pw.data());
+                        T g[D] = {};
+                        for (const Grad& x : grad_) g[x.axis] += x.scale * L[x.term] * pw[x.lower];
+                        for (int k = 0; k < D; ++k) b.acc[k][i] += g[k];
+                    }
+                }
+            });
+        }
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,114 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "barnes_hut.hpp"
+#include "bodies.hpp"
+#include "direct_sum.hpp"
+#include "fmm.hpp"
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Accuracy and throughput of the force backends on one body distribution.
+// Accuracy is the relative error |a - a_exact| / |a_exact| on an evenly spaced
+// sample of bodies, against DirectSum; the direct row times that sample alone
+// and extrapolates, so the benchmark stays usable at millions of bodies.
+struct ForceBenchOptions {
+    double theta = 0.5;                     // Barnes-Hut and FMM opening criterion
+    std::vector<int> orders = {2, 4, 6, 8}; // FMM expansion orders to try
+    std::size_t sample = 1000;              // bodies checked against direct summation
+    double minSeconds = 0.2;                // repeat each backend at least this long
+};
+
+inline void printForceBenchHeader(std::ostream& os) {
+    os << std::left << std::setw(14) << "distribution" << std::setw(10) << "bodies" << std::setw(18) << "backend"
+       << std::setw(14) << "ms/eval" << std::setw(14) << "bodies/s" << std::setw(12) << "median"
+       << std::setw(12) << "p99" << "max\n";
+}
+
+template <typename T, int D>
+void benchForceBackends(const std::string& name, const Bodies<T, D>& bodies, T G, T softening,
+                        const ForceBenchOptions& opt, std::ostream& os) {
+    using clock = std::chrono::steady_clock;
+    const std::size_t n = bodies.size();
+    if (n == 0) return;
+
+    const std::size_t stride = std::max<std::size_t>(1, n / std::max<std::size_t>(1, opt.sample));
+    std::vector<std::size_t> sample;
+    for (std::size_t i = 0; i < n; i += stride) sample.push_back(i);
+
+    DirectSum<T, D> direct;
+    direct.softening = softening;
+    std::vector<T> exact(sample.size() * D);
+    const auto start = clock::now();
+    TaskScheduler::instance().parallelFor(0, sample.size(), 16, [&](std::size_t first, std::size_t last) {
+        for (std::size_t s = first; s < last; ++s) {
+            T a[D];
+            direct.accelerationOf(bodies, G, sample[s], a);
+            for (int k = 0; k < D; ++k) exact[s * D + k] = a[k];
+        }
+    });
+    const double perBody = std::chrono::duration<double>(clock::now() - start).count() / double(sample.size());
+
+    auto row = [&](const std::string& backend, double seconds, const double* errors) {
+        os << std::left << std::setw(14) << name << std::setw(10) << n << std::setw(18) << backend
+           << std::setw(14) << seconds * 1e3 << std::setw(14) << double(n) / seconds;
+        if (errors) os << std::setw(12) << errors[0] << std::setw(12) << errors[1] << errors[2];
+        else os << std::setw(12) << 0 << std::setw(12) << 0 << 0;
+        os << "\n";
+    };
+    row("direct", perBody * double(n), nullptr);
+
+    // Runs compute(b) until minSeconds have passed, then scores the last result.
+    Bodies<T, D> b = bodies;
+    auto measure = [&](const std::string& backend, auto&& compute) {
+        int runs = 0;
+        double seconds = 0.0;
+        do {
+            const auto t0 = clock::now();
+            compute(b);
+            seconds += std::chrono::duration<double>(clock::now() - t0).count();
+            ++runs;
+        } while (seconds < opt.minSeconds);
+
+        std::vector<double> err(sample.size());
+        for (std::size_t s = 0; s < sample.size(); ++s) {
+            double diff = 0.0, norm = 0.0;
+            for (int k = 0; k < D; ++k) {
+                const double e = double(exact[s * D + k]);
+                const double d = double(b.acc[k][sample[s]]) - e;
+                diff += d * d;
+                norm += e * e;
+            }
+            err[s] = norm > 0.0 ? std::sqrt(diff / norm) : std::sqrt(diff);
+        }
+        std::sort(err.begin(), err.end());
+        const double errors[3] = {err[err.size() / 2], err[std::min(err.size() - 1, err.size() * 99 / 100)], err.back()};
+        row(backend, seconds / runs, errors);
+    };
+
+    std::ostringstream label;
+    BarnesHut<T, D> tree;
+    tree.theta = T(opt.theta);
+    tree.softening = softening;
+    label << "barnes-hut " << opt.theta;
+    measure(label.str(), [&](Bodies<T, D>& x) { tree.computeAccelerations(x, G); });
+
+    Fmm<T, D> fmm;
+    fmm.theta = T(opt.theta);
+    fmm.softening = softening;
+    for (int p : opt.orders) {
+        fmm.order = p;
+        measure("fmm p=" + std::to_string(p), [&](Bodies<T, D>& x) { fmm.computeAccelerations(x, G); });
+    }
+}
+
+} // namespace grav
@@ -0,0 +1,402 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+
+#if defined(_WIN32)
+#define GRAV_GLAPI __stdcall
+#else
+#define GRAV_GLAPI
+#endif
+
+namespace grav {
+
+enum class VideoFormat { Y4m, Raw, Png };
+
+inline const char* videoFormatName(VideoFormat f) {
+    switch (f) {
+        case VideoFormat::Raw: return "raw";
+        case VideoFormat::Png: return "png";
+        default: return "y4m";
+    }
+}
+
+inline bool parseVideoFormat(const std::string& s, VideoFormat& out) {
+    if (s == "y4m") out = VideoFormat::Y4m;
+    else if (s == "raw" || s == "rgba") out = VideoFormat::Raw;
+    else if (s == "png") out = VideoFormat::Png;
+    else return false;
+    return true;
+}
+
+// Command-line switches for recording a simulation offline:
+//   --record PATH         a file, - for stdout, or |command to pipe into a program
+//   --record-format F     y4m, raw (RGBA) or png; by default from PATH's extension, else y4m
+//   --record-fps F        frames per simulated second (default 60)
+//   --record-frames N     stop after N frames (default: when the window is closed)
+// PNG output is one file per frame; PATH is a printf pattern such as
+// frames/%05d.png, or gets _%05d inserted before its extension.
+struct RecordOptions {
+    bool enabled = false;
+    std::string path;
+    VideoFormat format = VideoFormat::Y4m;
+    double fps = 60.0;
+    std::uint64_t frames = 0;
+};
+
+inline RecordOptions parseRecord(int argc, char** argv) {
+    RecordOptions opt;
+    bool formatGiven = false;
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--record") {
+            opt.enabled = true;
+            opt.path = argv[++i];
+        } else if (arg == "--record-format") {
+            formatGiven = parseVideoFormat(argv[++i], opt.format);
+        } else if (arg == "--record-fps") {
+            opt.fps = std::max(1e-3, std::strtod(argv[++i], nullptr));
+        } else if (arg == "--record-frames") {
+            opt.frames = std::strtoull(argv[++i], nullptr, 10);
+        }
+    }
+    const std::size_t dot = opt.path.rfind('.');
+    if (!formatGiven && dot != std::string::npos && opt.path[0] != '|')
+        parseVideoFormat(opt.path.substr(dot + 1), opt.format);
+    return opt;
+}
+
+// Records rendered frames without stalling the render thread.
+//
+// capture() starts an asynchronous glReadPixels into one of a ring of pixel
+// buffer objects and returns at once; the GPU finishes the copy while the
+// next frames are drawn, and the buffer is only mapped once `buffers - 1`
+// newer frames are in flight, by which time the transfer is long done. The
+// mapped pixels go on a bounded queue to encoder threads, which flip the rows
+// (OpenGL reads bottom-up), convert and write. Y4M and raw frames leave in
+// order through one stream; PNG frames are compressed and saved in parallel.
+// When the queue is full capture() waits, so an offline render slows down
+// instead of dropping frames.
+//
+// Without pixel buffer objects (no OpenGL 2.1) capture() reads synchronously
+// but still hands the encoding to the workers.
+class FrameRecorder {
+public:
+    int buffers = 3;   // readbacks in flight
+    int workers = 0;   // encoder threads; 0 picks from the core count
+
+    FrameRecorder() = default;
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+    ~FrameRecorder() { finish(); }
+
+    // Opens the output; frames are w x h for every capture that follows.
+    bool open(const RecordOptions& opt, unsigned w, unsigned h) {
+        finish();
+        options_ = opt;
+        width_ = w;
+        height_ = h;
+        error_ = false;
+        captured_ = written_ = 0;
+        nextWrite_ = 0;
+        started_ = std::chrono::steady_clock::now();
+
+        if (opt.format == VideoFormat::Png) {
+            pattern_ = opt.path;
+            if (pattern_.find('%') == std::string::npos) {
+                const std::size_t dot = pattern_.rfind('.');
+                pattern_.insert(dot == std::string::npos ? pattern_.size() : dot, "_%05d");
+            }
+            std::error_code ec;
+            const std::filesystem::path dir = std::filesystem::path(pattern_).parent_path();
+            if (!dir.empty()) std::filesystem::create_directories(dir, ec);
+        } else if (opt.path == "-") {
+            out_ = stdout;
+        } else if (!opt.path.empty() && opt.path[0] == '|') {
+            out_ = popen(opt.path.c_str() + 1, "w");
+            piped_ = true;
+        } else {
+            out_ = std::fopen(opt.path.c_str(), "wb");
+        }
+        if (opt.format != VideoFormat::Png && !out_) return false;
+        if (opt.format == VideoFormat::Y4m) writeY4mHeader();
+
+        loadGl();
+        if (gl_.ok) {
+            pbo_.assign(std::size_t(std::max(1, buffers)), 0);
+            gl_.genBuffers(GLsizei(pbo_.size()), pbo_.data());
+            for (GLuint b : pbo_) {
+                gl_.bindBuffer(GL_PIXEL_PACK_BUFFER, b);
+                gl_.bufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(frameBytes()), nullptr, GL_STREAM_READ);
+            }
+            gl_.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        const int n = workers > 0 ? workers
+                                  : int(std::max(1u, std::min(8u, std::thread::hardware_concurrency() / 2)));
+        maxQueued_ = std::size_t(n) * 2;
+        closing_ = false;
+        for (int i = 0; i < n; ++i) threads_.emplace_back([this] { encodeLoop(); });
+        open_ = true;
+        return true;
+    }
+
+    bool isOpen() const { return open_; }
+    bool failed() const { return error_; }
+    std::uint64_t captured() const { return captured_; }
+    bool usesPixelBuffers() const { return gl_.ok; }
+
+    // Queues a readback of target's current contents; call after drawing and
+    // before display(). The target must be w x h.
+    void capture(sf::RenderTarget& target) {
+        if (!open_) return;
+        target.setActive(true);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        const std::uint64_t index = captured_++;
+        if (!gl_.ok) {
+            Job job{index, std::vector<std::uint8_t>(frameBytes())};
+            glReadPixels(0, 0, GLsizei(width_), GLsizei(height_), GL_RGBA, GL_UNSIGNED_BYTE, job.pixels.data());
+            push(std::move(job));
+            return;
+        }
+
+        const GLuint pbo = pbo_[index % pbo_.size()];
+        gl_.bindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glReadPixels(0, 0, GLsizei(width_), GLsizei(height_), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        gl_.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        inFlight_.push_back({index, pbo});
+
+        // Map the oldest once the ring is full, keeping a buffer free for the next frame.
+        if (inFlight_.size() >= pbo_.size()) collect(1);
+    }
+
+    // Collects every readback still in flight, waits for the encoders and
+    // closes the output. Needs the same OpenGL context as capture().
+    void finish(std::ostream* log = nullptr) {
+        if (!open_) return;
+        collect(inFlight_.size());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closing_ = true;
+        }
+        queued_.notify_all();
+        for (std::thread& t : threads_) t.join();
+        threads_.clear();
+        if (gl_.ok && !pbo_.empty()) gl_.deleteBuffers(GLsizei(pbo_.size()), pbo_.data());
+        pbo_.clear();
+        if (out_ && out_ != stdout) {
+            if (piped_) pclose(out_);
+            else std::fclose(out_);
+        } else if (out_) {
+            std::fflush(out_);
+        }
+        out_ = nullptr;
+        piped_ = false;
+        open_ = false;
+
+        if (log) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+            *log << "recorded " << written_ << " frames (" << videoFormatName(options_.format) << ", " << width_
+                 << "x" << height_ << ") in " << seconds << " s, " << double(written_) / seconds << " fps"
+                 << (gl_.ok ? "" : ", synchronous readback") << (error_ ? ", write errors" : "") << "\n";
+        }
+    }
+
+private:
+    struct Job {
+        std::uint64_t index;
+        std::vector<std::uint8_t> pixels;
+    };
+    struct Pending {
+        std::uint64_t index;
+        GLuint pbo;
+    };
+
+    // Buffer object entry points, from the driver at run time.
+    struct GlBuffers {
+        bool ok = false;
+        void (GRAV_GLAPI* genBuffers)(GLsizei, GLuint*) = nullptr;
+        void (GRAV_GLAPI* deleteBuffers)(GLsizei, const GLuint*) = nullptr;
+        void (GRAV_GLAPI* bindBuffer)(GLenum, GLuint) = nullptr;
+        void (GRAV_GLAPI* bufferData)(GLenum, GLsizeiptr, const void*, GLenum) = nullptr;
+        void* (GRAV_GLAPI* mapBuffer)(GLenum, GLenum) = nullptr;
+        GLboolean (GRAV_GLAPI* unmapBuffer)(GLenum) = nullptr;
+    };
+
+    RecordOptions options_;
+    unsigned width_ = 0, height_ = 0;
+    std::string pattern_;
+    std::FILE* out_ = nullptr;
+    bool piped_ = false, open_ = false;
+    GlBuffers gl_;
+    std::vector<GLuint> pbo_;
+    std::deque<Pending> inFlight_;
+    std::uint64_t captured_ = 0;
+    std::chrono::steady_clock::time_point started_;
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable queued_, drained_, turn_;
+    std::deque<Job> queue_;
+    std::size_t maxQueued_ = 4;
+    bool closing_ = false, error_ = false;
+    std::uint64_t nextWrite_ = 0, written_ = 0;
+
+    std::size_t frameBytes() const { return std::size_t(width_) * height_ * 4; }
+
+    template <typename Fn>
+    static void load(Fn& fn, const char* name) {
+        fn = reinterpret_cast<Fn>(sf::Context::getFunction(name));
+    }
+
+    void loadGl() {
+        load(gl_.genBuffers, "glGenBuffers");
+        load(gl_.deleteBuffers, "glDeleteBuffers");
+        load(gl_.bindBuffer, "glBindBuffer");
+        load(gl_.bufferData, "glBufferData");
+        load(gl_.mapBuffer, "glMapBuffer");
+        load(gl_.unmapBuffer, "glUnmapBuffer");
+        gl_.ok = gl_.genBuffers && gl_.deleteBuffers && gl_.bindBuffer && gl_.bufferData && gl_.mapBuffer &&
+                 gl_.unmapBuffer;
+    }
+
+    // Maps the oldest `count` readbacks and queues their pixels.
+    void collect(std::size_t count) {
+        for (; count > 0 && !inFlight_.empty(); --count) {
+            const Pending p = inFlight_.front();
+            inFlight_.pop_front();
+            Job job{p.index, std::vector<std::uint8_t>(frameBytes())};
+            gl_.bindBuffer(GL_PIXEL_PACK_BUFFER, p.pbo);
+            if (const void* mapped = gl_.mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY)) {
+                std::memcpy(job.pixels.data(), mapped, job.pixels.size());
+                gl_.unmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            gl_.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            push(std::move(job));
+        }
+    }
+
+    void push(Job job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        drained_.wait(lock, [&] { return queue_.size() < maxQueued_; });
+        queue_.push_back(std::move(job));
+        lock.unlock();
+        queued_.notify_one();
+    }
+
+    void encodeLoop() {
+        std::vector<std::uint8_t> encoded;
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                queued_.wait(lock, [&] { return closing_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                job = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            drained_.notify_one();
+
+            if (options_.format == VideoFormat::Png) {
+                savePng(job);
+                continue;
+            }
+            if (options_.format == VideoFormat::Y4m) toY4m(job.pixels, encoded);
+            else flipRows(job.pixels, encoded);
+
+            // Streams keep frame order: wait for this frame's turn to write.
+            std::unique_lock<std::mutex> lock(mutex_);
+            turn_.wait(lock, [&] { return nextWrite_ == job.index; });
+            if (options_.format == VideoFormat::Y4m && std::fputs("FRAME\n", out_) < 0) error_ = true;
+            if (std::fwrite(encoded.data(), 1, encoded.size(), out_) != encoded.size()) error_ = true;
+            ++nextWrite_;
+            ++written_;
+            lock.unlock();
+            turn_.notify_all();
+        }
+    }
+
+    void savePng(const Job& job) {
+        std::vector<std::uint8_t> rows;
+        flipRows(job.pixels, rows);
+        sf::Image image;
+        image.create(width_, height_, rows.data());
+        char name[1024];
+        std::snprintf(name, sizeof(name), pattern_.c_str(), int(job.index));
+        const bool ok = image.saveToFile(name);
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++written_;
+        if (!ok) error_ = true;
+    }
+
+    void flipRows(const std::vector<std::uint8_t>& in, std::vector<std::uint8_t>& out) const {
+        const std::size_t stride = std::size_t(width_) * 4;
+        out.resize(in.size());
+        for (unsigned y = 0; y < height_; ++y)
+            std::memcpy(&out[y * stride], &in[(height_ - 1 - y) * stride], stride);
+    }
+
+    void writeY4mHeader() {
+        // Frame rate as a fraction, exact for whole and thousandth rates.
+        const long num = std::lround(options_.fps * 1000.0);
+        std::fprintf(out_, "YUV4MPEG2 W%u H%u F%ld:1000 Ip A1:1 C420jpeg\n", width_, height_, num);
+    }
+
+    // Full-range BT.601 4:2:0, chroma averaged over each 2x2 block.
+    void toY4m(const std::vector<std::uint8_t>& rgba, std::vector<std::uint8_t>& out) const {
+        const unsigned w = width_, h = height_, cw = (w + 1) / 2, ch = (h + 1) / 2;
+        out.resize(std::size_t(w) * h + 2 * std::size_t(cw) * ch);
+        std::uint8_t* yPlane = out.data();
+        std::uint8_t* uPlane = yPlane + std::size_t(w) * h;
+        std::uint8_t* vPlane = uPlane + std::size_t(cw) * ch;
+        auto pixel = [&](unsigned x, unsigned y) { return &rgba[(std::size_t(h - 1 - y) * w + x) * 4]; };
+        auto clamp8 = [](float v) { return std::uint8_t(std::clamp(v + 0.5f, 0.f, 255.f)); };
+
+        for (unsigned y = 0; y < h; ++y)
+            for (unsigned x = 0; x < w; ++x) {
+                const std::uint8_t* p = pixel(x, y);
+                yPlane[std::size_t(y) * w + x] = clamp8(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]);
+            }
+        for (unsigned cy = 0; cy < ch; ++cy)
+            for (unsigned cx = 0; cx < cw; ++cx) {
+                float r = 0.f, g = 0.f, b = 0.f;
+                for (unsigned k = 0; k < 4; ++k) {
+                    const std::uint8_t* p = pixel(std::min(w - 1, cx * 2 + (k & 1)), std::min(h - 1, cy * 2 + (k >> 1)));
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+                r *= 0.25f;
+                g *= 0.25f;
+                b *= 0.25f;
+                uPlane[std::size_t(cy) * cw + cx] = clamp8(128.f - 0.168736f * r - 0.331264f * g + 0.5f * b);
+                vPlane[std::size_t(cy) * cw + cx] = clamp8(128.f + 0.5f * r - 0.418688f * g - 0.081312f * b);
+            }
+    }
+};
+
+} // namespace grav
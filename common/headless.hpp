@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace grav {
+
+// Command-line switches for running a simulation without a window:
+//   --headless          step the physics only; no window, no OpenGL context
+//   --steps N           number of fixed steps to run (default 1000)
+//   --dump-every K      also print the state every K steps (default: first and last only)
+struct HeadlessOptions {
+    bool enabled = false;
+    std::uint64_t steps = 1000;
+    std::uint64_t dumpEvery = 0;
+};
+
+inline HeadlessOptions parseHeadless(int argc, char** argv) {
+    HeadlessOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--headless") opt.enabled = true;
+        else if (arg == "--steps" && i + 1 < argc) opt.steps = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--dump-every" && i + 1 < argc) opt.dumpEvery = std::strtoull(argv[++i], nullptr, 10);
+    }
+    return opt;
+}
+
+// Runs step(dt) opt.steps times on the calling thread. The state, written by
+// dump(std::ostream&), goes to stdout; the timing summary goes to stderr so it
+// never mixes with the data. Time spent dumping is not counted as stepping.
+template <typename Step, typename Dump>
+int runHeadless(const char* name, const HeadlessOptions& opt, double dt, std::size_t bodies, Step&& step, Dump&& dump) {
+    using clock = std::chrono::steady_clock;
+    std::ios::sync_with_stdio(false);
+    std::cout.precision(9); // round-trips a float
+
+    auto emit = [&](std::uint64_t done) {
+        std::cout << "# step " << done << " t " << double(done) * dt << "\n";
+        dump(std::cout);
+    };
+
+    emit(0);
+    double stepping = 0.0;
+    for (std::uint64_t done = 0; done < opt.steps;) {
+        std::uint64_t batch = opt.steps - done;
+        if (opt.dumpEvery > 0 && opt.dumpEvery < batch) batch = opt.dumpEvery;
+
+        const auto start = clock::now();
+        for (std::uint64_t i = 0; i < batch; ++i) step(dt);
+        stepping += std::chrono::duration<double>(clock::now() - start).count();
+
+        done += batch;
+        if (opt.dumpEvery > 0 || done == opt.steps) emit(done);
+    }
+    std::cout.flush();
+
+    const double stepsPerSec = stepping > 0.0 ? double(opt.steps) / stepping : 0.0;
+    std::cerr << name << " headless: steps=" << opt.steps << " dt=" << dt << " bodies=" << bodies
+              << " wall=" << stepping << "s steps/s=" << stepsPerSec
+              << " body-steps/s=" << stepsPerSec * double(bodies) << "\n";
+    return 0;
+}
+
+} // namespace grav
@@ -0,0 +1,393 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bodies.hpp"
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Time integrators for a Bodies store. Leapfrog, Yoshida4 and RK45 take forces
+// from a callback force(Bodies&) that fills acc from pos; Hermite4 needs the
+// jerk as well and sums it directly over all pairs.
+enum class Integrator { Leapfrog, Yoshida4, RK45, Hermite4 };
+
+inline const char* integratorName(Integrator i) {
+    switch (i) {
+        case Integrator::Leapfrog: return "leapfrog";
+        case Integrator::Yoshida4: return "yoshida4";
+        case Integrator::RK45: return "rk45";
+        case Integrator::Hermite4: return "hermite4";
+    }
+    return "?";
+}
+
+// Accepts the names printed by integratorName; false if the name is unknown.
+inline bool parseIntegrator(const std::string& name, Integrator& out) {
+    for (Integrator i : {Integrator::Leapfrog, Integrator::Yoshida4, Integrator::RK45, Integrator::Hermite4}) {
+        if (name == integratorName(i)) {
+            out = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace integrator_detail {
+constexpr std::size_t GRAIN = 16384;
+}
+
+// Kick-drift-kick leapfrog (velocity Verlet), second order and symplectic.
+// Needs b.acc current on entry and leaves it current; one force evaluation.
+template <typename T, int D, typename Force>
+void leapfrogStep(Bodies<T, D>& b, T dt, Force&& force) {
+    const T half = dt * T(0.5);
+    auto& pool = TaskScheduler::instance();
+    pool.parallelFor(0, b.size(), integrator_detail::GRAIN, [&](std::size_t first, std::size_t last) {
+        for (int k = 0; k < D; ++k) {
+            T* v = b.vel[k].data();
+            T* x = b.pos[k].data();
+            const T* a = b.acc[k].data();
+            for (std::size_t i = first; i < last; ++i) {
+                v[i] += a[i] * half;
+                x[i] += v[i] * dt;
+            }
+        }
+    });
+    force(b);
+    pool.parallelFor(0, b.size(), integrator_detail::GRAIN, [&](std::size_t first, std::size_t last) {
+        for (int k = 0; k < D; ++k) {
+            T* v = b.vel[k].data();
+            const T* a = b.acc[k].data();
+            for (std::size_t i = first; i < last; ++i)
+                v[i] += a[i] * half;
+        }
+    });
+}
+
+// Yoshida's fourth-order symplectic composition of three leapfrog steps
+// (the middle one backwards in time); three force evaluations.
+template <typename T, int D, typename Force>
+void yoshida4Step(Bodies<T, D>& b, T dt, Force&& force) {
+    const T cbrt2 = std::cbrt(T(2));
+    const T w1 = T(1) / (T(2) - cbrt2);
+    const T w0 = -cbrt2 * w1;
+    leapfrogStep(b, w1 * dt, force);
+    leapfrogStep(b, w0 * dt, force);
+    leapfrogStep(b, w1 * dt, force);
+}
+
+// Dormand-Prince 5(4) Runge-Kutta with adaptive step size. advance() covers dt
+// in as many accepted substeps as the tolerance needs and remembers the last
+// step size for the next call. The last stage is the force at the new state
+// (first-same-as-last), so b.acc is current on entry and on exit.
+template <typename T, int D>
+class DormandPrince {
+public:
+    T rtol = T(1e-9);   // relative tolerance per position/velocity component
+    T atol = T(1e-9);   // absolute tolerance, same units as the state
+    std::uint64_t accepted = 0, rejected = 0;
+
+    void reset() { h_ = T(0); }
+
+    // Returns the number of body accelerations computed.
+    template <typename Force>
+    std::uint64_t advance(Bodies<T, D>& b, T dt, Force&& force) {
+        const std::size_t n = b.size();
+        resize(b);
+        std::uint64_t evaluations = 0;
+        if (h_ <= T(0)) h_ = dt;
+
+        T left = dt;
+        while (left > T(0)) {
+            const bool last = h_ >= left;
+            const T h = last ? left : h_;
+
+            // Stage 0 is the current state (velocity, acceleration).
+            for (int k = 0; k < D; ++k) {
+                kx_[0][k] = b.vel[k];
+                kv_[0][k] = b.acc[k];
+            }
+            for (int s = 1; s < STAGES; ++s) {
+                combine(b, h, A[s], s);
+                force(stage_);
+                for (int k = 0; k < D; ++k) {
+                    kx_[s][k] = stage_.vel[k];
+                    kv_[s][k] = stage_.acc[k];
+                }
+            }
+            evaluations += std::uint64_t(STAGES - 1) * n;
+
+            // The last stage sits at t + h with fifth-order weights: it is the new state.
+            const T err = errorNorm(b, h);
+            const bool accept = err <= T(1) || h <= dt * T(1e-12);
+            T factor = err > T(0) ? T(0.9) * std::pow(err, T(-0.2)) : T(5);
+            factor = std::clamp(factor, T(0.2), accept ? T(5) : T(1));
+            if (accept) {
+                ++accepted;
+                for (int k = 0; k < D; ++k) {
+                    b.pos[k].swap(stage_.pos[k]);
+                    b.vel[k].swap(stage_.vel[k]);
+                    b.acc[k].swap(stage_.acc[k]);
+                }
+                left = last ? T(0) : left - h;
+                // A step clipped to the end of the interval says nothing about the next one.
+                h_ = last ? std::max(h_, h * factor) : h * factor;
+            } else {
+                ++rejected;
+                h_ = h * factor;
+            }
+        }
+        return evaluations;
+    }
+
+private:
+    static constexpr int STAGES = 7;
+    static constexpr double A[STAGES][STAGES] = {
+        {0, 0, 0, 0, 0, 0, 0},
+        {1.0 / 5, 0, 0, 0, 0, 0, 0},
+        {3.0 / 40, 9.0 / 40, 0, 0, 0, 0, 0},
+        {44.0 / 45, -56.0 / 15, 32.0 / 9, 0, 0, 0, 0},
+        {19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729, 0, 0, 0},
+        {9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656, 0, 0},
+        {35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84, 0},
+    };
+    // Fifth- minus fourth-order weights.
+    static constexpr double E[STAGES] = {71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920,
+                                         -17253.0 / 339200, 22.0 / 525, -1.0 / 40};
+
+    T h_ = T(0);
+    Bodies<T, D> stage_;
+    std::vector<T> kx_[STAGES][D], kv_[STAGES][D];
+    std::vector<T> chunkError_;
+
+    void resize(const Bodies<T, D>& b) {
+        const std::size_t n = b.size();
+        stage_.mass = b.mass;
+        for (int k = 0; k < D; ++k) {
+            stage_.pos[k].resize(n);
+            stage_.vel[k].resize(n);
+            stage_.acc[k].resize(n);
+        }
+    }
+
+    // stage_ = y + h * sum_j a[j] k_j over the stages before s.
+    void combine(const Bodies<T, D>& b, T h, const double (&a)[STAGES], int s) {
+        TaskScheduler::instance().parallelFor(0, b.size(), integrator_detail::GRAIN, [&](std::size_t first, std::size_t last) {
+            for (int k = 0; k < D; ++k) {
+                for (std::size_t i = first; i < last; ++i) {
+                    T dx = T(0), dv = T(0);
+                    for (int j = 0; j < s; ++j) {
+                        dx += T(a[j]) * kx_[j][k][i];
+                        dv += T(a[j]) * kv_[j][k][i];
+                    }
+                    stage_.pos[k][i] = b.pos[k][i] + h * dx;
+                    stage_.vel[k][i] = b.vel[k][i] + h * dv;
+                }
+            }
+        });
+    }
+
+    // Largest error over all components, scaled by the tolerance; <= 1 passes.
+    T errorNorm(const Bodies<T, D>& b, T h) {
+        const std::size_t n = b.size();
+        const std::size_t chunks = (n + integrator_detail::GRAIN - 1) / integrator_detail::GRAIN;
+        chunkError_.assign(chunks, T(0));
+        TaskScheduler::instance().parallelFor(0, n, integrator_detail::GRAIN, [&](std::size_t first, std::size_t last) {
+            T worst = T(0);
+            for (int k = 0; k < D; ++k) {
+                for (std::size_t i = first; i < last; ++i) {
+                    T ex = T(0), ev = T(0);
+                    for (int j = 0; j < STAGES; ++j) {
+                        ex += T(E[j]) * kx_[j][k][i];
+                        ev += T(E[j]) * kv_[j][k][i];
+                    }
+                    const T sx = atol + rtol * std::max(std::abs(b.pos[k][i]), std::abs(stage_.pos[k][i]));
+                    const T sv = atol + rtol * std::max(std::abs(b.vel[k][i]), std::abs(stage_.vel[k][i]));
+                    worst = std::max(worst, std::max(std::abs(h * ex) / sx, std::abs(h * ev) / sv));
+                }
+            }
+            chunkError_[first / integrator_detail::GRAIN] = worst;
+        });
+        T worst = T(0);
+        for (T e : chunkError_) worst = std::max(worst, e);
+        return std::isfinite(worst) ? worst : T(1e30);
+    }
+};
+
+// Fourth-order Hermite predictor-corrector with block individual timesteps.
+// Each body steps with dt / 2^level, where the level follows the Aarseth
+// criterion, so a moon in a tight orbit takes many small steps while the outer
+// planets take a few large ones. advance() moves every body to t + dt and
+// returns with all of them synchronised again.
+//
+// Forces and jerks are summed directly over all pairs for the active bodies
+// only, O(N * active) per block step; meant for hierarchical systems with a
+// few hundred bodies, not for disks of millions.
+template <typename T, int D>
+class BlockHermite {
+public:
+    T eta = T(0.02);        // accuracy parameter of the step criterion
+    T etaStart = T(0.01);   // the same for the first step, from acc and jerk alone
+    int maxLevel = 20;      // smallest step is dt / 2^maxLevel
+    T softening = T(0);     // Plummer softening length
+
+    // Forget acc/jerk history; call after editing the bodies by hand.
+    void reset() { n_ = 0; }
+
+    int level(std::size_t i) const { return level_[i]; }
+
+    // Returns the number of body accelerations (with jerk) computed.
+    std::uint64_t advance(Bodies<T, D>& b, T G, T dt) {
+        const std::size_t n = b.size();
+        std::uint64_t evaluations = 0;
+        if (n_ != n || dt_ != dt) evaluations += start(b, G, dt);
+
+        const std::uint64_t end = std::uint64_t(1) << maxLevel;
+        const T tickDt = dt / T(end);
+        std::fill(tick_.begin(), tick_.end(), std::uint64_t(0));
+        auto& pool = TaskScheduler::instance();
+
+        for (;;) {
+            std::uint64_t next = ~std::uint64_t(0);
+            for (std::size_t i = 0; i < n; ++i) next = std::min(next, tick_[i] + span(level_[i]));
+            if (next > end) break;
+            active_.clear();
+            for (std::size_t i = 0; i < n; ++i)
+                if (tick_[i] + span(level_[i]) == next) active_.push_back(std::uint32_t(i));
+
+            // Predict everyone to the block time.
+            pool.parallelFor(0, n, integrator_detail::GRAIN, [&](std::size_t first, std::size_t last) {
+                for (std::size_t i = first; i < last; ++i) {
+                    const T h = T(next - tick_[i]) * tickDt;
+                    for (int k = 0; k < D; ++k) {
+                        xp_[k][i] = b.pos[k][i] + h * (b.vel[k][i] + h * (acc_[k][i] / T(2) + h * jerk_[k][i] / T(6)));
+                        vp_[k][i] = b.vel[k][i] + h * (acc_[k][i] + h * jerk_[k][i] / T(2));
+                    }
+                }
+            });
+
+            // Correct the active bodies from their new acceleration and jerk.
+            pool.parallelFor(0, active_.size(), 16, [&](std::size_t first, std::size_t last) {
+                for (std::size_t a = first; a < last; ++a) {
+                    const std::size_t i = active_[a];
+                    T a1[D], j1[D];
+                    accJerk(b, G, i, a1, j1);
+                    correct(b, i, a1, j1, next, tickDt);
+                }
+            });
+            evaluations += active_.size();
+        }
+
+        for (int k = 0; k < D; ++k) std::copy(acc_[k].begin(), acc_[k].end(), b.acc[k].begin());
+        return evaluations;
+    }
+
+private:
+    std::size_t n_ = 0;
+    T dt_ = T(0);
+    std::vector<T> acc_[D], jerk_[D], xp_[D], vp_[D];
+    std::vector<std::uint64_t> tick_;
+    std::vector<int> level_;
+    std::vector<std::uint32_t> active_;
+
+    std::uint64_t span(int level) const { return std::uint64_t(1) << (maxLevel - level); }
+
+    // Finest level whose step is no longer than `want`.
+    int levelFor(T want) const {
+        if (!(want > T(0))) return maxLevel;
+        const T ratio = dt_ / want;
+        if (ratio <= T(1)) return 0;
+        return std::min(maxLevel, int(std::ceil(std::log2(ratio))));
+    }
+
+    std::uint64_t start(const Bodies<T, D>& b, T G, T dt) {
+        const std::size_t n = b.size();
+        n_ = n;
+        dt_ = dt;
+        for (int k = 0; k < D; ++k) {
+            acc_[k].assign(n, T(0));
+            jerk_[k].assign(n, T(0));
+            xp_[k] = b.pos[k];
+            vp_[k] = b.vel[k];
+        }
+        tick_.assign(n, 0);
+        level_.assign(n, 0);
+        TaskScheduler::instance().parallelFor(0, n, 16, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                T a[D], j[D];
+                accJerk(b, G, i, a, j);
+                T a2 = T(0), j2 = T(0);
+                for (int k = 0; k < D; ++k) {
+                    acc_[k][i] = a[k];
+                    jerk_[k][i] = j[k];
+                    a2 += a[k] * a[k];
+                    j2 += j[k] * j[k];
+                }
+                level_[i] = j2 > T(0) ? levelFor(etaStart * std::sqrt(a2 / j2)) : 0;
+            }
+        });
+        return n;
+    }
+
+    // Acceleration and jerk on body i from the predicted state of all others.
+    void accJerk(const Bodies<T, D>& b, T G, std::size_t i, T (&a)[D], T (&j)[D]) const {
+        const T eps2 = softening * softening;
+        for (int k = 0; k < D; ++k) a[k] = j[k] = T(0);
+        for (std::size_t m = 0; m < n_; ++m) {
+            if (m == i) continue;
+            T d[D], dv[D], r2 = eps2, rv = T(0);
+            for (int k = 0; k < D; ++k) {
+                d[k] = xp_[k][m] - xp_[k][i];
+                dv[k] = vp_[k][m] - vp_[k][i];
+                r2 += d[k] * d[k];
+                rv += d[k] * dv[k];
+            }
+            if (r2 <= T(0)) continue;
+            const T inv = T(1) / r2;
+            const T mr3 = G * b.mass[m] * inv * std::sqrt(inv);
+            const T c = T(3) * rv * inv;
+            for (int k = 0; k < D; ++k) {
+                a[k] += mr3 * d[k];
+                j[k] += mr3 * (dv[k] - c * d[k]);
+            }
+        }
+    }
+
+    void correct(Bodies<T, D>& b, std::size_t i, const T (&a1)[D], const T (&j1)[D], std::uint64_t now, T tickDt) {
+        const T h = T(span(level_[i])) * tickDt;
+        const T h2 = h * h, h3 = h2 * h;
+        T sa1 = T(0), sj1 = T(0), s2 = T(0), s3 = T(0);
+        for (int k = 0; k < D; ++k) {
+            const T a0 = acc_[k][i], j0 = jerk_[k][i];
+            const T snap = (T(-6) * (a0 - a1[k]) - h * (T(4) * j0 + T(2) * j1[k])) / h2;
+            const T crackle = (T(12) * (a0 - a1[k]) + T(6) * h * (j0 + j1[k])) / h3;
+            b.pos[k][i] = xp_[k][i] + h2 * h2 * (snap / T(24) + h * crackle / T(120));
+            b.vel[k][i] = vp_[k][i] + h3 * (snap / T(6) + h * crackle / T(24));
+            acc_[k][i] = a1[k];
+            jerk_[k][i] = j1[k];
+
+            const T snapEnd = snap + h * crackle;
+            sa1 += a1[k] * a1[k];
+            sj1 += j1[k] * j1[k];
+            s2 += snapEnd * snapEnd;
+            s3 += crackle * crackle;
+        }
+        tick_[i] = now;
+
+        // Aarseth criterion, then keep the step a power-of-two fraction of dt
+        // that divides the current time: halve freely, double only when aligned.
+        const T num = std::sqrt(sa1 * s2) + sj1;
+        const T den = std::sqrt(sj1 * s3) + s2;
+        const int want = den > T(0) ? levelFor(std::sqrt(eta * num / den)) : 0;
+        int& level = level_[i];
+        if (want > level) level = want;
+        else if (want < level && now % span(level - 1) == 0) level -= 1;
+    }
+};
+
+} // namespace grav
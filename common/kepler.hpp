@@ -0,0 +1,259 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+
+#include "simd.hpp"
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Bodies on fixed Keplerian ellipses, evaluated in closed form at any time:
+// no stepping state, so positions never drift and jumping to another date
+// costs the same as the next frame.
+//
+// Each body keeps its mean motion and mean anomaly at t = 0 (in double, so the
+// phase stays exact over long spans) and its orbit orientation folded into two
+// scaled axis vectors, P (towards periapsis, times a) and Q (direction of
+// motion at periapsis, times b). propagate(t) solves Kepler's equation
+// M = E - e sin E for the eccentric anomaly with a fixed number of Halley
+// steps (two more past e = 0.99) from Danby's starting guess, 8 (AVX2) or
+// 16 (AVX-512) bodies per instruction, and places each body at
+// (cos E - e) P + sin E Q relative to whatever it orbits. Elliptic orbits
+// only: e is clamped to 0.999. An orbit may also precess, turning about the
+// z axis at a fixed rate; those few are turned after the solve, so orbits
+// without precession pay nothing for it.
+class KeplerOrbits {
+public:
+    static constexpr int HALLEY_STEPS = 4;   // float precision for every e up to 0.99 (3 reach e = 0.9)
+    static constexpr int HIGH_E_STEPS = 6;   // the same up to the 0.999 add() allows
+    static constexpr float HIGH_E = 0.99f;   // e past which a body, and the SIMD group it is in, takes HIGH_E_STEPS
+
+    AlignedVector<double> meanMotion;       // radians per unit of time
+    AlignedVector<double> meanAnomaly;      // radians at t = 0
+    AlignedVector<float> e;                 // eccentricity
+    AlignedVector<float> px, py, pz;        // periapsis direction times the semi-major axis
+    AlignedVector<float> qx, qy, qz;        // perpendicular in-plane direction times the semi-minor axis
+    AlignedVector<float> precession;        // turn about z, radians per unit of time
+
+    // Written by propagate(); velocities only when asked for
+    AlignedVector<float> x, y, z;
+    AlignedVector<float> vx, vy, vz;
+    bool velocities = false;
+
+    std::size_t size() const { return e.size(); }
+
+    void reserve(std::size_t n) {
+        meanMotion.reserve(n);
+        meanAnomaly.reserve(n);
+        for (auto* v : {&e, &px, &py, &pz, &qx, &qy, &qz, &precession, &x, &y, &z, &vx, &vy, &vz}) v->reserve(n);
+    }
+
+    // Semi-major axis a, eccentricity, period and mean anomaly at t = 0, then
+    // the orientation: inclination to the x-y plane, longitude of the ascending
+    // node and argument of periapsis, all in radians. With the last three at
+    // zero the orbit lies in the plane with periapsis along +x, and a circular
+    // orbit's mean anomaly is simply its angle from +x. A nonzero precession
+    // turns the whole orbit about z by that many radians per unit of time.
+    std::size_t add(double a, double ecc, double period, double meanAnomalyAtZero, double inclination = 0.0,
+                    double node = 0.0, double periapsis = 0.0, double precessionRate = 0.0) {
+        ecc = std::fmin(std::fmax(ecc, 0.0), 0.999);
+        const double b = a * std::sqrt(1.0 - ecc * ecc);
+        const double cn = std::cos(node), sn = std::sin(node);
+        const double cw = std::cos(periapsis), sw = std::sin(periapsis);
+        const double ci = std::cos(inclination), si = std::sin(inclination);
+        meanMotion.push_back(period > 0.0 ? 2.0 * PI / period : 0.0);
+        meanAnomaly.push_back(meanAnomalyAtZero);
+        e.push_back(float(ecc));
+        px.push_back(float(a * (cn * cw - sn * sw * ci)));
+        py.push_back(float(a * (sn * cw + cn * sw * ci)));
+        pz.push_back(float(a * (sw * si)));
+        qx.push_back(float(b * (-cn * sw - sn * cw * ci)));
+        qy.push_back(float(b * (-sn * sw + cn * cw * ci)));
+        qz.push_back(float(b * (cw * si)));
+        precession.push_back(float(precessionRate));
+        precessing_ += precessionRate != 0.0;
+        for (auto* v : {&x, &y, &z, &vx, &vy, &vz}) v->push_back(0.f);
+        return e.size() - 1;
+    }
+
+    // Every body at time t, split across the task scheduler.
+    void propagate(double t) {
+        TaskScheduler::instance().parallelFor(0, size(), 16384,
+                                              [&](std::size_t first, std::size_t last) { propagate(t, first, last); });
+    }
+
+    // Bodies [first, last) at time t, using the widest kernel the CPU has.
+    void propagate(double t, std::size_t first, std::size_t last) {
+        std::size_t done = first;
+        switch (simdLevel()) {
+#if GRAV_X86_SIMD
+            case SimdLevel::Avx512: done = propagateAvx512(t, first, last); break;
+            case SimdLevel::Avx2: done = propagateAvx2(t, first, last); break;
+#endif
+            default: break;
+        }
+        propagateScalar(t, done, last);
+        if (precessing_ > 0) turn(t, first, last);
+    }
+
+    void propagateScalar(double t, std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            double m = meanAnomaly[i] + meanMotion[i] * t;
+            m -= 2.0 * PI * std::nearbyint(m * (0.5 / PI));
+            const float ecc = e[i];
+            const float E = eccentricAnomaly(float(m), ecc);
+            const float s = std::sin(E), c = std::cos(E);
+            x[i] = (c - ecc) * px[i] + s * qx[i];
+            y[i] = (c - ecc) * py[i] + s * qy[i];
+            z[i] = (c - ecc) * pz[i] + s * qz[i];
+            if (velocities) {
+                const float k = float(meanMotion[i]) / (1.f - ecc * c);
+                vx[i] = k * (c * qx[i] - s * px[i]);
+                vy[i] = k * (c * qy[i] - s * py[i]);
+                vz[i] = k * (c * qz[i] - s * pz[i]);
+            }
+        }
+    }
+
+    // Solves M = E - e sin E for M in [-pi, pi].
+    static float eccentricAnomaly(float M, float ecc) {
+        float E = M + (M < 0.f ? -DANBY : DANBY) * ecc;
+        const int steps = ecc > HIGH_E ? HIGH_E_STEPS : HALLEY_STEPS;
+        for (int k = 0; k < steps; ++k) {
+            const float s = ecc * std::sin(E), c = ecc * std::cos(E);
+            const float f = E - s - M, d1 = 1.f - c;
+            E -= f / (d1 - 0.5f * f * s / d1);
+        }
+        return E;
+    }
+
+private:
+    static constexpr double PI = 3.14159265358979323846;
+    static constexpr float DANBY = 0.85f;   // E0 = M + 0.85 e sign(M)
+
+    std::size_t precessing_ = 0;            // orbits with a nonzero precession
+
+    // Turns the precessing orbits among [first, last) by their angle at time
+    // t; their velocities gain the turn's own w x r.
+    void turn(double t, std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            if (precession[i] == 0.f) continue;
+            const double angle = std::remainder(double(precession[i]) * t, 2.0 * PI);
+            const float c = float(std::cos(angle)), s = float(std::sin(angle));
+            const float x0 = x[i], y0 = y[i];
+            x[i] = c * x0 - s * y0;
+            y[i] = s * x0 + c * y0;
+            if (velocities) {
+                const float vx0 = vx[i], vy0 = vy[i];
+                vx[i] = c * vx0 - s * vy0 - precession[i] * y[i];
+                vy[i] = s * vx0 + c * vy0 + precession[i] * x[i];
+            }
+        }
+    }
+
+#if GRAV_X86_SIMD
+    // Kernels return the first index they did not process; the caller finishes the tail.
+    GRAV_TARGET_AVX2 std::size_t propagateAvx2(double t, std::size_t first, std::size_t last) {
+        const __m256d vT = _mm256_set1_pd(t);
+        const __m256d vTwoPi = _mm256_set1_pd(2.0 * PI), vInvTwoPi = _mm256_set1_pd(0.5 / PI);
+        const __m256 signMask = _mm256_set1_ps(-0.f), one = _mm256_set1_ps(1.f), half = _mm256_set1_ps(0.5f);
+        const __m256 danby = _mm256_set1_ps(DANBY), highE = _mm256_set1_ps(HIGH_E);
+
+        std::size_t i = first;
+        for (; i + 8 <= last; i += 8) {
+            // Mean anomaly in double, reduced to [-pi, pi], then single precision
+            __m256d m0 = _mm256_fmadd_pd(_mm256_loadu_pd(&meanMotion[i]), vT, _mm256_loadu_pd(&meanAnomaly[i]));
+            __m256d m1 = _mm256_fmadd_pd(_mm256_loadu_pd(&meanMotion[i + 4]), vT, _mm256_loadu_pd(&meanAnomaly[i + 4]));
+            m0 = _mm256_fnmadd_pd(vTwoPi, _mm256_round_pd(_mm256_mul_pd(m0, vInvTwoPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), m0);
+            m1 = _mm256_fnmadd_pd(vTwoPi, _mm256_round_pd(_mm256_mul_pd(m1, vInvTwoPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), m1);
+            const __m256 M = _mm256_set_m128(_mm256_cvtpd_ps(m1), _mm256_cvtpd_ps(m0));
+            const __m256 ecc = _mm256_loadu_ps(&e[i]);
+
+            __m256 E = _mm256_fmadd_ps(_mm256_or_ps(_mm256_and_ps(M, signMask), danby), ecc, M);
+            __m256 s, c;
+            const int steps = _mm256_movemask_ps(_mm256_cmp_ps(ecc, highE, _CMP_GT_OQ)) ? HIGH_E_STEPS : HALLEY_STEPS;
+            for (int k = 0; k < steps; ++k) {
+                sincos8(E, s, c);
+                s = _mm256_mul_ps(ecc, s);
+                c = _mm256_mul_ps(ecc, c);
+                const __m256 f = _mm256_sub_ps(_mm256_sub_ps(E, s), M);
+                const __m256 d1 = _mm256_sub_ps(one, c);
+                const __m256 d = _mm256_sub_ps(d1, _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(half, f), s), d1));
+                E = _mm256_sub_ps(E, _mm256_div_ps(f, d));
+            }
+            sincos8(E, s, c);
+
+            const __m256 u = _mm256_sub_ps(c, ecc);
+            _mm256_storeu_ps(&x[i], _mm256_fmadd_ps(u, _mm256_loadu_ps(&px[i]), _mm256_mul_ps(s, _mm256_loadu_ps(&qx[i]))));
+            _mm256_storeu_ps(&y[i], _mm256_fmadd_ps(u, _mm256_loadu_ps(&py[i]), _mm256_mul_ps(s, _mm256_loadu_ps(&qy[i]))));
+            _mm256_storeu_ps(&z[i], _mm256_fmadd_ps(u, _mm256_loadu_ps(&pz[i]), _mm256_mul_ps(s, _mm256_loadu_ps(&qz[i]))));
+            if (velocities) {
+                const __m256 n = _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(&meanMotion[i + 4])),
+                                                 _mm256_cvtpd_ps(_mm256_loadu_pd(&meanMotion[i])));
+                const __m256 k = _mm256_div_ps(n, _mm256_fnmadd_ps(ecc, c, one));
+                const __m256 ks = _mm256_mul_ps(k, s), kc = _mm256_mul_ps(k, c);
+                _mm256_storeu_ps(&vx[i], _mm256_fmsub_ps(kc, _mm256_loadu_ps(&qx[i]), _mm256_mul_ps(ks, _mm256_loadu_ps(&px[i]))));
+                _mm256_storeu_ps(&vy[i], _mm256_fmsub_ps(kc, _mm256_loadu_ps(&qy[i]), _mm256_mul_ps(ks, _mm256_loadu_ps(&py[i]))));
+                _mm256_storeu_ps(&vz[i], _mm256_fmsub_ps(kc, _mm256_loadu_ps(&qz[i]), _mm256_mul_ps(ks, _mm256_loadu_ps(&pz[i]))));
+            }
+        }
+        return i;
+    }
+
+    GRAV_TARGET_AVX512 static __m512 halves16(__m256 lo, __m256 hi) {
+        return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(lo)), _mm256_castps_pd(hi), 1));
+    }
+
+    GRAV_TARGET_AVX512 std::size_t propagateAvx512(double t, std::size_t first, std::size_t last) {
+        const __m512d vT = _mm512_set1_pd(t);
+        const __m512d vTwoPi = _mm512_set1_pd(2.0 * PI), vInvTwoPi = _mm512_set1_pd(0.5 / PI);
+        const __m512i signMask = _mm512_set1_epi32(int(0x80000000u));
+        const __m512 one = _mm512_set1_ps(1.f), half = _mm512_set1_ps(0.5f);
+        const __m512i danby = _mm512_castps_si512(_mm512_set1_ps(DANBY));
+        const __m512 highE = _mm512_set1_ps(HIGH_E);
+
+        std::size_t i = first;
+        for (; i + 16 <= last; i += 16) {
+            __m512d m0 = _mm512_fmadd_pd(_mm512_loadu_pd(&meanMotion[i]), vT, _mm512_loadu_pd(&meanAnomaly[i]));
+            __m512d m1 = _mm512_fmadd_pd(_mm512_loadu_pd(&meanMotion[i + 8]), vT, _mm512_loadu_pd(&meanAnomaly[i + 8]));
+            m0 = _mm512_fnmadd_pd(vTwoPi, _mm512_roundscale_pd(_mm512_mul_pd(m0, vInvTwoPi), _MM_FROUND_TO_NEAREST_INT), m0);
+            m1 = _mm512_fnmadd_pd(vTwoPi, _mm512_roundscale_pd(_mm512_mul_pd(m1, vInvTwoPi), _MM_FROUND_TO_NEAREST_INT), m1);
+            const __m512 M = halves16(_mm512_cvtpd_ps(m0), _mm512_cvtpd_ps(m1));
+            const __m512 ecc = _mm512_loadu_ps(&e[i]);
+
+            const __m512 sign = _mm512_castsi512_ps(
+                _mm512_or_si512(_mm512_and_si512(_mm512_castps_si512(M), signMask), danby));
+            __m512 E = _mm512_fmadd_ps(sign, ecc, M);
+            __m512 s, c;
+            const int steps = _mm512_cmp_ps_mask(ecc, highE, _CMP_GT_OQ) ? HIGH_E_STEPS : HALLEY_STEPS;
+            for (int k = 0; k < steps; ++k) {
+                sincos16(E, s, c);
+                s = _mm512_mul_ps(ecc, s);
+                c = _mm512_mul_ps(ecc, c);
+                const __m512 f = _mm512_sub_ps(_mm512_sub_ps(E, s), M);
+                const __m512 d1 = _mm512_sub_ps(one, c);
+                const __m512 d = _mm512_sub_ps(d1, _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(half, f), s), d1));
+                E = _mm512_sub_ps(E, _mm512_div_ps(f, d));
+            }
+            sincos16(E, s, c);
+
+            const __m512 u = _mm512_sub_ps(c, ecc);
+            _mm512_storeu_ps(&x[i], _mm512_fmadd_ps(u, _mm512_loadu_ps(&px[i]), _mm512_mul_ps(s, _mm512_loadu_ps(&qx[i]))));
+            _mm512_storeu_ps(&y[i], _mm512_fmadd_ps(u, _mm512_loadu_ps(&py[i]), _mm512_mul_ps(s, _mm512_loadu_ps(&qy[i]))));
+            _mm512_storeu_ps(&z[i], _mm512_fmadd_ps(u, _mm512_loadu_ps(&pz[i]), _mm512_mul_ps(s, _mm512_loadu_ps(&qz[i]))));
+            if (velocities) {
+                const __m512 n = halves16(_mm512_cvtpd_ps(_mm512_loadu_pd(&meanMotion[i])),
+                                          _mm512_cvtpd_ps(_mm512_loadu_pd(&meanMotion[i + 8])));
+                const __m512 k = _mm512_div_ps(n, _mm512_fnmadd_ps(ecc, c, one));
+                const __m512 ks = _mm512_mul_ps(k, s), kc = _mm512_mul_ps(k, c);
+                _mm512_storeu_ps(&vx[i], _mm512_fmsub_ps(kc, _mm512_loadu_ps(&qx[i]), _mm512_mul_ps(ks, _mm512_loadu_ps(&px[i]))));
+                _mm512_storeu_ps(&vy[i], _mm512_fmsub_ps(kc, _mm512_loadu_ps(&qy[i]), _mm512_mul_ps(ks, _mm512_loadu_ps(&py[i]))));
+                _mm512_storeu_ps(&vz[i], _mm512_fmsub_ps(kc, _mm512_loadu_ps(&qz[i]), _mm512_mul_ps(ks, _mm512_loadu_ps(&pz[i]))));
+            }
+        }
+        return i;
+    }
+#endif
+};
+
+} // namespace grav
@@ -0,0 +1,271 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "simd.hpp"
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Gravitational lensing by a Schwarzschild black hole, rendered on the CPU.
+//
+// A light ray passing the hole with impact parameter b is bent by an angle
+// alpha(b) found by integrating the null geodesic (Binet's equation
+// u'' + u = 3/2 r_s u^2). That depends only on b / r_s, so it is tabulated
+// once against x = b_crit / b in [0, 1], where b_crit = 3 sqrt(3) / 2 r_s is
+// the photon sphere's capture radius: rays with x >= 1 fall in and stay black.
+//
+// Each pixel at distance b from the hole then looks up alpha and samples the
+// background at b - sourceDistance * alpha along the same direction, a thin
+// lens with an equidistant sky, so rays bent past 90 degrees give secondary
+// images and the Einstein ring sits at sqrt(2 r_s sourceDistance). The
+// background is mirrored at its edges.
+//
+// The frame is cut into tiles shared across the task scheduler; rows run 8
+// (AVX2) or 16 (AVX-512) pixels at a time with gathers into the table and
+// the background.
+class LensTracer {
+public:
+    static constexpr int TABLE_SIZE = 4096;
+    static constexpr float CAPTURE = 2.59807621f;    // b_crit / r_s = 3 sqrt(3) / 2
+
+    float schwarzschildRadius = 24.f;   // r_s in pixels
+    float sourceDistance = 600.f;       // lens to background, in pixels
+    int tileSize = 64;
+
+    LensTracer() { buildTable(); }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Background pixels, 32-bit RGBA, row-major; also sets the output size.
+    void setBackground(const std::uint32_t* pixels, int w, int h) {
+        width_ = w;
+        height_ = h;
+        background_.assign(pixels, pixels + std::size_t(w) * h);
+    }
+
+    // Deflection in radians for an impact parameter of b Schwarzschild radii;
+    // 0 for b at or inside the capture radius.
+    float deflection(float b) const {
+        const float x = CAPTURE / b;
+        return x >= 1.f || !(b > 0.f) ? 0.f : lookup(x);
+    }
+
+    // Renders the lensed background for a hole at pixel (hx, hy) into out,
+    // width() * height() pixels.
+    void render(float hx, float hy, std::uint32_t* out) const {
+        if (background_.empty()) return;
+        const int tile = std::max(16, tileSize / 16 * 16);
+        const int cols = (width_ + tile - 1) / tile;
+        const int rows = (height_ + tile - 1) / tile;
+        TaskScheduler::instance().parallelFor(0, std::size_t(cols) * rows, 1, [&](std::size_t first, std::size_t last) {
+            for (std::size_t t = first; t < last; ++t) {
+                const int x0 = int(t % cols) * tile, y0 = int(t / cols) * tile;
+                const int x1 = std::min(width_, x0 + tile), y1 = std::min(height_, y0 + tile);
+                for (int y = y0; y < y1; ++y) renderRow(hx, hy, y, x0, x1, out + std::size_t(y) * width_);
+            }
+        });
+    }
+
+    void renderRow(float hx, float hy, int y, int x0, int x1, std::uint32_t* row) const {
+        switch (simdLevel()) {
+#if GRAV_X86_SIMD
+            case SimdLevel::Avx512: x0 = rowAvx512(hx, hy, y, x0, x1, row); break;
+            case SimdLevel::Avx2: x0 = rowAvx2(hx, hy, y, x0, x1, row); break;
+#endif
+            default: break;
+        }
+        rowScalar(hx, hy, y, x0, x1, row);
+    }
+
+    void rowScalar(float hx, float hy, int y, int x0, int x1, std::uint32_t* row) const {
+        const Frame f = frame(hy, y);
+        for (int x = x0; x < x1; ++x) {
+            const float dx = float(x) + 0.5f - hx;
+            const float b = std::sqrt(dx * dx + f.dy2);
+            const float inv = 1.f / b;
+            const float c = f.capture * inv;
+            if (!(c < 1.f)) {
+                row[x] = black_;
+                continue;
+            }
+            const float t = c * float(TABLE_SIZE - 1);
+            const int i = std::min(int(t), TABLE_SIZE - 2);
+            const float alpha = table_[i] + (t - float(i)) * (table_[i + 1] - table_[i]);
+            const float scale = 1.f - sourceDistance * alpha * inv;
+            const int sx = mirror(hx + dx * scale, float(width_), f.invW2);
+            const int sy = mirror(hy + f.dy * scale, float(height_), f.invH2);
+            row[x] = background_[std::size_t(sy) * width_ + sx];
+        }
+    }
+
+private:
+    int width_ = 0, height_ = 0;
+    std::vector<std::uint32_t> background_;
+    AlignedVector<float> table_;
+    std::uint32_t black_ = 0;
+
+    // Per-row constants.
+    struct Frame {
+        float dy, dy2, capture, invW2, invH2;
+    };
+    Frame frame(float hy, int y) const {
+        const float dy = float(y) + 0.5f - hy;
+        return {dy, dy * dy, CAPTURE * schwarzschildRadius, 0.5f / float(width_), 0.5f / float(height_)};
+    }
+
+    // Folds a coordinate into [0, size) by reflecting at the edges.
+    static int mirror(float v, float size, float invTwice) {
+        const float f = v - std::floor(v * invTwice) * (2.f * size);
+        const float m = size - std::abs(f - size);
+        return std::min(int(m), int(size) - 1);
+    }
+
+    float lookup(float x) const {
+        const float t = x * float(TABLE_SIZE - 1);
+        const int i = std::min(int(t), TABLE_SIZE - 2);
+        return table_[i] + (t - float(i)) * (table_[i + 1] - table_[i]);
+    }
+
+    // alpha(x) for x = b_crit / b, in units where r_s = 1: integrate
+    // u'' = -u + 3/2 u^2 from u = 0, u' = 1/b until the ray escapes again (u = 0);
+    // the swept angle minus pi is the deflection.
+    void buildTable() {
+        const unsigned char opaque[4] = {0, 0, 0, 255};
+        std::memcpy(&black_, opaque, sizeof(black_));
+        table_.assign(TABLE_SIZE, 0.f);
+        TaskScheduler::instance().parallelFor(1, TABLE_SIZE, 64, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                // The last entry would be the photon sphere itself; stop just short of it.
+                const double x = i + 1 == std::size_t(TABLE_SIZE) ? 1.0 - 0.25 / (TABLE_SIZE - 1)
+                                                                   : double(i) / (TABLE_SIZE - 1);
+                table_[i] = float(sweep(double(CAPTURE) / x) - 3.14159265358979);
+            }
+        });
+    }
+
+    static double sweep(double b) {
+        const double h = 1e-3, maxAngle = 60.0;
+        double u = 0.0, w = 1.0 / b, phi = 0.0;
+        auto accel = [](double v) { return -v + 1.5 * v * v; };
+        while (phi < maxAngle) {
+            const double k1u = w, k1w = accel(u);
+            const double k2u = w + 0.5 * h * k1w, k2w = accel(u + 0.5 * h * k1u);
+            const double k3u = w + 0.5 * h * k2w, k3w = accel(u + 0.5 * h * k2u);
+            const double k4u = w + h * k3w, k4w = accel(u + h * k3u);
+            const double un = u + h / 6.0 * (k1u + 2.0 * k2u + 2.0 * k3u + k4u);
+            const double wn = w + h / 6.0 * (k1w + 2.0 * k2w + 2.0 * k3w + k4w);
+            if (un < 0.0) return phi + h * u / (u - un);
+            u = un;
+            w = wn;
+            phi += h;
+        }
+        return maxAngle;
+    }
+
+#if GRAV_X86_SIMD
+    // Kernels return the first pixel they did not render; the caller finishes the row.
+    GRAV_TARGET_AVX2 int rowAvx2(float hx, float hy, int y, int x0, int x1, std::uint32_t* row) const {
+        const Frame f = frame(hy, y);
+        const __m256 vHx = _mm256_set1_ps(hx), vHy = _mm256_set1_ps(hy);
+        const __m256 vDy = _mm256_set1_ps(f.dy), vDy2 = _mm256_set1_ps(f.dy2);
+        const __m256 vCapture = _mm256_set1_ps(f.capture), vOne = _mm256_set1_ps(1.f);
+        const __m256 vScale = _mm256_set1_ps(float(TABLE_SIZE - 1));
+        const __m256 vDist = _mm256_set1_ps(sourceDistance);
+        const __m256 vW = _mm256_set1_ps(float(width_)), vH = _mm256_set1_ps(float(height_));
+        const __m256 vInvW2 = _mm256_set1_ps(f.invW2), vInvH2 = _mm256_set1_ps(f.invH2);
+        const __m256i vMaxX = _mm256_set1_epi32(width_ - 1), vMaxY = _mm256_set1_epi32(height_ - 1);
+        const __m256i vLastEntry = _mm256_set1_epi32(TABLE_SIZE - 2), vRow = _mm256_set1_epi32(width_);
+        const __m256i vBlack = _mm256_set1_epi32(int(black_));
+        const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const int* bg = reinterpret_cast<const int*>(background_.data());
+
+        int x = x0;
+        for (; x + 8 <= x1; x += 8) {
+            const __m256 dx = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(float(x)), lane), vHx);
+            const __m256 b = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, vDy2));
+            const __m256 inv = _mm256_div_ps(vOne, b);
+            const __m256 c = _mm256_mul_ps(vCapture, inv);
+            const __m256 open = _mm256_cmp_ps(c, vOne, _CMP_LT_OQ);
+            if (_mm256_movemask_ps(open) == 0) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x), vBlack);
+                continue;
+            }
+            const __m256 t = _mm256_mul_ps(_mm256_and_ps(c, open), vScale);
+            const __m256i i = _mm256_min_epi32(_mm256_cvttps_epi32(t), vLastEntry);
+            const __m256 a0 = _mm256_i32gather_ps(table_.data(), i, 4);
+            const __m256 a1 = _mm256_i32gather_ps(table_.data() + 1, i, 4);
+            const __m256 alpha = _mm256_fmadd_ps(_mm256_sub_ps(t, _mm256_cvtepi32_ps(i)), _mm256_sub_ps(a1, a0), a0);
+            const __m256 scale = _mm256_fnmadd_ps(_mm256_mul_ps(vDist, alpha), inv, vOne);
+            const __m256i sx = mirror8(_mm256_fmadd_ps(dx, scale, vHx), vW, vInvW2, vMaxX);
+            const __m256i sy = mirror8(_mm256_fmadd_ps(vDy, scale, vHy), vH, vInvH2, vMaxY);
+            const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(sy, vRow), sx);
+            const __m256i pixel = _mm256_mask_i32gather_epi32(vBlack, bg, index, _mm256_castps_si256(open), 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x), pixel);
+        }
+        return x;
+    }
+
+    GRAV_TARGET_AVX2 static __m256i mirror8(__m256 v, __m256 size, __m256 invTwice, __m256i maxIndex) {
+        const __m256 twice = _mm256_add_ps(size, size);
+        const __m256 f = _mm256_fnmadd_ps(_mm256_floor_ps(_mm256_mul_ps(v, invTwice)), twice, v);
+        const __m256 m = _mm256_sub_ps(size, _mm256_andnot_ps(_mm256_set1_ps(-0.f), _mm256_sub_ps(f, size)));
+        return _mm256_min_epi32(_mm256_cvttps_epi32(m), maxIndex);
+    }
+
+    GRAV_TARGET_AVX512 int rowAvx512(float hx, float hy, int y, int x0, int x1, std::uint32_t* row) const {
+        const Frame f = frame(hy, y);
+        const __m512 vHx = _mm512_set1_ps(hx), vHy = _mm512_set1_ps(hy);
+        const __m512 vDy = _mm512_set1_ps(f.dy), vDy2 = _mm512_set1_ps(f.dy2);
+        const __m512 vCapture = _mm512_set1_ps(f.capture), vOne = _mm512_set1_ps(1.f);
+        const __m512 vScale = _mm512_set1_ps(float(TABLE_SIZE - 1));
+        const __m512 vDist = _mm512_set1_ps(sourceDistance);
+        const __m512 vW = _mm512_set1_ps(float(width_)), vH = _mm512_set1_ps(float(height_));
+        const __m512 vInvW2 = _mm512_set1_ps(f.invW2), vInvH2 = _mm512_set1_ps(f.invH2);
+        const __m512i vMaxX = _mm512_set1_epi32(width_ - 1), vMaxY = _mm512_set1_epi32(height_ - 1);
+        const __m512i vLastEntry = _mm512_set1_epi32(TABLE_SIZE - 2), vRow = _mm512_set1_epi32(width_);
+        const __m512i vBlack = _mm512_set1_epi32(int(black_));
+        const __m512 lane = _mm512_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f,
+                                           8.5f, 9.5f, 10.5f, 11.5f, 12.5f, 13.5f, 14.5f, 15.5f);
+
+        int x = x0;
+        for (; x + 16 <= x1; x += 16) {
+            const __m512 dx = _mm512_sub_ps(_mm512_add_ps(_mm512_set1_ps(float(x)), lane), vHx);
+            const __m512 b = _mm512_sqrt_ps(_mm512_fmadd_ps(dx, dx, vDy2));
+            const __m512 inv = _mm512_div_ps(vOne, b);
+            const __m512 c = _mm512_mul_ps(vCapture, inv);
+            const __mmask16 open = _mm512_cmp_ps_mask(c, vOne, _CMP_LT_OQ);
+            if (open == 0) {
+                _mm512_storeu_si512(row + x, vBlack);
+                continue;
+            }
+            const __m512 t = _mm512_maskz_mov_ps(open, _mm512_mul_ps(c, vScale));
+            const __m512i i = _mm512_min_epi32(_mm512_cvttps_epi32(t), vLastEntry);
+            const __m512 a0 = _mm512_i32gather_ps(i, table_.data(), 4);
+            const __m512 a1 = _mm512_i32gather_ps(i, table_.data() + 1, 4);
+            const __m512 alpha = _mm512_fmadd_ps(_mm512_sub_ps(t, _mm512_cvtepi32_ps(i)), _mm512_sub_ps(a1, a0), a0);
+            const __m512 scale = _mm512_fnmadd_ps(_mm512_mul_ps(vDist, alpha), inv, vOne);
+            const __m512i sx = mirror16(_mm512_fmadd_ps(dx, scale, vHx), vW, vInvW2, vMaxX);
+            const __m512i sy = mirror16(_mm512_fmadd_ps(vDy, scale, vHy), vH, vInvH2, vMaxY);
+            const __m512i index = _mm512_add_epi32(_mm512_mullo_epi32(sy, vRow), sx);
+            const __m512i pixel = _mm512_mask_i32gather_epi32(vBlack, open, index, background_.data(), 4);
+            _mm512_storeu_si512(row + x, pixel);
+        }
+        return x;
+    }
+
+    GRAV_TARGET_AVX512 static __m512i mirror16(__m512 v, __m512 size, __m512 invTwice, __m512i maxIndex) {
+        const __m512 twice = _mm512_add_ps(size, size);
+        const __m512 f = _mm512_fnmadd_ps(_mm512_roundscale_ps(_mm512_mul_ps(v, invTwice), _MM_FROUND_TO_NEG_INF), twice, v);
+        const __m512 m = _mm512_sub_ps(size, _mm512_abs_ps(_mm512_sub_ps(f, size)));
+        return _mm512_min_epi32(_mm512_cvttps_epi32(m), maxIndex);
+    }
+#endif
+};
+
+} // namespace grav
@@ -0,0 +1,187 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "barnes_hut.hpp"
+#include "bodies.hpp"
+#include "direct_sum.hpp"
+#include "fmm.hpp"
+#include "integrators.hpp"
+#include "snapshot.hpp"
+
+namespace grav {
+
+// Where the accelerations come from: exact pairwise sums, O(N^2); a
+// Barnes-Hut tree, O(N log N); or the fast multipole method, O(N).
+enum class ForceBackend { Direct, BarnesHut, Fmm };
+
+inline const char* forceBackendName(ForceBackend f) {
+    switch (f) {
+        case ForceBackend::Direct: return "direct";
+        case ForceBackend::BarnesHut: return "barnes-hut";
+        case ForceBackend::Fmm: return "fmm";
+    }
+    return "?";
+}
+
+// Accepts the names printed by forceBackendName; false for anything else.
+inline bool parseForceBackend(const std::string& name, ForceBackend& out) {
+    for (ForceBackend f : {ForceBackend::Direct, ForceBackend::BarnesHut, ForceBackend::Fmm}) {
+        if (name == forceBackendName(f)) {
+            out = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Self-gravitating system. Forces come from a Barnes-Hut tree by default, or
+// from the backend picked in `forces`; tree.softening applies to all of them.
+// The integrator can be switched between steps; the default is kick-drift-kick
+// leapfrog.
+template <typename T, int D>
+class NBodySystem {
+public:
+    Bodies<T, D> bodies;
+    BarnesHut<T, D> tree;
+    DirectSum<T, D> direct;
+    Fmm<T, D> fmm;
+    ForceBackend forces = ForceBackend::BarnesHut;
+    T G = T(1);
+    double time = 0.0;
+    std::uint64_t steps = 0;
+
+    Integrator integrator = Integrator::Leapfrog;
+    DormandPrince<T, D> rk45;
+    BlockHermite<T, D> hermite;         // uses direct summation, not the tree
+    std::uint64_t forceEvaluations = 0; // body accelerations computed so far
+
+    // Call once after all bodies are added (and after editing state by hand).
+    void init() {
+        computeAccelerations(bodies);
+        forceEvaluations += bodies.size();
+        rk45.reset();
+        hermite.reset();
+    }
+
+    void step(T dt) {
+        // Integrators keep history of their own; start it afresh after a switch.
+        if (integrator != last_) {
+            if (last_ == Integrator::Hermite4) init();
+            rk45.reset();
+            hermite.reset();
+            last_ = integrator;
+        }
+        auto force = [this](Bodies<T, D>& b) { computeAccelerations(b); };
+        switch (integrator) {
+            case Integrator::Leapfrog:
+                leapfrogStep(bodies, dt, force);
+                forceEvaluations += bodies.size();
+                break;
+            case Integrator::Yoshida4:
+                yoshida4Step(bodies, dt, force);
+                forceEvaluations += 3 * bodies.size();
+                break;
+            case Integrator::RK45:
+                forceEvaluations += rk45.advance(bodies, dt, force);
+                break;
+            case Integrator::Hermite4:
+                hermite.softening = tree.softening;
+                forceEvaluations += hermite.advance(bodies, G, dt);
+                break;
+        }
+        time += double(dt);
+        ++steps;
+    }
+
+    // Writes positions, velocities, accelerations and masses, with the step
+    // count, time and integrator, as a snapshot (see snapshot.hpp).
+    bool save(const std::string& path, const std::string& units) const {
+        SnapshotWriter out;
+        out.info.count = bodies.size();
+        out.info.step = steps;
+        out.info.time = time;
+        out.info.integrator = std::uint32_t(integrator);
+        out.info.dims = D;
+        out.info.units = units;
+        for (int k = 0; k < D; ++k) {
+            out.column("pos" + std::to_string(k), bodies.pos[k]);
+            out.column("vel" + std::to_string(k), bodies.vel[k]);
+            out.column("acc" + std::to_string(k), bodies.acc[k]);
+        }
+        out.column("mass", bodies.mass);
+        out.column("forceEvaluations", &forceEvaluations, 1);
+        return out.write(path);
+    }
+
+    // Continues from a snapshot written by save(): the state is restored bit
+    // for bit, so a fixed-step integrator carries on exactly as if never
+    // stopped; RK45 and Hermite start their step history afresh. False, with
+    // the system untouched, if the file does not hold a system of this kind.
+    bool restore(const std::string& path) {
+        SnapshotFile in(path);
+        if (!in.isOpen() || in.info().dims != D) return false;
+        Bodies<T, D> b;
+        bool ok = in.read("mass", b.mass);
+        for (int k = 0; k < D && ok; ++k) {
+            ok = in.read("pos" + std::to_string(k), b.pos[k]) && in.read("vel" + std::to_string(k), b.vel[k]) &&
+                 in.read("acc" + std::to_string(k), b.acc[k]) && b.pos[k].size() == b.size() &&
+                 b.vel[k].size() == b.size() && b.acc[k].size() == b.size();
+        }
+        if (!ok || b.size() != in.info().count || in.info().integrator > std::uint32_t(Integrator::Hermite4))
+            return false;
+        bodies = std::move(b);
+        steps = in.info().step;
+        if (const std::uint64_t* evaluations = in.column<std::uint64_t>("forceEvaluations"))
+            forceEvaluations = *evaluations;
+        time = in.info().time;
+        integrator = last_ = Integrator(in.info().integrator);
+        rk45.reset();
+        hermite.reset();
+        return true;
+    }
+
+    // Shift positions and velocities so the centre of mass sits at rest at the origin.
+    void moveToCenterOfMass() {
+        const std::size_t n = bodies.size();
+        T total = T(0);
+        for (std::size_t i = 0; i < n; ++i) total += bodies.mass[i];
+        if (total <= T(0)) return;
+        for (int k = 0; k < D; ++k) {
+            T p = T(0), v = T(0);
+            for (std::size_t i = 0; i < n; ++i) {
+                p += bodies.mass[i] * bodies.pos[k][i];
+                v += bodies.mass[i] * bodies.vel[k][i];
+            }
+            p /= total;
+            v /= total;
+            for (std::size_t i = 0; i < n; ++i) {
+                bodies.pos[k][i] -= p;
+                bodies.vel[k][i] -= v;
+            }
+        }
+    }
+
+    // Overwrites b.acc using the selected backend.
+    void computeAccelerations(Bodies<T, D>& b) {
+        switch (forces) {
+            case ForceBackend::Direct:
+                direct.softening = tree.softening;
+                direct.computeAccelerations(b, G);
+                break;
+            case ForceBackend::BarnesHut:
+                tree.computeAccelerations(b, G);
+                break;
+            case ForceBackend::Fmm:
+                fmm.softening = tree.softening;
+                fmm.computeAccelerations(b, G);
+                break;
+        }
+    }
+
+private:
+    Integrator last_ = Integrator::Leapfrog;
+};
+
+} // namespace grav
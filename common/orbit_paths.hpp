@@ -0,0 +1,191 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "circle_batch.hpp"
+#include "kepler.hpp"
+
+namespace grav {
+
+// Orbit outlines (ellipses around a focus, circles as the e = 0 case) built
+// once into a static vertex buffer and drawn through a transform, so panning,
+// zooming and moving parents cost no geometry work and no allocation.
+//
+// Orbits belong to groups that share a centre, such as every moon of one
+// planet; each group is one contiguous run of the buffer and one draw call,
+// moved by setCentre(). Thousands of orbits around the same body are
+// therefore a single draw.
+//
+// Segment counts follow the on-screen size with CircleBatch's quarter-pixel
+// rule, for the zoom at the top of the current power-of-two band: the buffer
+// is only re-tessellated when the zoom leaves that band. Precessing orbits
+// turn their periapsis at a fixed rate; setTime() rewrites just those orbits'
+// vertices, in place, once they have turned far enough to be a quarter pixel
+// off. Falls back to drawing from memory where vertex buffers are missing.
+class OrbitPaths {
+public:
+    static constexpr unsigned MAX_SEGMENTS = 4096;
+
+    OrbitPaths() : buffer_(sf::Lines, sf::VertexBuffer::Static) {}
+
+    std::size_t size() const { return orbits_.size(); }
+    std::size_t groupCount() const { return groups_.size(); }
+
+    // A new group centred on `centre`, in the coordinates draw() is given.
+    std::size_t addGroup(const sf::Vector2f& centre = sf::Vector2f()) {
+        groups_.push_back({centre, 0.f, 0, 0});
+        return groups_.size() - 1;
+    }
+
+    void setCentre(std::size_t group, const sf::Vector2f& centre) { groups_[group].centre = centre; }
+
+    // Ellipse with a focus on the group's centre: P points to periapsis with
+    // the length of the semi-major axis, Q along the motion at periapsis with
+    // the length of the semi-minor axis (KeplerOrbits' px, py, qx, qy).
+    // precession is the periapsis' turn rate, in radians per unit of the time
+    // given to setTime().
+    std::size_t add(std::size_t group, const sf::Vector2f& p, const sf::Vector2f& q, float e, const sf::Color& color,
+                    float precession = 0.f) {
+        orbits_.push_back({std::uint32_t(group), p, q, e, color, precession, 0.f, 0, 0});
+        Group& g = groups_[group];
+        g.extent = std::max(g.extent, std::hypot(p.x, p.y) * (1.f + e));
+        dirty_ = true;
+        return orbits_.size() - 1;
+    }
+
+    // Orbit i of a KeplerOrbits set, as seen from above, precessing with it
+    // when setTime() is given the time its propagate() was.
+    std::size_t add(std::size_t group, const KeplerOrbits& orbits, std::size_t i, const sf::Color& color) {
+        return add(group, sf::Vector2f(orbits.px[i], orbits.py[i]), sf::Vector2f(orbits.qx[i], orbits.qy[i]),
+                   orbits.e[i], color, orbits.precession[i]);
+    }
+
+    std::size_t addCircle(std::size_t group, float r, const sf::Color& color) {
+        return add(group, sf::Vector2f(r, 0.f), sf::Vector2f(0.f, r), 0.f, color);
+    }
+
+    // Turns the precessing orbits to time t.
+    void setTime(double t) {
+        time_ = t;
+        if (dirty_) return;     // the next draw() tessellates at this time anyway
+        for (Orbit& o : orbits_) {
+            if (o.precession == 0.f) continue;
+            const float angle = float(std::remainder(double(o.precession) * t, 6.283185307179586));
+            const float drift = std::fabs(std::remainder(angle - o.angle, 6.2831853f));
+            if (drift * std::hypot(o.p.x, o.p.y) * (1.f + o.e) * tessellatedZoom_ < 0.25f) continue;
+            o.angle = angle;
+            trace(o, &vertices_[o.first]);
+            if (useBuffer()) buffer_.update(&vertices_[o.first], o.count, unsigned(o.first));
+        }
+    }
+
+    // Draws every group that can show in `target` with view transform
+    // screen = world * zoom + pan. Groups under two pixels across are skipped.
+    void draw(sf::RenderTarget& target, float zoom = 1.f, const sf::Vector2f& pan = sf::Vector2f(),
+              const sf::RenderStates& states = sf::RenderStates::Default) {
+        if (orbits_.empty()) return;
+        const float band = std::exp2(std::ceil(std::log2(zoom)));
+        if (dirty_ || band != tessellatedZoom_) tessellate(band);
+
+        const sf::Vector2f size(target.getSize());
+        for (const Group& g : groups_) {
+            const float extent = g.extent * zoom;
+            const sf::Vector2f c = g.centre * zoom + pan;
+            if (g.count == 0 || extent < 1.f || c.x + extent < 0.f || c.y + extent < 0.f || c.x - extent > size.x ||
+                c.y - extent > size.y)
+                continue;
+            sf::RenderStates s = states;
+            s.transform.translate(pan).scale(zoom, zoom).translate(g.centre);
+            if (useBuffer()) target.draw(buffer_, g.first, g.count, s);
+            else target.draw(&vertices_[g.first], g.count, sf::Lines, s);
+        }
+    }
+
+private:
+    struct Group {
+        sf::Vector2f centre;
+        float extent;                   // farthest any orbit reaches from the centre
+        std::size_t first, count;       // its vertices
+    };
+
+    struct Orbit {
+        std::uint32_t group;
+        sf::Vector2f p, q;
+        float e;
+        sf::Color color;
+        float precession;
+        float angle;                    // periapsis turn the vertices were traced with
+        std::size_t first, count;
+    };
+
+    std::vector<Group> groups_;
+    std::vector<Orbit> orbits_;
+    std::vector<sf::Vertex> vertices_;  // what the buffer holds, kept for in-place updates
+    sf::VertexBuffer buffer_;
+    float tessellatedZoom_ = 0.f;
+    double time_ = 0.0;
+    bool dirty_ = true;
+
+    static bool useBuffer() { return sf::VertexBuffer::isAvailable(); }
+
+    // Segments for an orbit at the given zoom: sampled evenly in eccentric
+    // anomaly, an ellipse's largest chord error is a dE^2 / 8, at both ends of
+    // the major axis, the same as for a circle of radius a.
+    static unsigned segmentsFor(const Orbit& o, float zoom) {
+        return CircleBatch::segmentsFor(std::hypot(o.p.x, o.p.y) * zoom, MAX_SEGMENTS);
+    }
+
+    // Lays the orbits out group by group, traced for `zoom`, and uploads them.
+    void tessellate(float zoom) {
+        std::size_t total = 0;
+        for (Group& g : groups_) g.count = 0;
+        for (Orbit& o : orbits_) {
+            o.count = 2 * segmentsFor(o, zoom);
+            groups_[o.group].count += o.count;
+        }
+        for (Group& g : groups_) {
+            g.first = total;
+            total += g.count;
+        }
+        vertices_.resize(total);
+        std::vector<std::size_t> next(groups_.size());
+        for (std::size_t k = 0; k < groups_.size(); ++k) next[k] = groups_[k].first;
+        for (Orbit& o : orbits_) {
+            o.first = next[o.group];
+            next[o.group] += o.count;
+            o.angle = float(std::remainder(double(o.precession) * time_, 6.283185307179586));
+            trace(o, &vertices_[o.first]);
+        }
+        if (useBuffer()) {
+            if (buffer_.getVertexCount() < total) buffer_.create(total);
+            buffer_.update(vertices_.data(), total, 0);
+        }
+        tessellatedZoom_ = zoom;
+        dirty_ = false;
+    }
+
+    // The orbit's segments as line pairs, periapsis turned by o.angle.
+    static void trace(const Orbit& o, sf::Vertex* out) {
+        const unsigned n = unsigned(o.count / 2);
+        const float c = std::cos(o.angle), s = std::sin(o.angle);
+        const sf::Vector2f p(c * o.p.x - s * o.p.y, s * o.p.x + c * o.p.y);
+        const sf::Vector2f q(c * o.q.x - s * o.q.y, s * o.q.x + c * o.q.y);
+        auto point = [&](unsigned k) {
+            const float E = 6.2831853f * float(k % n) / float(n);
+            return (std::cos(E) - o.e) * p + std::sin(E) * q;
+        };
+        sf::Vector2f prev = point(0);
+        for (unsigned k = 1; k <= n; ++k) {
+            const sf::Vector2f next = point(k);
+            *out++ = sf::Vertex(prev, o.color);
+            *out++ = sf::Vertex(next, o.color);
+            prev = next;
+        }
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "profiler.hpp"
+#include "triple_buffer.hpp"
+
+namespace grav {
+
+// A published simulation state, stamped with simulation and wall-clock time.
+template <typename State>
+struct Frame {
+    State state{};
+    double simTime = 0.0;
+    double wallTime = 0.0;
+    std::uint64_t steps = 0;
+};
+
+inline double wallSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Steps a simulation at a fixed dt on its own thread, independent of the
+// render loop. Snapshots go to the renderer through a lock-free triple buffer
+// that also keeps the previous snapshot, so the renderer can interpolate.
+//
+//   step(dt)         advances the simulation owned by the physics thread
+//   publish(state)   copies what the renderer needs into a snapshot slot
+template <typename State>
+class PhysicsThread {
+public:
+    using StepFn = std::function<void(double)>;
+    using PublishFn = std::function<void(State&)>;
+
+    PhysicsThread(double dt, StepFn step, PublishFn publish)
+        : dt_(dt), step_(std::move(step)), publish_(std::move(publish)) {}
+
+    ~PhysicsThread() { stop(); }
+
+    PhysicsThread(const PhysicsThread&) = delete;
+    PhysicsThread& operator=(const PhysicsThread&) = delete;
+
+    double dt() const { return dt_; }
+
+    // Steps per wall-clock second; 0 runs as fast as the CPU allows.
+    void setRate(double stepsPerSecond) { rate_.store(std::max(0.0, stepsPerSecond)); }
+    double rate() const { return rate_.load(); }
+
+    // Minimum wall time between two snapshots; large states publish less often.
+    void setPublishInterval(double seconds) { publishInterval_.store(seconds); }
+
+    // Call from the render thread; the thread that polls must be the one that starts.
+    void start() {
+        if (thread_.joinable()) return;
+        running_.store(true);
+        // Seed both reader slots so previous() is valid from the first frame.
+        publishNow();
+        buffer_.update();
+        publishNow();
+        buffer_.update();
+        thread_ = std::thread([this] { loop(); });
+    }
+
+    void stop() {
+        running_.store(false);
+        if (thread_.joinable()) thread_.join();
+    }
+
+    // Render side: pick up the newest snapshot, if there is one.
+    bool poll() { return buffer_.update(); }
+
+    const Frame<State>& current() const { return buffer_.read(0); }
+    const Frame<State>& previous() const { return buffer_.read(1); }
+
+    // Blend weight between previous() and current() for a frame drawn now.
+    // The renderer runs one publish interval behind so it always has two
+    // snapshots to blend between.
+    double alpha() const {
+        const double span = current().wallTime - previous().wallTime;
+        if (span <= 0.0) return 1.0;
+        return std::clamp((wallSeconds() - current().wallTime) / span, 0.0, 1.0);
+    }
+
+    std::uint64_t steps() const { return steps_.load(std::memory_order_relaxed); }
+
+private:
+    double dt_;
+    StepFn step_;
+    PublishFn publish_;
+    TripleBuffer<Frame<State>, 2> buffer_;
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<double> rate_{0.0};
+    std::atomic<double> publishInterval_{1.0 / 240.0};
+    std::atomic<std::uint64_t> steps_{0};
+    double simTime_ = 0.0;
+
+    void publishNow() {
+        GRAV_PROFILE_ZONE("publish");
+        Frame<State>& f = buffer_.write();
+        publish_(f.state);
+        f.simTime = simTime_;
+        f.wallTime = wallSeconds();
+        f.steps = steps_.load(std::memory_order_relaxed);
+        buffer_.publish();
+    }
+
+    void loop() {
+        Profiler::instance().nameThread("physics");
+        double rate = rate_.load();
+        double baseWall = wallSeconds();
+        std::uint64_t baseSteps = 0, done = 0;
+        double lastPublish = baseWall;
+
+        while (running_.load(std::memory_order_relaxed)) {
+            const double now = wallSeconds();
+            const double newRate = rate_.load(std::memory_order_relaxed);
+            if (newRate != rate) {
+                rate = newRate;
+                baseWall = now;
+                baseSteps = done;
+            }
+
+            // Steps owed at the target rate; run them in a batch, then sleep.
+            std::uint64_t due = done + 1;
+            if (rate > 0.0) {
+                due = baseSteps + std::uint64_t((now - baseWall) * rate);
+                // More than a quarter second behind: drop the backlog rather than spiral.
+                if (double(due - std::min(due, done)) > rate * 0.25) {
+                    baseWall = now;
+                    baseSteps = done;
+                    due = done + 1;
+                }
+            }
+
+            while (done < due && running_.load(std::memory_order_relaxed)) {
+                {
+                    GRAV_PROFILE_ZONE("step");
+                    step_(dt_);
+                }
+                simTime_ += dt_;
+                ++done;
+                steps_.store(done, std::memory_order_relaxed);
+                if (wallSeconds() - lastPublish >= publishInterval_.load(std::memory_order_relaxed)) break;
+            }
+
+            const double after = wallSeconds();
+            if (after - lastPublish >= publishInterval_.load(std::memory_order_relaxed)) {
+                publishNow();
+                lastPublish = after;
+            }
+
+            if (rate > 0.0 && done >= due) {
+                const double next = baseWall + double(done + 1 - baseSteps) / rate;
+                const double wait = std::min(next - after, 0.001);
+                if (wait > 0.0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            }
+        }
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,269 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace grav {
+
+// Scoped timing zones for finding where a frame's time goes.
+//
+//   GRAV_PROFILE_ZONE("physics");   // times the rest of the enclosing scope
+//
+// Each thread records its zones into its own ring of RING_SIZE entries: a
+// zone costs two clock reads and a few relaxed stores, with no lock and no
+// allocation after the thread's first zone. Readers (the overlay, the trace
+// export) walk the rings from another thread. Every slot carries a sequence
+// number, odd while its owner writes it and naming the zone once written, so a
+// reader keeps an entry only if the number was the expected one before and
+// after copying it; entries being overwritten or already replaced are dropped.
+// Rings keep the most recent zones only, so a trace covers the last RING_SIZE
+// zones of every thread.
+//
+// Nothing is recorded until the profiler is enabled. Defining
+// GRAV_NO_PROFILE compiles the zones out altogether.
+struct ProfileEvent {
+    const char* name;           // a string literal, never freed
+    std::int64_t start, end;    // nanoseconds since the profiler was created
+};
+
+class Profiler {
+public:
+    static constexpr std::size_t RING_SIZE = std::size_t(1) << 17;
+
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    void setEnabled(bool on) { enabled_.store(on, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    std::int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count();
+    }
+
+    // Appends a finished zone to the calling thread's ring.
+    void record(const char* name, std::int64_t start, std::int64_t end) {
+        Ring& ring = local();
+        const std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+        Slot& slot = ring.slots[head & (RING_SIZE - 1)];
+        slot.seq.store(2 * head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.seq.store(2 * head + 2, std::memory_order_release);
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    // Label for the calling thread in traces and the overlay. Cheap to call
+    // while disabled: the thread's ring is only allocated by its first zone.
+    void nameThread(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pendingName() = name;
+        if (Ring* ring = currentRing()) ring->name = name;
+    }
+
+    std::size_t threadCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return rings_.size();
+    }
+
+    std::string threadName(std::size_t thread) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return thread < rings_.size() ? rings_[thread]->name : std::string();
+    }
+
+    // Calls fn(event) for the zones thread `thread` recorded from sequence
+    // number `from` on, and returns the sequence number to continue from.
+    // Zones overwritten before or while being read are skipped.
+    template <typename Fn>
+    std::uint64_t read(std::size_t thread, std::uint64_t from, Fn&& fn) const {
+        const Ring* ring;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (thread >= rings_.size()) return from;
+            ring = rings_[thread].get();
+        }
+        const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (std::uint64_t i = std::max(from, head > RING_SIZE ? head - RING_SIZE : 0); i < head; ++i) {
+            const Slot& slot = ring->slots[i & (RING_SIZE - 1)];
+            const std::uint64_t written = 2 * i + 2;    // the slot's sequence number once zone i is in it
+            if (slot.seq.load(std::memory_order_acquire) != written) continue;
+            const ProfileEvent e{slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+                                 slot.end.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != written) continue;  // rewritten while copying
+            fn(e);
+        }
+        return head;
+    }
+
+    // Every zone still in the rings as Chrome trace JSON, for chrome://tracing
+    // or ui.perfetto.dev.
+    void writeChromeTrace(std::ostream& os) const {
+        os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool first = true;
+        char line[256];
+        const std::size_t threads = threadCount();
+        for (std::size_t t = 0; t < threads; ++t) {
+            std::string name = threadName(t);
+            if (name.empty()) name = "thread " + std::to_string(t);
+            std::snprintf(line, sizeof(line),
+                          "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"name\": \"%s\"}}",
+                          t, name.c_str());
+            os << (first ? "" : ",\n") << line;
+            first = false;
+            read(t, 0, [&](const ProfileEvent& e) {
+                std::snprintf(line, sizeof(line),
+                              "{\"name\": \"%s\", \"cat\": \"grav\", \"ph\": \"X\", \"pid\": 1, \"tid\": %zu, "
+                              "\"ts\": %.3f, \"dur\": %.3f}",
+                              e.name, t, double(e.start) * 1e-3, double(e.end - e.start) * 1e-3);
+                os << ",\n" << line;
+            });
+        }
+        os << "\n]}\n";
+    }
+
+private:
+    struct Slot {
+        std::atomic<std::uint64_t> seq{0};      // 2i + 1 while zone i is written, 2i + 2 after
+        std::atomic<const char*> name{nullptr};
+        std::atomic<std::int64_t> start{0}, end{0};
+    };
+
+    struct Ring {
+        std::string name;
+        std::unique_ptr<Slot[]> slots{new Slot[RING_SIZE]};
+        std::atomic<std::uint64_t> head{0};
+    };
+
+    std::chrono::steady_clock::time_point epoch_ = std::chrono::steady_clock::now();
+    std::atomic<bool> enabled_{false};
+    mutable std::mutex mutex_;                  // guards the ring list, not the rings
+    std::vector<std::unique_ptr<Ring>> rings_;  // never shrinks, so rings outlive their threads
+
+    Profiler() = default;
+
+    static Ring*& currentRing() {
+        thread_local Ring* ring = nullptr;
+        return ring;
+    }
+
+    static std::string& pendingName() {
+        thread_local std::string name;
+        return name;
+    }
+
+    Ring& local() {
+        Ring*& ring = currentRing();
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rings_.push_back(std::make_unique<Ring>());
+            ring = rings_.back().get();
+            ring->name = pendingName();
+        }
+        return *ring;
+    }
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name)
+        : name_(Profiler::instance().enabled() ? name : nullptr), start_(name_ ? Profiler::instance().now() : 0) {}
+    ~ProfileZone() {
+        if (name_) Profiler::instance().record(name_, start_, Profiler::instance().now());
+    }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name_;
+    std::int64_t start_;
+};
+
+// Back-to-back zones through a straight stretch of code, such as the phases
+// of a frame, without a scope for each:
+//
+//   ProfilePhases phase("events");
+//   ...
+//   phase.next("scene");    // ends "events"
+//   ...                     // "scene" ends with phase
+class ProfilePhases {
+public:
+    explicit ProfilePhases(const char* name) { next(name); }
+    ~ProfilePhases() { next(nullptr); }
+    ProfilePhases(const ProfilePhases&) = delete;
+    ProfilePhases& operator=(const ProfilePhases&) = delete;
+
+    void next(const char* name) {
+#ifdef GRAV_NO_PROFILE
+        (void)name;
+        return;
+#endif
+        Profiler& p = Profiler::instance();
+        const std::int64_t t = name_ || p.enabled() ? p.now() : 0;
+        if (name_) p.record(name_, start_, t);
+        name_ = p.enabled() ? name : nullptr;
+        start_ = t;
+    }
+
+private:
+    const char* name_ = nullptr;
+    std::int64_t start_ = 0;
+};
+
+#define GRAV_PROFILE_JOIN2(a, b) a##b
+#define GRAV_PROFILE_JOIN(a, b) GRAV_PROFILE_JOIN2(a, b)
+#ifdef GRAV_NO_PROFILE
+#define GRAV_PROFILE_ZONE(name) ((void)0)
+#else
+#define GRAV_PROFILE_ZONE(name) ::grav::ProfileZone GRAV_PROFILE_JOIN(profileZone_, __LINE__)(name)
+#endif
+
+// Command-line switches for profiling:
+//   --profile        record zones and show the timing overlay (F3 toggles it)
+//   --trace PATH     record zones and write them as a Chrome trace on exit
+struct ProfileOptions {
+    bool overlay = false;
+    std::string tracePath;
+
+    // Turns recording on if asked for and labels the calling thread.
+    void apply(const char* threadName = "render") const {
+        Profiler::instance().setEnabled(overlay || !tracePath.empty());
+        Profiler::instance().nameThread(threadName);
+    }
+
+    // Writes the trace if one was asked for; false if it could not be written.
+    bool writeTrace(std::ostream& log) const {
+        if (tracePath.empty()) return true;
+        std::ofstream out(tracePath);
+        Profiler::instance().writeChromeTrace(out);
+        if (!out) {
+            log << "Cannot write trace " << tracePath << "\n";
+            return false;
+        }
+        log << "trace written to " << tracePath << "\n";
+        return true;
+    }
+};
+
+inline ProfileOptions parseProfile(int argc, char** argv) {
+    ProfileOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--profile") opt.overlay = true;
+        else if (arg == "--trace" && i + 1 < argc) opt.tracePath = argv[++i];
+    }
+    return opt;
+}
+
+} // namespace grav
@@ -0,0 +1,146 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "asset_cache.hpp"
+#include "profiler.hpp"
+
+namespace grav {
+
+// Timing table drawn over the top right of the scene: for every thread and
+// zone, milliseconds per frame (mean and worst over the last half second) and
+// calls per frame.
+// Zones of other threads are charged to the frame during which they ended, so
+// the physics row is the stepping done while one frame was drawn.
+//
+// Times are CPU times. Draw calls only queue work for the GPU, which is paid
+// for wherever the driver next waits, usually in display().
+class ProfilerOverlay {
+public:
+    bool visible = false;
+
+    explicit ProfilerOverlay(bool show = false,
+                             const std::string& fontPath = "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf")
+        : visible(show), font_(AssetCache::instance().font(fontPath)) {}
+
+    // F3 shows and hides the table, and starts recording if nothing else has.
+    void handle(const sf::Event& event) {
+        if (event.type != sf::Event::KeyPressed || event.key.code != sf::Keyboard::F3) return;
+        visible = !visible;
+        if (visible) {
+            Profiler::instance().setEnabled(true);
+            skipToNow();
+        }
+    }
+
+    // Collects the zones recorded since the last frame and draws the table in
+    // screen coordinates. Call once per frame, just before display().
+    void draw(sf::RenderTarget& target) {
+        if (!visible) return;
+        GRAV_PROFILE_ZONE("overlay");
+        collect();
+        if (!font_ || text_.empty()) return;
+
+        // Top right, clear of the programs' own text in the top left corner
+        sf::Text label(text_, *font_, 12);
+        label.setFillColor(sf::Color(220, 255, 220));
+        const sf::FloatRect bounds = label.getLocalBounds();
+        const float left = float(target.getSize().x) - bounds.width - 14.f;
+        label.setPosition(left, 8.f);
+        sf::RectangleShape panel(sf::Vector2f(bounds.width + 12.f, bounds.height + bounds.top + 12.f));
+        panel.setPosition(left - 6.f, 4.f);
+        panel.setFillColor(sf::Color(0, 0, 0, 170));
+
+        const sf::View view = target.getView();
+        target.setView(target.getDefaultView());
+        target.draw(panel);
+        target.draw(label);
+        target.setView(view);
+    }
+
+private:
+    struct Zone {
+        std::size_t thread;
+        const char* name;
+        double frame = 0.0, total = 0.0, worst = 0.0;  // milliseconds
+        std::uint64_t calls = 0;
+    };
+
+    const sf::Font* font_;
+    std::vector<std::uint64_t> cursors_;
+    std::vector<Zone> zones_;
+    std::int64_t windowStart_ = -1, lastFrame_ = -1;
+    double worstFrame_ = 0.0;
+    std::uint64_t frames_ = 0;
+    std::string text_;
+
+    void skipToNow() {
+        Profiler& p = Profiler::instance();
+        cursors_.resize(p.threadCount());
+        for (std::size_t t = 0; t < cursors_.size(); ++t) cursors_[t] = p.read(t, UINT64_MAX, [](const ProfileEvent&) {});
+        zones_.clear();
+        frames_ = 0;
+        windowStart_ = lastFrame_ = -1;
+    }
+
+    Zone& zone(std::size_t thread, const char* name) {
+        for (Zone& z : zones_)
+            if (z.thread == thread && std::strcmp(z.name, name) == 0) return z;
+        zones_.push_back({thread, name});
+        return zones_.back();
+    }
+
+    void collect() {
+        Profiler& p = Profiler::instance();
+        cursors_.resize(p.threadCount(), 0);
+        for (std::size_t t = 0; t < cursors_.size(); ++t) {
+            cursors_[t] = p.read(t, cursors_[t], [&](const ProfileEvent& e) {
+                Zone& z = zone(t, e.name);
+                z.frame += double(e.end - e.start) * 1e-6;
+                ++z.calls;
+            });
+        }
+        for (Zone& z : zones_) {
+            z.total += z.frame;
+            z.worst = std::max(z.worst, z.frame);
+            z.frame = 0.0;
+        }
+
+        const std::int64_t now = p.now();
+        if (lastFrame_ >= 0) worstFrame_ = std::max(worstFrame_, double(now - lastFrame_) * 1e-6);
+        lastFrame_ = now;
+        if (windowStart_ < 0) windowStart_ = now;
+        ++frames_;
+        if (now - windowStart_ < 500000000 || frames_ < 2) return;
+
+        // Publish the half second just finished, then start the next one.
+        const double frames = double(frames_);
+        const double frameMs = double(now - windowStart_) * 1e-6 / frames;
+        std::sort(zones_.begin(), zones_.end(), [](const Zone& a, const Zone& b) {
+            return a.thread != b.thread ? a.thread < b.thread : a.total > b.total;
+        });
+        char line[128];
+        std::snprintf(line, sizeof(line), "frame %6.2f ms  worst %6.2f  %5.1f fps\n", frameMs, worstFrame_,
+                      1000.0 / frameMs);
+        text_ = line;
+        text_ += "zone                 mean    worst  calls\n";
+        for (const Zone& z : zones_) {
+            std::string name = p.threadName(z.thread);
+            name = (name.empty() ? "thread " + std::to_string(z.thread) : name) + "/" + z.name;
+            std::snprintf(line, sizeof(line), "%-18.18s %7.3f  %7.3f  %5.0f\n", name.c_str(), z.total / frames, z.worst,
+                          double(z.calls) / frames);
+            text_ += line;
+        }
+        zones_.clear();
+        frames_ = 0;
+        worstFrame_ = 0.0;
+        windowStart_ = now;
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,578 @@
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bodies.hpp"
+#include "snapshot.hpp"
+
+namespace grav {
+
+// Initial conditions read from a file rather than compiled in, so another
+// setup is another --scenario argument instead of a rebuild.
+//
+// The text form is a few directives followed by one body per line:
+//
+//   # everything after a '#' is a comment
+//   scenario  Inner planets        title, free text
+//   units     length=px time=day   free text, copied into binary files
+//   bodies    3                    optional: reserves room for this many
+//   columns   name parent radius orbit period color
+//   Sun       -       30    0    0     255,255,0
+//   Venus     Sun      6   90    0.62y 255,165,0
+//   Earth     Sun      7  120  365.25  0,0,255
+//
+// The columns line lists any subset of these, in any order:
+//   name      one word, unique; other rows may name it as their parent
+//   parent    "-" for none, an earlier row's name, or its row number
+//   mass      in the mass unit of the scenario
+//   radius    drawn size
+//   orbit     drawn distance from the parent
+//   period    orbital period in days; a "y" suffix gives years
+//   angle     starting angle on the orbit, radians; for an eccentric orbit,
+//             the mean anomaly at time 0
+//   eccentricity inclination node periapsis
+//             shape and orientation of the orbit (radians): the orbit's
+//             inclination to the x-y plane, the longitude of its ascending
+//             node and the argument of periapsis
+//   precession the orbit's turn about the z axis, radians per day
+//   color     r,g,b or r,g,b,a
+//   rings     1 for a ringed body
+//   x y vx vy position and velocity, for bodies not placed on orbits
+// Columns left out keep their defaults: no parent, mass 0, radius 1, white.
+//
+// The parser streams the file through one fixed buffer and converts fields in
+// place with std::from_chars. Given a bodies line it allocates nothing per
+// body, and a million-body file loads in a fraction of a second.
+//
+// The binary form is a snapshot file (snapshot.hpp) with one column per
+// scenario column, so loading it is one copy per column. loadScenario() reads
+// either form; scenario_tool converts between them.
+struct Scenario {
+    enum Column : std::uint32_t {
+        Name, Parent, Mass, Radius, Orbit, Period, Angle, Eccentricity, Inclination, Node, Periapsis, Precession,
+        Color, Rings, X, Y, VX, VY, COLUMN_COUNT
+    };
+    static constexpr std::uint32_t NO_PARENT = 0xffffffffu;
+
+    std::string title, units;
+    std::uint32_t columns = 0;              // bit (1 << column) for each column the file gave
+
+    Bodies<double, 2> state;                // x, y, vx, vy and mass
+    std::vector<std::uint32_t> parent;      // row index, or NO_PARENT
+    std::vector<float> radius, orbit, angle;
+    std::vector<float> eccentricity, inclination, node, periapsis, precession;
+    std::vector<double> period;             // days
+    std::vector<std::uint32_t> color;       // 0xRRGGBBAA, as sf::Color(Uint32) takes it
+    std::vector<std::uint8_t> rings;
+    std::vector<char> names;                // all names back to back
+    std::vector<std::uint32_t> nameEnd;     // end of each name in names
+
+    static const char* columnName(Column c) {
+        static const char* const names[COLUMN_COUNT] = {
+            "name", "parent", "mass", "radius", "orbit", "period", "angle", "eccentricity", "inclination", "node",
+            "periapsis", "precession", "color", "rings", "x", "y", "vx", "vy"};
+        return names[c];
+    }
+
+    std::size_t size() const { return parent.size(); }
+    bool has(Column c) const { return (columns >> c) & 1u; }
+
+    std::string_view name(std::size_t i) const {
+        const std::uint32_t begin = i == 0 ? 0 : nameEnd[i - 1];
+        return std::string_view(names.data() + begin, nameEnd[i] - begin);
+    }
+
+    // The first body of that name, or NO_PARENT.
+    std::uint32_t find(std::string_view key) const {
+        for (std::size_t i = 0; i < size(); ++i)
+            if (name(i) == key) return std::uint32_t(i);
+        return NO_PARENT;
+    }
+
+    std::vector<std::uint32_t> children(std::uint32_t of) const {
+        std::vector<std::uint32_t> out;
+        for (std::size_t i = 0; i < size(); ++i)
+            if (parent[i] == of) out.push_back(std::uint32_t(i));
+        return out;
+    }
+
+    void clear() { *this = Scenario(); }
+
+    void reserve(std::size_t n) {
+        state.reserve(n);
+        parent.reserve(n);
+        radius.reserve(n);
+        orbit.reserve(n);
+        angle.reserve(n);
+        for (auto* v : {&eccentricity, &inclination, &node, &periapsis, &precession}) v->reserve(n);
+        period.reserve(n);
+        color.reserve(n);
+        rings.reserve(n);
+        nameEnd.reserve(n);
+    }
+
+    // n bodies with every column at its default.
+    void resize(std::size_t n) {
+        for (int k = 0; k < 2; ++k) {
+            state.pos[k].assign(n, 0.0);
+            state.vel[k].assign(n, 0.0);
+            state.acc[k].assign(n, 0.0);
+        }
+        state.mass.assign(n, 0.0);
+        parent.assign(n, NO_PARENT);
+        radius.assign(n, 1.f);
+        orbit.assign(n, 0.f);
+        angle.assign(n, 0.f);
+        for (auto* v : {&eccentricity, &inclination, &node, &periapsis, &precession}) v->assign(n, 0.f);
+        period.assign(n, 0.0);
+        color.assign(n, 0xffffffffu);
+        rings.assign(n, 0);
+        names.clear();
+        nameEnd.assign(n, 0);
+    }
+
+    // Appends a body with every column at its default; returns its index.
+    std::size_t add() {
+        const double zero[2] = {0.0, 0.0};
+        state.add(zero, zero, 0.0);
+        parent.push_back(NO_PARENT);
+        radius.push_back(1.f);
+        orbit.push_back(0.f);
+        angle.push_back(0.f);
+        for (auto* v : {&eccentricity, &inclination, &node, &periapsis, &precession}) v->push_back(0.f);
+        period.push_back(0.0);
+        color.push_back(0xffffffffu);
+        rings.push_back(0);
+        nameEnd.push_back(std::uint32_t(names.size()));
+        return parent.size() - 1;
+    }
+};
+
+namespace scenario_detail {
+
+constexpr std::size_t BLOCK = std::size_t(1) << 20;  // read size, and the longest line allowed
+constexpr double DAYS_PER_YEAR = 365.25;
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// The next whitespace-separated field of line, consumed from its front.
+inline bool nextField(std::string_view& line, std::string_view& field) {
+    std::size_t i = 0;
+    while (i < line.size() && isSpace(line[i])) ++i;
+    std::size_t j = i;
+    while (j < line.size() && !isSpace(line[j])) ++j;
+    field = line.substr(i, j - i);
+    line.remove_prefix(j);
+    return !field.empty();
+}
+
+template <typename T>
+bool number(std::string_view s, T& out) {
+    const auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+inline bool period(std::string_view s, double& days) {
+    double scale = 1.0;
+    if (!s.empty() && (s.back() == 'y' || s.back() == 'd')) {
+        scale = s.back() == 'y' ? DAYS_PER_YEAR : 1.0;
+        s.remove_suffix(1);
+    }
+    if (!number(s, days)) return false;
+    days *= scale;
+    return true;
+}
+
+inline bool color(std::string_view s, std::uint32_t& rgba) {
+    unsigned c[4] = {0, 0, 0, 255};
+    int n = 0;
+    for (; n < 4 && !s.empty(); ++n) {
+        const std::size_t comma = s.find(',');
+        if (!number(s.substr(0, comma), c[n]) || c[n] > 255) return false;
+        s.remove_prefix(comma == std::string_view::npos ? s.size() : comma + 1);
+    }
+    if (n < 3 || !s.empty()) return false;
+    rgba = (c[0] << 24) | (c[1] << 16) | (c[2] << 8) | c[3];
+    return true;
+}
+
+inline std::uint64_t hash(std::string_view s) {
+    std::uint64_t h = 14695981039346656037ull;  // FNV-1a
+    for (char c : s) h = (h ^ std::uint8_t(c)) * 1099511628211ull;
+    return h;
+}
+
+// Fills a Scenario from text handed over one line at a time.
+class TextParser {
+public:
+    TextParser(Scenario& out, std::string& error) : sc_(out), error_(error) {}
+
+    bool line(std::string_view text) {
+        ++lineNumber_;
+        const std::size_t comment = text.find('#');
+        if (comment != std::string_view::npos) text = text.substr(0, comment);
+        std::string_view rest = text, field;
+        if (!nextField(rest, field)) return true;
+        if (order_.empty()) return directive(field, rest);
+        return row(text);
+    }
+
+    // Checks the file ended with its body table declared.
+    bool finish() {
+        if (order_.empty()) return fail("no columns line");
+        return true;
+    }
+
+    bool fail(const std::string& message) {
+        error_ = "line " + std::to_string(lineNumber_) + ": " + message;
+        return false;
+    }
+
+private:
+    Scenario& sc_;
+    std::string& error_;
+    std::size_t lineNumber_ = 0;
+    std::vector<Scenario::Column> order_;
+    std::vector<std::uint32_t> slots_;     // open-addressing name table: row + 1, 0 when empty
+    std::size_t named_ = 0;
+
+    static std::string_view trim(std::string_view s) {
+        while (!s.empty() && isSpace(s.front())) s.remove_prefix(1);
+        while (!s.empty() && isSpace(s.back())) s.remove_suffix(1);
+        return s;
+    }
+
+    bool directive(std::string_view key, std::string_view rest) {
+        if (key == "scenario") {
+            sc_.title = std::string(trim(rest));
+        } else if (key == "units") {
+            sc_.units = std::string(trim(rest));
+        } else if (key == "bodies") {
+            std::size_t n = 0;
+            if (!number(trim(rest), n)) return fail("bodies needs a count");
+            sc_.reserve(n);
+            rehash(n);
+        } else if (key == "columns") {
+            std::string_view field;
+            while (nextField(rest, field)) {
+                std::uint32_t c = 0;
+                while (c < Scenario::COLUMN_COUNT && field != Scenario::columnName(Scenario::Column(c))) ++c;
+                if (c == Scenario::COLUMN_COUNT) return fail("unknown column " + std::string(field));
+                if (sc_.has(Scenario::Column(c))) return fail("column " + std::string(field) + " given twice");
+                sc_.columns |= 1u << c;
+                order_.push_back(Scenario::Column(c));
+            }
+            if (order_.empty()) return fail("columns line lists no columns");
+        } else {
+            return fail("unknown directive " + std::string(key));
+        }
+        return true;
+    }
+
+    bool row(std::string_view rest) {
+        const std::size_t i = sc_.add();
+        std::string_view field;
+        for (Scenario::Column c : order_) {
+            if (!nextField(rest, field))
+                return fail("expected " + std::to_string(order_.size()) + " fields");
+            if (!value(i, c, field))
+                return fail("bad " + std::string(Scenario::columnName(c)) + " '" + std::string(field) + "'");
+        }
+        if (nextField(rest, field)) return fail("expected " + std::to_string(order_.size()) + " fields");
+        return true;
+    }
+
+    bool value(std::size_t i, Scenario::Column c, std::string_view s) {
+        switch (c) {
+        case Scenario::Name:
+            if (s == "-" || lookup(s) != Scenario::NO_PARENT) return false;    // reserved, or taken
+            sc_.names.insert(sc_.names.end(), s.begin(), s.end());
+            sc_.nameEnd[i] = std::uint32_t(sc_.names.size());
+            insert(std::uint32_t(i));
+            return true;
+        case Scenario::Parent: {
+            if (s == "-") return true;
+            std::uint32_t p = lookup(s);
+            if (p == Scenario::NO_PARENT && !number(s, p)) return false;
+            sc_.parent[i] = p;
+            return p < i;                       // parents come first, which also rules out cycles
+        }
+        case Scenario::Mass: return number(s, sc_.state.mass[i]);
+        case Scenario::Radius: return number(s, sc_.radius[i]);
+        case Scenario::Orbit: return number(s, sc_.orbit[i]);
+        case Scenario::Period: return period(s, sc_.period[i]);
+        case Scenario::Angle: return number(s, sc_.angle[i]);
+        case Scenario::Eccentricity:
+            return number(s, sc_.eccentricity[i]) && sc_.eccentricity[i] >= 0.f && sc_.eccentricity[i] < 1.f;
+        case Scenario::Inclination: return number(s, sc_.inclination[i]);
+        case Scenario::Node: return number(s, sc_.node[i]);
+        case Scenario::Periapsis: return number(s, sc_.periapsis[i]);
+        case Scenario::Precession: return number(s, sc_.precession[i]);
+        case Scenario::Color: return color(s, sc_.color[i]);
+        case Scenario::Rings:
+            sc_.rings[i] = s == "1";
+            return s == "0" || s == "1";
+        case Scenario::X: return number(s, sc_.state.pos[0][i]);
+        case Scenario::Y: return number(s, sc_.state.pos[1][i]);
+        case Scenario::VX: return number(s, sc_.state.vel[0][i]);
+        case Scenario::VY: return number(s, sc_.state.vel[1][i]);
+        default: return false;
+        }
+    }
+
+    void rehash(std::size_t expected) {
+        std::size_t n = 16;
+        while (n < 2 * expected) n *= 2;
+        if (n <= slots_.size()) return;
+        slots_.assign(n, 0);
+        for (std::size_t i = 0; i < sc_.size(); ++i)
+            if (!sc_.name(i).empty()) insert(std::uint32_t(i));
+    }
+
+    void insert(std::uint32_t row) {
+        if (2 * (named_ + 1) > slots_.size()) rehash(2 * (named_ + 1));
+        const std::size_t mask = slots_.size() - 1;
+        std::size_t s = hash(sc_.name(row)) & mask;
+        while (slots_[s] != 0) s = (s + 1) & mask;
+        slots_[s] = row + 1;
+        ++named_;
+    }
+
+    std::uint32_t lookup(std::string_view key) const {
+        if (slots_.empty()) return Scenario::NO_PARENT;
+        const std::size_t mask = slots_.size() - 1;
+        for (std::size_t s = hash(key) & mask; slots_[s] != 0; s = (s + 1) & mask)
+            if (sc_.name(slots_[s] - 1) == key) return slots_[s] - 1;
+        return Scenario::NO_PARENT;
+    }
+};
+
+inline bool loadText(std::FILE* f, Scenario& sc, std::string& error) {
+    TextParser parser(sc, error);
+    std::vector<char> buffer(BLOCK);
+    std::size_t kept = 0;   // bytes of an unfinished line carried over from the last read
+    for (;;) {
+        const std::size_t got = std::fread(buffer.data() + kept, 1, buffer.size() - kept, f);
+        const std::size_t end = kept + got;
+        std::size_t start = 0;
+        const char* base = buffer.data();
+        for (const char* nl = base + kept; (nl = static_cast<const char*>(std::memchr(nl, '\n', base + end - nl)));) {
+            if (!parser.line(std::string_view(base + start, std::size_t(nl - base) - start))) return false;
+            start = std::size_t(++nl - base);
+        }
+        kept = end - start;
+        if (got == 0) {
+            if (kept > 0 && !parser.line(std::string_view(buffer.data() + start, kept))) return false;
+            break;
+        }
+        if (kept == buffer.size()) return parser.fail("line longer than " + std::to_string(BLOCK) + " bytes");
+        std::memmove(buffer.data(), buffer.data() + start, kept);
+    }
+    if (std::ferror(f)) {
+        error = "read error";
+        return false;
+    }
+    return parser.finish();
+}
+
+template <typename T>
+bool loadColumn(const SnapshotFile& file, Scenario& sc, Scenario::Column c, std::vector<T>& out, std::size_t n) {
+    std::size_t length = 0;
+    const T* p = file.column<T>(Scenario::columnName(c), &length);
+    if (!p) return true;                    // not given: keep the defaults
+    if (length != n) return false;
+    out.assign(p, p + n);
+    sc.columns |= 1u << c;
+    return true;
+}
+
+inline bool loadBinary(const SnapshotFile& file, Scenario& sc, std::string& error) {
+    std::size_t length = 0;
+    const std::uint8_t* title = file.column<std::uint8_t>("scenario", &length);
+    if (!title) {
+        error = "snapshot is not a scenario";
+        return false;
+    }
+    sc.title.assign(reinterpret_cast<const char*>(title), length);
+    sc.units = file.info().units;
+    const std::size_t n = std::size_t(file.info().count);
+    sc.resize(n);
+
+    bool ok = true;
+    if (const std::uint8_t* names = file.column<std::uint8_t>("name", &length)) {
+        sc.names.assign(names, names + length);
+        ok = file.read("name_end", sc.nameEnd) && sc.nameEnd.size() == n &&
+             (n == 0 || sc.nameEnd[n - 1] == sc.names.size());
+        sc.columns |= 1u << Scenario::Name;
+    }
+    ok = ok && loadColumn(file, sc, Scenario::Parent, sc.parent, n) && loadColumn(file, sc, Scenario::Mass, sc.state.mass, n) &&
+         loadColumn(file, sc, Scenario::Radius, sc.radius, n) && loadColumn(file, sc, Scenario::Orbit, sc.orbit, n) &&
+         loadColumn(file, sc, Scenario::Period, sc.period, n) && loadColumn(file, sc, Scenario::Angle, sc.angle, n) &&
+         loadColumn(file, sc, Scenario::Eccentricity, sc.eccentricity, n) &&
+         loadColumn(file, sc, Scenario::Inclination, sc.inclination, n) && loadColumn(file, sc, Scenario::Node, sc.node, n) &&
+         loadColumn(file, sc, Scenario::Periapsis, sc.periapsis, n) &&
+         loadColumn(file, sc, Scenario::Precession, sc.precession, n) &&
+         loadColumn(file, sc, Scenario::Color, sc.color, n) && loadColumn(file, sc, Scenario::Rings, sc.rings, n) &&
+         loadColumn(file, sc, Scenario::X, sc.state.pos[0], n) && loadColumn(file, sc, Scenario::Y, sc.state.pos[1], n) &&
+         loadColumn(file, sc, Scenario::VX, sc.state.vel[0], n) && loadColumn(file, sc, Scenario::VY, sc.state.vel[1], n);
+    for (std::size_t i = 0; ok && i < n; ++i)
+        ok = (sc.parent[i] == Scenario::NO_PARENT || sc.parent[i] < i) && (i == 0 || sc.nameEnd[i] >= sc.nameEnd[i - 1]);
+    if (!ok) {
+        error = "inconsistent scenario columns";
+        return false;
+    }
+    // The text form only accepts elliptic orbits; hold binary files to the same
+    for (std::size_t i = 0; i < n; ++i)
+        if (!(sc.eccentricity[i] >= 0.f && sc.eccentricity[i] < 1.f)) {
+            error = "body " + std::to_string(i) + ": eccentricity outside [0, 1)";
+            return false;
+        }
+    return true;
+}
+
+} // namespace scenario_detail
+
+// Reads a scenario in either form. On failure error says where and why.
+inline bool loadScenario(const std::string& path, Scenario& out, std::string& error) {
+    out.clear();
+    char magic[8] = {};
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        error = path + ": cannot open";
+        return false;
+    }
+    const bool binary = std::fread(magic, 1, 8, f) == 8 && std::memcmp(magic, "GRAVSNAP", 8) == 0;
+    bool ok;
+    if (binary) {
+        std::fclose(f);
+        SnapshotFile file;
+        ok = file.open(path);
+        if (!ok) error = "unreadable snapshot";
+        ok = ok && scenario_detail::loadBinary(file, out, error);
+    } else {
+        std::rewind(f);
+        ok = scenario_detail::loadText(f, out, error);
+        std::fclose(f);
+    }
+    if (!ok) {
+        error = path + ": " + error;
+        out.clear();
+    }
+    return ok;
+}
+
+inline bool writeScenarioBinary(const std::string& path, const Scenario& sc) {
+    SnapshotWriter w;
+    w.info.count = sc.size();
+    w.info.dims = 2;
+    w.info.units = sc.units;
+    w.column("scenario", reinterpret_cast<const std::uint8_t*>(sc.title.data()), sc.title.size());
+    if (sc.has(Scenario::Name)) {
+        w.column("name", reinterpret_cast<const std::uint8_t*>(sc.names.data()), sc.names.size());
+        w.column("name_end", sc.nameEnd);
+    }
+    auto add = [&](Scenario::Column c, const auto& values) {
+        if (sc.has(c)) w.column(Scenario::columnName(c), values);
+    };
+    add(Scenario::Parent, sc.parent);
+    add(Scenario::Mass, sc.state.mass);
+    add(Scenario::Radius, sc.radius);
+    add(Scenario::Orbit, sc.orbit);
+    add(Scenario::Period, sc.period);
+    add(Scenario::Angle, sc.angle);
+    add(Scenario::Eccentricity, sc.eccentricity);
+    add(Scenario::Inclination, sc.inclination);
+    add(Scenario::Node, sc.node);
+    add(Scenario::Periapsis, sc.periapsis);
+    add(Scenario::Precession, sc.precession);
+    add(Scenario::Color, sc.color);
+    add(Scenario::Rings, sc.rings);
+    add(Scenario::X, sc.state.pos[0]);
+    add(Scenario::Y, sc.state.pos[1]);
+    add(Scenario::VX, sc.state.vel[0]);
+    add(Scenario::VY, sc.state.vel[1]);
+    return w.write(path);
+}
+
+// Writes the text form, every number in its shortest exact spelling so that
+// text and binary load to the same values.
+inline bool writeScenarioText(const std::string& path, const Scenario& sc) {
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    std::string out;
+    out.reserve(scenario_detail::BLOCK + 4096);
+    if (!sc.title.empty()) out += "scenario " + sc.title + "\n";
+    if (!sc.units.empty()) out += "units " + sc.units + "\n";
+    out += "bodies " + std::to_string(sc.size()) + "\ncolumns";
+    for (std::uint32_t c = 0; c < Scenario::COLUMN_COUNT; ++c)
+        if (sc.has(Scenario::Column(c))) out += std::string(" ") + Scenario::columnName(Scenario::Column(c));
+    out += "\n";
+
+    bool ok = true;
+    char num[32];
+    auto put = [&](auto v) {
+        const auto r = std::to_chars(num, num + sizeof(num), v);
+        out.append(num, r.ptr);
+        out += ' ';
+    };
+    for (std::size_t i = 0; i < sc.size() && ok; ++i) {
+        for (std::uint32_t c = 0; c < Scenario::COLUMN_COUNT; ++c) {
+            if (!sc.has(Scenario::Column(c))) continue;
+            switch (c) {
+            case Scenario::Name: out += sc.name(i); out += ' '; break;
+            case Scenario::Parent:
+                if (sc.parent[i] == Scenario::NO_PARENT) out += "- ";
+                else if (sc.has(Scenario::Name)) out += std::string(sc.name(sc.parent[i])) + " ";
+                else put(sc.parent[i]);
+                break;
+            case Scenario::Mass: put(sc.state.mass[i]); break;
+            case Scenario::Radius: put(sc.radius[i]); break;
+            case Scenario::Orbit: put(sc.orbit[i]); break;
+            case Scenario::Period: put(sc.period[i]); break;
+            case Scenario::Angle: put(sc.angle[i]); break;
+            case Scenario::Eccentricity: put(sc.eccentricity[i]); break;
+            case Scenario::Inclination: put(sc.inclination[i]); break;
+            case Scenario::Node: put(sc.node[i]); break;
+            case Scenario::Periapsis: put(sc.periapsis[i]); break;
+            case Scenario::Precession: put(sc.precession[i]); break;
+            case Scenario::Color: {
+                const std::uint32_t v = sc.color[i];
+                if ((v & 255u) == 255u)
+                    std::snprintf(num, sizeof(num), "%u,%u,%u ", v >> 24, (v >> 16) & 255u, (v >> 8) & 255u);
+                else
+                    std::snprintf(num, sizeof(num), "%u,%u,%u,%u ", v >> 24, (v >> 16) & 255u, (v >> 8) & 255u, v & 255u);
+                out += num;
+                break;
+            }
+            case Scenario::Rings: out += sc.rings[i] ? "1 " : "0 "; break;
+            case Scenario::X: put(sc.state.pos[0][i]); break;
+            case Scenario::Y: put(sc.state.pos[1][i]); break;
+            case Scenario::VX: put(sc.state.vel[0][i]); break;
+            case Scenario::VY: put(sc.state.vel[1][i]); break;
+            }
+        }
+        out.back() = '\n';
+        if (out.size() >= scenario_detail::BLOCK) {
+            ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+            out.clear();
+        }
+    }
+    ok = ok && std::fwrite(out.data(), 1, out.size(), f) == out.size();
+    return std::fclose(f) == 0 && ok;
+}
+
+// Command-line switch for the initial conditions:
+//   --scenario PATH   scenario file, text or binary (see above)
+inline std::string parseScenario(int argc, char** argv, const std::string& fallback) {
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == "--scenario") return argv[i + 1];
+    return fallback;
+}
+
+} // namespace grav
@@ -0,0 +1,160 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GRAV_X86_SIMD 1
+#include <immintrin.h>
+#define GRAV_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define GRAV_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+#define GRAV_X86_SIMD 0
+#endif
+
+namespace grav {
+
+// Allocator handing out cache-line (and AVX-512 register) aligned storage.
+template <typename T, std::size_t Align = 64>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(std::size_t n) {
+        std::size_t bytes = (n * sizeof(T) + Align - 1) / Align * Align;
+        void* p = std::aligned_alloc(Align, bytes == 0 ? Align : bytes);
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, std::size_t) { std::free(p); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+enum class SimdLevel { Scalar, Avx2, Avx512 };
+
+inline const char* simdName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Avx512: return "AVX-512";
+        case SimdLevel::Avx2: return "AVX2";
+        default: return "scalar";
+    }
+}
+
+// Best instruction set this CPU supports; GRAV_SIMD=scalar|avx2 caps it for testing.
+inline SimdLevel detectSimd() {
+    SimdLevel best = SimdLevel::Scalar;
+#if GRAV_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) best = SimdLevel::Avx2;
+    if (best == SimdLevel::Avx2 && __builtin_cpu_supports("avx512f")) best = SimdLevel::Avx512;
+#endif
+    if (const char* cap = std::getenv("GRAV_SIMD")) {
+        std::string s(cap);
+        if (s == "scalar") best = SimdLevel::Scalar;
+        else if (s == "avx2" && best == SimdLevel::Avx512) best = SimdLevel::Avx2;
+    }
+    return best;
+}
+
+inline SimdLevel simdLevel() {
+    static const SimdLevel level = detectSimd();
+    return level;
+}
+
+#if GRAV_X86_SIMD
+// Cephes-style single precision sincos: reduce by pi/4 octant, then minimax
+// polynomials on [-pi/4, pi/4]. Accurate to a couple of ulp for |x| < 8192.
+namespace simd_detail {
+constexpr float FOPI = 1.27323954473516f;
+constexpr float DP1 = -0.78515625f;
+constexpr float DP2 = -2.4187564849853515625e-4f;
+constexpr float DP3 = -3.77489497744594108e-8f;
+constexpr float SIN_P0 = -1.9515295891e-4f, SIN_P1 = 8.3321608736e-3f, SIN_P2 = -1.6666654611e-1f;
+constexpr float COS_P0 = 2.443315711809948e-5f, COS_P1 = -1.388731625493765e-3f, COS_P2 = 4.166664568298827e-2f;
+} // namespace simd_detail
+
+GRAV_TARGET_AVX2 inline void sincos8(__m256 x, __m256& s, __m256& c) {
+    using namespace simd_detail;
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(int(0x80000000u)));
+    __m256 signSin = _mm256_and_ps(x, signMask);
+    x = _mm256_andnot_ps(signMask, x);
+
+    __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(FOPI)));
+    j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+    const __m256 y = _mm256_cvtepi32_ps(j);
+
+    const __m256 swapSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29));
+    const __m256 usePoly2 = _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+    const __m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+    signSin = _mm256_xor_ps(signSin, swapSin);
+
+    x = _mm256_fmadd_ps(y, _mm256_set1_ps(DP1), x);
+    x = _mm256_fmadd_ps(y, _mm256_set1_ps(DP2), x);
+    x = _mm256_fmadd_ps(y, _mm256_set1_ps(DP3), x);
+    const __m256 z = _mm256_mul_ps(x, x);
+
+    __m256 pc = _mm256_fmadd_ps(_mm256_set1_ps(COS_P0), z, _mm256_set1_ps(COS_P1));
+    pc = _mm256_fmadd_ps(pc, z, _mm256_set1_ps(COS_P2));
+    pc = _mm256_mul_ps(_mm256_mul_ps(pc, z), z);
+    pc = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, pc);
+    pc = _mm256_add_ps(pc, _mm256_set1_ps(1.f));
+
+    __m256 ps = _mm256_fmadd_ps(_mm256_set1_ps(SIN_P0), z, _mm256_set1_ps(SIN_P1));
+    ps = _mm256_fmadd_ps(ps, z, _mm256_set1_ps(SIN_P2));
+    ps = _mm256_fmadd_ps(_mm256_mul_ps(ps, z), x, x);
+
+    s = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, usePoly2), signSin);
+    c = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, usePoly2), signCos);
+}
+
+GRAV_TARGET_AVX512 inline void sincos16(__m512 x, __m512& s, __m512& c) {
+    using namespace simd_detail;
+    const __m512i signMask = _mm512_set1_epi32(int(0x80000000u));
+    __m512i xi = _mm512_castps_si512(x);
+    __m512i signSin = _mm512_and_si512(xi, signMask);
+    x = _mm512_castsi512_ps(_mm512_andnot_si512(signMask, xi));
+
+    __m512i j = _mm512_cvttps_epi32(_mm512_mul_ps(x, _mm512_set1_ps(FOPI)));
+    j = _mm512_and_si512(_mm512_add_epi32(j, _mm512_set1_epi32(1)), _mm512_set1_epi32(~1));
+    const __m512 y = _mm512_cvtepi32_ps(j);
+
+    const __m512i swapSin = _mm512_slli_epi32(_mm512_and_si512(j, _mm512_set1_epi32(4)), 29);
+    const __mmask16 usePoly2 = _mm512_testn_epi32_mask(j, _mm512_set1_epi32(2));
+    const __m512i signCos = _mm512_slli_epi32(
+        _mm512_andnot_si512(_mm512_sub_epi32(j, _mm512_set1_epi32(2)), _mm512_set1_epi32(4)), 29);
+    signSin = _mm512_xor_si512(signSin, swapSin);
+
+    x = _mm512_fmadd_ps(y, _mm512_set1_ps(DP1), x);
+    x = _mm512_fmadd_ps(y, _mm512_set1_ps(DP2), x);
+    x = _mm512_fmadd_ps(y, _mm512_set1_ps(DP3), x);
+    const __m512 z = _mm512_mul_ps(x, x);
+
+    __m512 pc = _mm512_fmadd_ps(_mm512_set1_ps(COS_P0), z, _mm512_set1_ps(COS_P1));
+    pc = _mm512_fmadd_ps(pc, z, _mm512_set1_ps(COS_P2));
+    pc = _mm512_mul_ps(_mm512_mul_ps(pc, z), z);
+    pc = _mm512_fnmadd_ps(_mm512_set1_ps(0.5f), z, pc);
+    pc = _mm512_add_ps(pc, _mm512_set1_ps(1.f));
+
+    __m512 ps = _mm512_fmadd_ps(_mm512_set1_ps(SIN_P0), z, _mm512_set1_ps(SIN_P1));
+    ps = _mm512_fmadd_ps(ps, z, _mm512_set1_ps(SIN_P2));
+    ps = _mm512_fmadd_ps(_mm512_mul_ps(ps, z), x, x);
+
+    s = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_mask_blend_ps(usePoly2, pc, ps)), signSin));
+    c = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_mask_blend_ps(usePoly2, ps, pc)), signCos));
+}
+#endif
+
+} // namespace grav
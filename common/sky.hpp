@@ -0,0 +1,381 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+struct SkyParams {
+    std::uint32_t seed = 1;
+    unsigned width = 800, height = 600;     // image size in pixels
+    float stars = 2000.f;       // stars in a square one image height across, all magnitudes
+    float faintest = 8.f;       // magnitudes run from 0 (brightest) to this
+    float starSize = 0.6f;      // Gaussian radius of a star's core in pixels, at 600 px high
+    float nebula = 0.f;         // brightness of the nebula; 0 leaves black between the stars
+    float nebulaScale = 2.f;    // nebula clouds per image height
+    unsigned layers = 5;        // noise octaves in the nebula, each twice as fine
+};
+
+// --sky-seed, --sky-stars and --sky-nebula override the defaults.
+inline SkyParams parseSkyParams(int argc, char** argv, SkyParams params) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--sky-seed") params.seed = std::uint32_t(std::strtoul(argv[i + 1], nullptr, 10));
+        if (arg == "--sky-stars") params.stars = std::strtof(argv[i + 1], nullptr);
+        if (arg == "--sky-nebula") params.nebula = std::strtof(argv[i + 1], nullptr);
+    }
+    return params;
+}
+
+// Procedural starfield with an optional nebula, the same for a given seed on
+// every run and with any number of threads.
+//
+// Every random number is a hash of the seed and what it is for (a star's cell
+// and index, a noise lattice point), not the next draw from a sequence, so
+// the image is rendered in 64 x 64 pixel tiles on all cores in any order.
+// Stars belong to cells of a grid one sixteenth of the image height across;
+// a tile generates the stars of the cells near it and keeps the parts that
+// land on it. Magnitudes follow the rising counts of a real sky, ten times
+// more stars for every two magnitudes fainter, and the brightest saturate
+// into larger discs. The nebula is value noise summed over `layers` octaves.
+// Positions and sizes scale with the height, so one seed gives the same sky at
+// 800 x 600 and at 16k. Past the finest noise layer the nebula is smooth, so
+// it is sampled every few pixels and interpolated; an 8K sky takes about a
+// second on one core, and reading it back from the cache about 0.1 s.
+//
+// cached() keeps rendered skies on disk keyed by the parameters, so a large
+// sky is rendered once and later runs only read it back.
+class SkyImage {
+public:
+    const SkyParams& params() const { return params_; }
+    unsigned width() const { return params_.width; }
+    unsigned height() const { return params_.height; }
+    // RGBA8 bytes, row by row, ready for sf::Texture::update().
+    const std::uint8_t* pixels() const { return reinterpret_cast<const std::uint8_t*>(texels_.data()); }
+    // The same pixels as 32-bit words, for LensTracer::setBackground().
+    const std::uint32_t* rgba() const { return texels_.data(); }
+    bool fromDisk() const { return fromDisk_; }
+    double millis() const { return millis_; }
+
+    static SkyImage render(const SkyParams& p) {
+        SkyImage sky;
+        sky.params_ = p;
+        const auto start = std::chrono::steady_clock::now();
+        sky.texels_.resize(std::size_t(p.width) * p.height);
+        const Field field(p);
+        const std::size_t tilesX = (p.width + TILE - 1) / TILE, tilesY = (p.height + TILE - 1) / TILE;
+        TaskScheduler::instance().parallelFor(0, tilesX * tilesY, 4, [&](std::size_t first, std::size_t last) {
+            std::vector<float> light(SCRATCH);
+            for (std::size_t t = first; t < last; ++t)
+                field.tile(unsigned(t % tilesX) * TILE, unsigned(t / tilesX) * TILE, light.data(), sky.texels_.data());
+        });
+        sky.millis_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return sky;
+    }
+
+    // The sky for p from dir if an earlier run rendered it, otherwise
+    // rendered now and written there for next time.
+    static SkyImage cached(const SkyParams& p, const std::string& dir = ".cache") {
+        const auto start = std::chrono::steady_clock::now();
+        const std::string path = dir + "/" + cacheName(p);
+        SkyImage sky;
+        if (sky.load(path, p)) {
+            sky.millis_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return sky;
+        }
+        sky = render(p);
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        sky.save(path);
+        return sky;
+    }
+
+    // File name unique to a parameter set.
+    static std::string cacheName(const SkyParams& p) {
+        char name[96];
+        std::snprintf(name, sizeof(name), "sky_%u_%ux%u_%08x.sky", p.seed, p.width, p.height, unsigned(hash(p)));
+        return name;
+    }
+
+    // Written to a temporary file and renamed into place, so a run killed
+    // mid-write never leaves a torn cache behind.
+    bool save(const std::string& path) const {
+        const std::string temp = path + ".tmp";
+        std::ofstream out(temp, std::ios::binary);
+        const Header header = headerFor(params_);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(texels_.data()), std::streamsize(texels_.size() * 4));
+        out.close();
+        const bool ok = !out.fail() && std::rename(temp.c_str(), path.c_str()) == 0;
+        if (!ok) std::remove(temp.c_str());
+        return ok;
+    }
+
+    // False unless path holds a sky rendered with exactly p.
+    bool load(const std::string& path, const SkyParams& p) {
+        std::ifstream in(path, std::ios::binary);
+        Header header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+        const Header expected = headerFor(p);
+        if (std::memcmp(&header, &expected, sizeof(header)) != 0) return false;
+        params_ = p;
+        texels_.resize(std::size_t(p.width) * p.height);
+        if (!in.read(reinterpret_cast<char*>(texels_.data()), std::streamsize(texels_.size() * 4))) return false;
+        fromDisk_ = true;
+        return true;
+    }
+
+private:
+    SkyParams params_;
+    std::vector<std::uint32_t> texels_;
+    bool fromDisk_ = false;
+    double millis_ = 0.0;
+
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr unsigned TILE = 64;
+    static constexpr unsigned CELLS = 16;       // star cells per image height
+    static constexpr std::size_t SCRATCH = (TILE * TILE + (TILE + 1) * (TILE + 1)) * 3;
+    static constexpr float FAINT = 0.05f;       // peak light of a star at the faintest magnitude
+    static constexpr float CUTOFF = 0.5f / 255.f;   // light that no longer shows
+
+    // What the random numbers are drawn for, so no two uses share a hash.
+    enum Stream : std::uint64_t { STAR_COUNT = 1, STAR = 2, DENSITY = 3, HUE = 4 };
+
+    static std::uint64_t mix(std::uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    static std::uint64_t key(std::uint64_t seed, std::uint64_t stream, std::uint64_t a, std::uint64_t b) {
+        return mix(mix(mix(seed * 0x9e3779b97f4a7c15ull + stream) ^ a) ^ b);
+    }
+
+    // A float in [0, 1) from bits [shift, shift + 24) of a key.
+    static float unit(std::uint64_t k, int shift = 40) { return float((k >> shift) & 0xffffff) * (1.f / 16777216.f); }
+
+    struct Star {
+        float x, y;         // pixels
+        float peak;         // light at the centre
+        float r, g, b;
+    };
+
+    // Everything render() needs, worked out once from the parameters.
+    struct Field {
+        SkyParams p;
+        float cellSize;     // pixels
+        float perCell;      // expected stars per cell
+        float sigma;        // star core radius in pixels
+        float reach;        // farthest any star's light shows, in pixels
+        float slope;        // 10^(faintest / 2) - 1, for drawing magnitudes
+        unsigned step;      // pixels between nebula samples, a power of two up to TILE
+
+        explicit Field(const SkyParams& params) : p(params) {
+            cellSize = float(p.height) / float(CELLS);
+            perCell = p.stars / float(CELLS * CELLS);
+            sigma = std::max(p.starSize * float(p.height) / 600.f, 0.35f);
+            slope = std::pow(10.f, 0.5f * p.faintest) - 1.f;
+            reach = radius(FAINT * std::pow(10.f, 0.4f * p.faintest));
+            // The finest noise layer varies over a lattice cell; sixteen samples
+            // across one look the same interpolated as evaluated per pixel
+            const float finest = float(p.height) / (p.nebulaScale * std::exp2(float(std::max(p.layers, 1u) - 1)));
+            step = 1;
+            while (step < TILE && float(step * 2 * 16) <= finest) step *= 2;
+        }
+
+        float radius(float peak) const { return sigma * std::sqrt(2.f * std::log(std::max(peak / CUTOFF, 1.f))); }
+
+        // Poisson-distributed star count of a cell, from its own hash.
+        unsigned starCount(std::uint64_t cell) const {
+            const std::uint64_t k = key(p.seed, STAR_COUNT, cell, 0);
+            if (perCell > 30.f) {
+                // Normal approximation; Box-Muller from two halves of the key
+                const float u1 = std::max(unit(k, 40), 1e-7f), u2 = unit(k, 8);
+                const float g = std::sqrt(-2.f * std::log(u1)) * std::cos(6.2831853f * u2);
+                return unsigned(std::max(std::lround(perCell + std::sqrt(perCell) * g), 0L));
+            }
+            const float limit = std::exp(-perCell);
+            float product = 1.f;
+            unsigned n = 0;
+            while (n < 256) {
+                product *= unit(key(p.seed, STAR_COUNT, cell, n + 1));
+                if (product <= limit) break;
+                ++n;
+            }
+            return n;
+        }
+
+        Star star(unsigned cx, unsigned cy, std::uint64_t cell, unsigned i) const {
+            const std::uint64_t a = key(p.seed, STAR, cell, i), b = mix(a);
+            Star s;
+            s.x = (float(cx) + unit(a, 40)) * cellSize;
+            s.y = (float(cy) + unit(a, 16)) * cellSize;
+            // Counts grow as 10^(m / 2): inverse of that distribution on [0, faintest]
+            const float m = 2.f * std::log10(1.f + unit(b, 40) * slope);
+            s.peak = FAINT * std::pow(10.f, 0.4f * (p.faintest - m));
+            // Colour from blue-white through white to orange
+            const float t = unit(b, 16);
+            s.r = t < 0.5f ? 0.7f + 0.6f * t : 1.f;
+            s.g = t < 0.5f ? 0.8f + 0.4f * t : 1.f - 0.3f * (t - 0.5f);
+            s.b = t < 0.5f ? 1.f : 1.f - 0.8f * (t - 0.5f);
+            return s;
+        }
+
+        // Smoothly interpolated lattice values in [-1, 1].
+        float noise(std::uint64_t stream, float x, float y) const {
+            const float fx = std::floor(x), fy = std::floor(y);
+            const auto ix = std::uint64_t(std::int64_t(fx)), iy = std::uint64_t(std::int64_t(fy));
+            const float tx = x - fx, ty = y - fy;
+            const float sx = tx * tx * (3.f - 2.f * tx), sy = ty * ty * (3.f - 2.f * ty);
+            auto at = [&](std::uint64_t i, std::uint64_t j) { return unit(key(p.seed, stream, i, j)) * 2.f - 1.f; };
+            const float top = at(ix, iy) + (at(ix + 1, iy) - at(ix, iy)) * sx;
+            const float bottom = at(ix, iy + 1) + (at(ix + 1, iy + 1) - at(ix, iy + 1)) * sx;
+            return top + (bottom - top) * sy;
+        }
+
+        // Octaves of noise, each layer on its own lattice, summed to about [-1, 1].
+        float fractal(std::uint64_t stream, unsigned layers, float x, float y) const {
+            float sum = 0.f, amplitude = 0.5f;
+            for (unsigned l = 0; l < layers; ++l) {
+                sum += amplitude * noise(stream + 16 * l, x, y);
+                x *= 2.f;
+                y *= 2.f;
+                amplitude *= 0.5f;
+            }
+            return sum;
+        }
+
+        // Nebula light at pixel (x, y), purple where thin to blue where thick.
+        void nebulaAt(unsigned x, unsigned y, float* rgb) const {
+            const float scale = p.nebulaScale / float(p.height);
+            const float u = (float(x) + 0.5f) * scale, v = (float(y) + 0.5f) * scale;
+            float d = std::clamp((fractal(DENSITY, p.layers, u, v) + 0.1f) / 0.5f, 0.f, 1.f);
+            d = d * d * p.nebula;
+            const float hue = std::clamp(0.5f + fractal(HUE, 2, 0.5f * u + 7.f, 0.5f * v + 7.f), 0.f, 1.f);
+            rgb[0] = d * (0.45f + (0.10f - 0.45f) * hue);
+            rgb[1] = d * (0.15f + (0.30f - 0.15f) * hue);
+            rgb[2] = d * (0.55f + (0.60f - 0.55f) * hue);
+        }
+
+        // Lights the tile at (x0, y0) in `scratch` (SCRATCH floats) and
+        // writes it to out.
+        void tile(unsigned x0, unsigned y0, float* scratch, std::uint32_t* out) const {
+            const unsigned w = std::min(TILE, p.width - x0), h = std::min(TILE, p.height - y0);
+            float* light = scratch;     // RGB per pixel, TILE pixels to a row
+            std::fill(light, light + TILE * TILE * 3, 0.f);
+
+            if (p.nebula > 0.f) {
+                // Sampled every `step` pixels on a grid aligned to the image,
+                // so neighbouring tiles share their edge samples
+                float* samples = scratch + TILE * TILE * 3;
+                const unsigned n = TILE / step + 1;
+                for (unsigned j = 0; j <= (h - 1) / step + 1; ++j)
+                    for (unsigned i = 0; i <= (w - 1) / step + 1; ++i)
+                        nebulaAt(x0 + i * step, y0 + j * step, &samples[(j * n + i) * 3]);
+                const float inv = 1.f / float(step);
+                for (unsigned y = 0; y < h; ++y) {
+                    const unsigned j = y / step;
+                    const float fy = float(y % step) * inv;
+                    for (unsigned x = 0; x < w; ++x) {
+                        const unsigned i = x / step;
+                        const float fx = float(x % step) * inv;
+                        const float* s = &samples[(j * n + i) * 3];
+                        float* l = &light[(y * TILE + x) * 3];
+                        for (int c = 0; c < 3; ++c) {
+                            const float top = s[c] + (s[3 + c] - s[c]) * fx;
+                            const float bottom = s[n * 3 + c] + (s[n * 3 + 3 + c] - s[n * 3 + c]) * fx;
+                            l[c] = top + (bottom - top) * fy;
+                        }
+                    }
+                }
+            }
+
+            const float left = float(x0) - reach, right = float(x0 + w) + reach;
+            const float topEdge = float(y0) - reach, bottomEdge = float(y0 + h) + reach;
+            const unsigned cellsX = unsigned(std::ceil(float(p.width) / cellSize));
+            const unsigned cx0 = unsigned(std::max(left / cellSize, 0.f));
+            const unsigned cy0 = unsigned(std::max(topEdge / cellSize, 0.f));
+            const unsigned cx1 = std::min(unsigned(right / cellSize) + 1, cellsX);
+            const unsigned cy1 = std::min(unsigned(bottomEdge / cellSize) + 1, CELLS);
+            const float inv = 1.f / (2.f * sigma * sigma);
+            for (unsigned cy = cy0; cy < cy1; ++cy)
+                for (unsigned cx = cx0; cx < cx1; ++cx) {
+                    const std::uint64_t cell = std::uint64_t(cy) << 32 | cx;
+                    const unsigned n = starCount(cell);
+                    for (unsigned i = 0; i < n; ++i) {
+                        const Star s = star(cx, cy, cell, i);
+                        const float r = radius(s.peak);
+                        const int sx0 = std::max(int(std::floor(s.x - r - float(x0))), 0);
+                        const int sy0 = std::max(int(std::floor(s.y - r - float(y0))), 0);
+                        const int sx1 = std::min(int(std::ceil(s.x + r - float(x0))), int(w));
+                        const int sy1 = std::min(int(std::ceil(s.y + r - float(y0))), int(h));
+                        for (int y = sy0; y < sy1; ++y) {
+                            const float dy = float(y0 + y) + 0.5f - s.y;
+                            for (int x = sx0; x < sx1; ++x) {
+                                const float dx = float(x0 + x) + 0.5f - s.x;
+                                const float e = s.peak * std::exp(-(dx * dx + dy * dy) * inv);
+                                float* l = &light[(y * TILE + x) * 3];
+                                l[0] += e * s.r;
+                                l[1] += e * s.g;
+                                l[2] += e * s.b;
+                            }
+                        }
+                    }
+                }
+
+            // Exposure: light of 1 shows at 63%, and brighter light saturates softly
+            for (unsigned y = 0; y < h; ++y) {
+                auto* row = reinterpret_cast<std::uint8_t*>(out + std::size_t(y0 + y) * p.width + x0);
+                for (unsigned x = 0; x < w; ++x) {
+                    const float* l = &light[(y * TILE + x) * 3];
+                    for (int c = 0; c < 3; ++c) row[x * 4 + c] = std::uint8_t(255.f * (1.f - std::exp(-l[c])) + 0.5f);
+                    row[x * 4 + 3] = 255;
+                }
+            }
+        }
+    };
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version, seed, width, height, layers;
+        float stars, faintest, starSize, nebula, nebulaScale;
+    };
+
+    static Header headerFor(const SkyParams& p) {
+        Header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, "GRAVSKY0", 8);
+        h.version = VERSION;
+        h.seed = p.seed;
+        h.width = p.width;
+        h.height = p.height;
+        h.layers = p.layers;
+        h.stars = p.stars;
+        h.faintest = p.faintest;
+        h.starSize = p.starSize;
+        h.nebula = p.nebula;
+        h.nebulaScale = p.nebulaScale;
+        return h;
+    }
+
+    // FNV-1a over the header, which holds every parameter.
+    static std::uint32_t hash(const SkyParams& p) {
+        const Header h = headerFor(p);
+        const auto* bytes = reinterpret_cast<const unsigned char*>(&h);
+        std::uint32_t x = 2166136261u;
+        for (std::size_t i = 0; i < sizeof(h); ++i) x = (x ^ bytes[i]) * 16777619u;
+        return x;
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,307 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRAV_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define GRAV_MMAP 0
+#endif
+
+namespace grav {
+
+// Binary simulation snapshots: a fixed header, a table of named columns, then
+// each column as one contiguous little-endian array starting on a 64-byte
+// boundary (structure of arrays, exactly as the simulations keep their state).
+//
+//   header    "GRAVSNAP", version, column count, body count, step, time,
+//             integrator, dimensions, units text
+//   columns   name, element type, byte offset, element count; one per column
+//   data      the arrays
+//
+// SnapshotWriter streams each column straight from the caller's memory to a
+// temporary file, syncs it and renames it over the target, so a run killed
+// mid-write leaves the previous snapshot intact. SnapshotFile maps a file
+// read-only and hands out pointers into the mapping: opening one costs the
+// same for 10 MB or 10 GB, and pages load as the columns are touched.
+//
+// The format is defined as little-endian; hosts of the other byte order are
+// refused rather than silently misread.
+enum class ColumnType : std::uint32_t { F32 = 1, F64 = 2, U32 = 3, U64 = 4, U8 = 5 };
+
+template <typename T> struct ColumnTypeOf;
+template <> struct ColumnTypeOf<float> { static constexpr ColumnType value = ColumnType::F32; };
+template <> struct ColumnTypeOf<double> { static constexpr ColumnType value = ColumnType::F64; };
+template <> struct ColumnTypeOf<std::uint32_t> { static constexpr ColumnType value = ColumnType::U32; };
+template <> struct ColumnTypeOf<std::uint64_t> { static constexpr ColumnType value = ColumnType::U64; };
+template <> struct ColumnTypeOf<std::uint8_t> { static constexpr ColumnType value = ColumnType::U8; };
+
+inline std::size_t columnTypeSize(ColumnType t) {
+    return t == ColumnType::F64 || t == ColumnType::U64 ? 8 : t == ColumnType::U8 ? 1 : 4;
+}
+
+inline bool littleEndianHost() {
+    const std::uint32_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+// What the header says about the run.
+struct SnapshotInfo {
+    std::uint64_t count = 0;        // bodies (length of the per-body columns)
+    std::uint64_t step = 0;         // steps taken
+    double time = 0.0;              // simulated time, in the units below
+    std::uint32_t integrator = 0;   // the program's integrator enum, as a number
+    std::uint32_t dims = 0;         // spatial dimensions
+    std::string units;              // free text, e.g. "length=px time=day G=1"
+};
+
+namespace snapshot_detail {
+constexpr std::uint32_t VERSION = 1;
+constexpr std::uint64_t ALIGN = 64;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version, columns;
+    std::uint64_t count, step;
+    double time;
+    std::uint32_t integrator, dims;
+    char units[48];
+};
+
+struct Column {
+    char name[24];
+    std::uint32_t type, reserved;
+    std::uint64_t offset, length;
+};
+
+inline std::uint64_t alignUp(std::uint64_t v) { return (v + ALIGN - 1) / ALIGN * ALIGN; }
+} // namespace snapshot_detail
+
+class SnapshotWriter {
+public:
+    SnapshotInfo info;
+
+    // Adds a column; the data is not copied and must stay valid until write().
+    template <typename T>
+    void column(const std::string& name, const T* data, std::size_t length) {
+        columns_.push_back({name, ColumnTypeOf<T>::value, data, length});
+    }
+    template <typename Vec>
+    void column(const std::string& name, const Vec& values) {
+        column(name, values.data(), values.size());
+    }
+
+    bool write(const std::string& path) const {
+        using namespace snapshot_detail;
+        if (!littleEndianHost()) return false;
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "GRAVSNAP", 8);
+        header.version = VERSION;
+        header.columns = std::uint32_t(columns_.size());
+        header.count = info.count;
+        header.step = info.step;
+        header.time = info.time;
+        header.integrator = info.integrator;
+        header.dims = info.dims;
+        std::strncpy(header.units, info.units.c_str(), sizeof(header.units) - 1);
+
+        std::vector<Column> table(columns_.size());
+        std::uint64_t offset = alignUp(sizeof(Header) + sizeof(Column) * table.size());
+        for (std::size_t i = 0; i < columns_.size(); ++i) {
+            Column& c = table[i];
+            std::memset(&c, 0, sizeof(c));
+            std::strncpy(c.name, columns_[i].name.c_str(), sizeof(c.name) - 1);
+            c.type = std::uint32_t(columns_[i].type);
+            c.offset = offset;
+            c.length = columns_[i].length;
+            offset = alignUp(offset + c.length * columnTypeSize(columns_[i].type));
+        }
+
+        const std::string temp = path + ".tmp";
+        std::FILE* f = std::fopen(temp.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1;
+        if (!table.empty()) ok = ok && std::fwrite(table.data(), sizeof(Column), table.size(), f) == table.size();
+        std::uint64_t at = sizeof(Header) + sizeof(Column) * table.size();
+        const char zeros[ALIGN] = {};
+        for (std::size_t i = 0; i < columns_.size() && ok; ++i) {
+            ok = std::fwrite(zeros, 1, table[i].offset - at, f) == table[i].offset - at;
+            const std::size_t bytes = std::size_t(table[i].length * columnTypeSize(columns_[i].type));
+            if (bytes > 0) ok = ok && std::fwrite(columns_[i].data, 1, bytes, f) == bytes;
+            at = table[i].offset + bytes;
+        }
+        ok = std::fflush(f) == 0 && ok;
+#if GRAV_MMAP
+        ok = ok && fsync(fileno(f)) == 0;
+#endif
+        ok = std::fclose(f) == 0 && ok;
+        if (ok) ok = std::rename(temp.c_str(), path.c_str()) == 0;
+        if (!ok) std::remove(temp.c_str());
+        return ok;
+    }
+
+private:
+    struct Source {
+        std::string name;
+        ColumnType type;
+        const void* data;
+        std::size_t length;
+    };
+    std::vector<Source> columns_;
+};
+
+class SnapshotFile {
+public:
+    SnapshotFile() = default;
+    explicit SnapshotFile(const std::string& path) { open(path); }
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+    ~SnapshotFile() { close(); }
+
+    // False if the file is missing, truncated or not a snapshot of this version.
+    bool open(const std::string& path) {
+        using namespace snapshot_detail;
+        close();
+        if (!littleEndianHost() || !map(path)) return false;
+        if (size_ < sizeof(Header)) return fail();
+        Header header;
+        std::memcpy(&header, base_, sizeof(header));
+        if (std::memcmp(header.magic, "GRAVSNAP", 8) != 0 || header.version != VERSION) return fail();
+        if (size_ < sizeof(Header) + std::uint64_t(header.columns) * sizeof(Column)) return fail();
+        table_.resize(header.columns);
+        std::memcpy(table_.data(), base_ + sizeof(Header), table_.size() * sizeof(Column));
+        for (const Column& c : table_) {
+            const std::uint64_t width = columnTypeSize(ColumnType(c.type));
+            if (c.offset % ALIGN != 0 || c.offset > size_ || c.length > (size_ - c.offset) / width) return fail();
+        }
+        info_.count = header.count;
+        info_.step = header.step;
+        info_.time = header.time;
+        info_.integrator = header.integrator;
+        info_.dims = header.dims;
+        info_.units.assign(header.units, strnlen(header.units, sizeof(header.units)));
+        return true;
+    }
+
+    bool isOpen() const { return base_ != nullptr; }
+    const SnapshotInfo& info() const { return info_; }
+
+    std::vector<std::string> columnNames() const {
+        std::vector<std::string> names;
+        for (const auto& c : table_) names.emplace_back(c.name, strnlen(c.name, sizeof(c.name)));
+        return names;
+    }
+
+    // The column's elements in place, or nullptr if there is no column of that
+    // name and type. length receives the element count.
+    template <typename T>
+    const T* column(const std::string& name, std::size_t* length = nullptr) const {
+        for (const auto& c : table_) {
+            if (name.compare(0, std::string::npos, c.name, strnlen(c.name, sizeof(c.name))) != 0) continue;
+            if (ColumnType(c.type) != ColumnTypeOf<T>::value) return nullptr;
+            if (length) *length = std::size_t(c.length);
+            return reinterpret_cast<const T*>(base_ + c.offset);
+        }
+        return nullptr;
+    }
+
+    // Copies a column into out, which is resized to fit; false if it is missing.
+    template <typename Vec>
+    bool read(const std::string& name, Vec& out) const {
+        std::size_t n = 0;
+        const auto* p = column<typename Vec::value_type>(name, &n);
+        if (!p) return false;
+        out.assign(p, p + n);
+        return true;
+    }
+
+    void close() {
+#if GRAV_MMAP
+        if (base_ && size_ > 0) munmap(const_cast<char*>(base_), size_);
+#endif
+        base_ = nullptr;
+        size_ = 0;
+        buffer_.clear();
+        table_.clear();
+    }
+
+private:
+    const char* base_ = nullptr;
+    std::uint64_t size_ = 0;
+    std::vector<char> buffer_;      // the file contents where mmap is unavailable
+    std::vector<snapshot_detail::Column> table_;
+    SnapshotInfo info_;
+
+    bool fail() {
+        close();
+        return false;
+    }
+
+    bool map(const std::string& path) {
+#if GRAV_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        base_ = static_cast<const char*>(p);
+        size_ = std::uint64_t(st.st_size);
+        return true;
+#else
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) return false;
+        std::fseek(f, 0, SEEK_END);
+        const long n = std::ftell(f);
+        std::fseek(f, 0, SEEK_SET);
+        buffer_.resize(n > 0 ? std::size_t(n) : 0);
+        const bool ok = n > 0 && std::fread(buffer_.data(), 1, buffer_.size(), f) == buffer_.size();
+        std::fclose(f);
+        if (!ok) return false;
+        base_ = buffer_.data();
+        size_ = buffer_.size();
+        return true;
+#endif
+    }
+};
+
+// Command-line switches for checkpoint/restart:
+//   --checkpoint PATH       snapshot file to keep up to date
+//   --checkpoint-every K    write it every K steps (default 10000)
+//   --restart PATH          start from a snapshot instead of the initial conditions
+struct CheckpointOptions {
+    std::string path;
+    std::uint64_t every = 10000;
+    std::string restart;
+
+    bool due(std::uint64_t step) const { return !path.empty() && every > 0 && step % every == 0; }
+};
+
+inline CheckpointOptions parseCheckpoint(int argc, char** argv) {
+    CheckpointOptions opt;
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--checkpoint") opt.path = argv[++i];
+        else if (arg == "--checkpoint-every") opt.every = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--restart") opt.restart = argv[++i];
+    }
+    return opt;
+}
+
+} // namespace grav
@@ -0,0 +1,110 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cell_list.hpp"
+#include "star_field.hpp"
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Black hole that grows by what it swallows. The Schwarzschild radius is linear
+// in the mass, so the horizon is kept as pixels per solar mass.
+struct Hole {
+    float x = 0.f, y = 0.f;
+    double mass = 1e9;                  // solar masses; double so single stars still add up
+    double horizonPerMass = 40e-9;      // 40 px at the starting mass
+
+    float horizon() const { return float(horizonPerMass * mass); }
+};
+
+struct CollisionStats {
+    std::uint64_t accreted = 0;         // stars swallowed whole
+    std::uint64_t disrupted = 0;        // tidal disruption events
+    std::uint64_t merged = 0;           // star-star mergers
+};
+
+// Contact physics for a StarField around a Hole, applied once per step after
+// the stars have moved:
+//   - a star touching the horizon is swallowed and its mass added to the hole;
+//   - a star inside its tidal radius R_t = starRadius * (M / m)^(1/3) is torn apart,
+//     and `boundFraction` of it falls in (a tidal disruption event);
+//   - two overlapping stars merge inelastically into the heavier one, mass and
+//     angular momentum conserved, volume added.
+// The consumed star is respawned on the outer ring, so the count is unchanged.
+// Small dense stars reach the horizon before their tidal radius and vanish
+// whole; large ones are shredded further out, as for real supermassive holes.
+class StarCollisions {
+public:
+    float boundFraction = 0.5f;
+    CollisionStats stats;
+
+    const CellList& grid() const { return grid_; }
+
+    void resolve(StarField& stars, Hole& hole) {
+        const std::size_t n = stars.size();
+        fate_.assign(n, KEEP);
+        const float horizon = hole.horizon();
+        const float holeMass = float(hole.mass);
+
+        // R < starRadius * cbrt(M / m) without a cube root per star: R^3 m < starRadius^3 M.
+        TaskScheduler::instance().parallelFor(0, n, 16384, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                const float r = stars.radius[i], s = stars.starRadius[i];
+                if (r < horizon + s) fate_[i] = SWALLOWED;
+                else if (r * r * r * stars.mass[i] < s * s * s * holeMass) fate_[i] = DISRUPTED;
+            }
+        });
+
+        for (std::size_t i = 0; i < n; ++i) {
+            if (fate_[i] == KEEP) continue;
+            if (fate_[i] == SWALLOWED) {
+                hole.mass += stars.mass[i];
+                ++stats.accreted;
+            } else {
+                hole.mass += boundFraction * stars.mass[i];
+                ++stats.disrupted;
+            }
+            stars.respawn(i, hole.x, hole.y);
+        }
+
+        grid_.build(stars.x.data(), stars.y.data(), stars.starRadius.data(), n);
+        for (const CellList::Pair& p : grid_.findOverlaps()) {
+            if (fate_[p.first] != KEEP || fate_[p.second] != KEEP) continue; // one merger per star per step
+            const bool firstWins = stars.mass[p.first] >= stars.mass[p.second];
+            const std::uint32_t w = firstWins ? p.first : p.second;
+            const std::uint32_t l = firstWins ? p.second : p.first;
+            merge(stars, w, l, hole);
+            fate_[w] = fate_[l] = MERGED;
+            ++stats.merged;
+        }
+    }
+
+private:
+    enum Fate : std::uint8_t { KEEP, SWALLOWED, DISRUPTED, MERGED };
+
+    CellList grid_;
+    std::vector<std::uint8_t> fate_;
+
+    // Star l is absorbed into star w, which takes the mass-weighted orbit.
+    static void merge(StarField& stars, std::uint32_t w, std::uint32_t l, const Hole& hole) {
+        const float mw = stars.mass[w], ml = stars.mass[l], m = mw + ml;
+        const float rw = stars.radius[w], rl = stars.radius[l];
+        const float r = (mw * rw + ml * rl) / m;
+        // Angular momentum m r^2 omega is conserved.
+        stars.speed[w] = (mw * rw * rw * stars.speed[w] + ml * rl * rl * stars.speed[l]) / (m * r * r);
+        stars.radius[w] = r;
+        stars.mass[w] = m;
+        const float sw = stars.starRadius[w], sl = stars.starRadius[l];
+        stars.starRadius[w] = std::cbrt(sw * sw * sw + sl * sl * sl);
+        stars.fade[w] = std::max(stars.fade[w], stars.fade[l]);
+        stars.x[w] = hole.x + std::cos(stars.angle[w]) * r;
+        stars.y[w] = hole.y + std::sin(stars.angle[w]) * r;
+        stars.respawn(l, hole.x, hole.y);
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,227 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+
+namespace grav {
+
+// Stars spiralling into a black hole, stored as one aligned array per field so
+// the update runs 8 (AVX2) or 16 (AVX-512) stars per instruction.
+class StarField {
+public:
+    AlignedVector<float> x, y;          // screen position
+    AlignedVector<float> angle;         // radians, kept in [0, 2pi)
+    AlignedVector<float> radius;        // distance from the hole
+    AlignedVector<float> speed;         // angular speed, radians per second
+    AlignedVector<float> fade;          // alpha, 255 at spawn
+    AlignedVector<float> mass;          // solar masses
+    AlignedVector<float> starRadius;    // physical size in pixels, for collisions
+    AlignedVector<std::uint32_t> rng;   // per-star xorshift state for respawns
+
+    float infallRate = 10.f;            // radius lost per second
+    float fadeRate = 30.f;              // alpha lost per second
+    float minRadius = 40.f;             // respawn once closer than this
+    float spawnRadius = 200.f;          // respawn distance ...
+    float spawnSpread = 150.f;          // ... plus up to this much
+    float massMin = 0.1f;               // respawn() draws a new mass in [massMin, massMax)
+    float massMax = 2.f;
+    float radiusPerMass = 0.05f;        // main sequence: starRadius = radiusPerMass * mass^0.8
+
+    std::size_t size() const { return angle.size(); }
+
+    void reserve(std::size_t n) {
+        for (auto* v : {&x, &y, &angle, &radius, &speed, &fade, &mass, &starRadius}) v->reserve(n);
+        rng.reserve(n);
+    }
+
+    void add(float a, float r, float s, float f, std::uint32_t seed, float m = 1.f) {
+        x.push_back(0.f);
+        y.push_back(0.f);
+        angle.push_back(std::fmod(a, TWO_PI));
+        radius.push_back(r);
+        speed.push_back(s);
+        fade.push_back(f);
+        mass.push_back(m);
+        starRadius.push_back(radiusFor(m));
+        rng.push_back(seed ? seed : 0x9E3779B9u);
+    }
+
+    void pop_back() {
+        for (auto* v : {&x, &y, &angle, &radius, &speed, &fade, &mass, &starRadius}) v->pop_back();
+        rng.pop_back();
+    }
+
+    float radiusFor(float m) const { return radiusPerMass * std::pow(m, 0.8f); }
+
+    // Replaces star i by a fresh one on the spawn ring around (cx, cy), with a
+    // new mass; used when a star is swallowed, torn apart or merged away.
+    void respawn(std::size_t i, float cx, float cy) {
+        std::uint32_t s = rng[i];
+        radius[i] = spawnRadius + spawnSpread * nextUniform(s);
+        angle[i] = TWO_PI * nextUniform(s);
+        mass[i] = massMin + (massMax - massMin) * nextUniform(s);
+        rng[i] = s;
+        starRadius[i] = radiusFor(mass[i]);
+        fade[i] = 255.f;
+        x[i] = cx + std::cos(angle[i]) * radius[i];
+        y[i] = cy + std::sin(angle[i]) * radius[i];
+    }
+
+    // Advance every star by dt around the hole at (cx, cy).
+    void update(float dt, float cx, float cy) { update(dt, cx, cy, 0, size()); }
+
+    // Same for the index range [first, last), using the widest kernel the CPU has.
+    void update(float dt, float cx, float cy, std::size_t first, std::size_t last) {
+        switch (simdLevel()) {
+#if GRAV_X86_SIMD
+            case SimdLevel::Avx512: first = updateAvx512(dt, cx, cy, first, last); break;
+            case SimdLevel::Avx2: first = updateAvx2(dt, cx, cy, first, last); break;
+#endif
+            default: break;
+        }
+        updateScalar(dt, cx, cy, first, last);
+    }
+
+    void updateScalar(float dt, float cx, float cy, std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            float a = angle[i] + speed[i] * dt;
+            a -= TWO_PI * std::floor(a * INV_TWO_PI);
+            float r = radius[i] - infallRate * dt;
+            float f = fade[i] - fadeRate * dt;
+            if (r < minRadius || f <= 0.f) {
+                std::uint32_t s = rng[i];
+                r = spawnRadius + spawnSpread * nextUniform(s);
+                a = TWO_PI * nextUniform(s);
+                f = 255.f;
+                rng[i] = s;
+            }
+            angle[i] = a;
+            radius[i] = r;
+            fade[i] = f;
+            x[i] = cx + std::cos(a) * r;
+            y[i] = cy + std::sin(a) * r;
+        }
+    }
+
+private:
+    static constexpr float TWO_PI = 6.28318530718f;
+    static constexpr float INV_TWO_PI = 0.159154943092f;
+
+    static std::uint32_t xorshift(std::uint32_t s) {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return s;
+    }
+    static float nextUniform(std::uint32_t& s) {
+        s = xorshift(s);
+        return float(s >> 8) * (1.f / 16777216.f);
+    }
+
+#if GRAV_X86_SIMD
+    // Kernels return the first index they did not process; the caller finishes the tail.
+    GRAV_TARGET_AVX2 std::size_t updateAvx2(float dt, float cx, float cy, std::size_t first, std::size_t last) {
+        const __m256 vDt = _mm256_set1_ps(dt);
+        const __m256 vInfall = _mm256_set1_ps(infallRate * dt);
+        const __m256 vFade = _mm256_set1_ps(fadeRate * dt);
+        const __m256 vMinR = _mm256_set1_ps(minRadius);
+        const __m256 vTwoPi = _mm256_set1_ps(TWO_PI);
+        const __m256 vInvTwoPi = _mm256_set1_ps(INV_TWO_PI);
+        const __m256 vCx = _mm256_set1_ps(cx), vCy = _mm256_set1_ps(cy);
+
+        std::size_t i = first;
+        for (; i + 8 <= last; i += 8) {
+            __m256 a = _mm256_fmadd_ps(_mm256_loadu_ps(&speed[i]), vDt, _mm256_loadu_ps(&angle[i]));
+            a = _mm256_fnmadd_ps(vTwoPi, _mm256_floor_ps(_mm256_mul_ps(a, vInvTwoPi)), a);
+            __m256 r = _mm256_sub_ps(_mm256_loadu_ps(&radius[i]), vInfall);
+            __m256 f = _mm256_sub_ps(_mm256_loadu_ps(&fade[i]), vFade);
+
+            const __m256 respawn = _mm256_or_ps(_mm256_cmp_ps(r, vMinR, _CMP_LT_OQ),
+                                                _mm256_cmp_ps(f, _mm256_setzero_ps(), _CMP_LE_OQ));
+            if (_mm256_movemask_ps(respawn)) {
+                const __m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&rng[i]));
+                const __m256i s1 = xorshift8(s0);
+                const __m256i s2 = xorshift8(s1);
+                r = _mm256_blendv_ps(r, _mm256_fmadd_ps(_mm256_set1_ps(spawnSpread), uniform8(s1),
+                                                        _mm256_set1_ps(spawnRadius)), respawn);
+                a = _mm256_blendv_ps(a, _mm256_mul_ps(vTwoPi, uniform8(s2)), respawn);
+                f = _mm256_blendv_ps(f, _mm256_set1_ps(255.f), respawn);
+                const __m256i s = _mm256_castps_si256(_mm256_blendv_ps(
+                    _mm256_castsi256_ps(s0), _mm256_castsi256_ps(s2), respawn));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(&rng[i]), s);
+            }
+
+            __m256 sn, cs;
+            sincos8(a, sn, cs);
+            _mm256_storeu_ps(&angle[i], a);
+            _mm256_storeu_ps(&radius[i], r);
+            _mm256_storeu_ps(&fade[i], f);
+            _mm256_storeu_ps(&x[i], _mm256_fmadd_ps(cs, r, vCx));
+            _mm256_storeu_ps(&y[i], _mm256_fmadd_ps(sn, r, vCy));
+        }
+        return i;
+    }
+
+    GRAV_TARGET_AVX2 static __m256i xorshift8(__m256i s) {
+        s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 13));
+        s = _mm256_xor_si256(s, _mm256_srli_epi32(s, 17));
+        return _mm256_xor_si256(s, _mm256_slli_epi32(s, 5));
+    }
+    GRAV_TARGET_AVX2 static __m256 uniform8(__m256i s) {
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(s, 8)), _mm256_set1_ps(1.f / 16777216.f));
+    }
+
+    GRAV_TARGET_AVX512 std::size_t updateAvx512(float dt, float cx, float cy, std::size_t first, std::size_t last) {
+        const __m512 vDt = _mm512_set1_ps(dt);
+        const __m512 vInfall = _mm512_set1_ps(infallRate * dt);
+        const __m512 vFade = _mm512_set1_ps(fadeRate * dt);
+        const __m512 vMinR = _mm512_set1_ps(minRadius);
+        const __m512 vTwoPi = _mm512_set1_ps(TWO_PI);
+        const __m512 vInvTwoPi = _mm512_set1_ps(INV_TWO_PI);
+        const __m512 vCx = _mm512_set1_ps(cx), vCy = _mm512_set1_ps(cy);
+
+        std::size_t i = first;
+        for (; i + 16 <= last; i += 16) {
+            __m512 a = _mm512_fmadd_ps(_mm512_loadu_ps(&speed[i]), vDt, _mm512_loadu_ps(&angle[i]));
+            a = _mm512_fnmadd_ps(vTwoPi, _mm512_floor_ps(_mm512_mul_ps(a, vInvTwoPi)), a);
+            __m512 r = _mm512_sub_ps(_mm512_loadu_ps(&radius[i]), vInfall);
+            __m512 f = _mm512_sub_ps(_mm512_loadu_ps(&fade[i]), vFade);
+
+            const __mmask16 respawn = _mm512_cmp_ps_mask(r, vMinR, _CMP_LT_OQ) |
+                                      _mm512_cmp_ps_mask(f, _mm512_setzero_ps(), _CMP_LE_OQ);
+            if (respawn) {
+                const __m512i s0 = _mm512_loadu_si512(&rng[i]);
+                const __m512i s1 = xorshift16(s0);
+                const __m512i s2 = xorshift16(s1);
+                r = _mm512_mask_blend_ps(respawn, r, _mm512_fmadd_ps(_mm512_set1_ps(spawnSpread), uniform16(s1),
+                                                                     _mm512_set1_ps(spawnRadius)));
+                a = _mm512_mask_blend_ps(respawn, a, _mm512_mul_ps(vTwoPi, uniform16(s2)));
+                f = _mm512_mask_blend_ps(respawn, f, _mm512_set1_ps(255.f));
+                _mm512_storeu_si512(&rng[i], _mm512_mask_blend_epi32(respawn, s0, s2));
+            }
+
+            __m512 sn, cs;
+            sincos16(a, sn, cs);
+            _mm512_storeu_ps(&angle[i], a);
+            _mm512_storeu_ps(&radius[i], r);
+            _mm512_storeu_ps(&fade[i], f);
+            _mm512_storeu_ps(&x[i], _mm512_fmadd_ps(cs, r, vCx));
+            _mm512_storeu_ps(&y[i], _mm512_fmadd_ps(sn, r, vCy));
+        }
+        return i;
+    }
+
+    GRAV_TARGET_AVX512 static __m512i xorshift16(__m512i s) {
+        s = _mm512_xor_si512(s, _mm512_slli_epi32(s, 13));
+        s = _mm512_xor_si512(s, _mm512_srli_epi32(s, 17));
+        return _mm512_xor_si512(s, _mm512_slli_epi32(s, 5));
+    }
+    GRAV_TARGET_AVX512 static __m512 uniform16(__m512i s) {
+        return _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(s, 8)), _mm512_set1_ps(1.f / 16777216.f));
+    }
+#endif
+};
+
+} // namespace grav
@@ -0,0 +1,172 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace grav {
+
+// Fork-join scheduler with one deque per thread and work stealing. Owners pop
+// their newest chunk, idle threads steal the oldest chunk of someone else.
+// parallelFor splits a range into chunks that depend only on the range and the
+// grain, never on the thread count, so per-element results are deterministic.
+class TaskScheduler {
+public:
+    static constexpr long MAX_THREADS = 4096;
+
+    // threads counts the calling thread too; 0 means GRAV_THREADS or all cores.
+    explicit TaskScheduler(unsigned threads = 0) {
+        if (threads == 0) {
+            if (const char* env = std::getenv("GRAV_THREADS")) {
+                const long n = std::strtol(env, nullptr, 10);   // not positive, or absurd: ignored
+                if (n > 0 && n <= MAX_THREADS) threads = unsigned(n);
+            }
+            if (threads == 0) threads = std::thread::hardware_concurrency();
+            if (threads == 0) threads = 1;
+        }
+        queues_.reserve(threads);
+        for (unsigned i = 0; i < threads; ++i) queues_.push_back(std::make_unique<Queue>());
+        for (unsigned i = 1; i < threads; ++i) workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~TaskScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    unsigned threadCount() const { return unsigned(queues_.size()); }
+
+    // Process-wide scheduler shared by every simulation loop.
+    static TaskScheduler& instance() {
+        static TaskScheduler scheduler;
+        return scheduler;
+    }
+
+    // Calls fn(begin, end) for consecutive chunks of at most `grain` elements
+    // covering [first, last) and returns once all of them have run.
+    template <typename F>
+    void parallelFor(std::size_t first, std::size_t last, std::size_t grain, F&& fn) {
+        if (last <= first) return;
+        if (grain == 0) grain = 1;
+        const std::size_t chunks = (last - first + grain - 1) / grain;
+        if (chunks == 1 || threadCount() == 1) {
+            for (std::size_t b = first; b < last; b += grain) fn(b, std::min(last, b + grain));
+            return;
+        }
+
+        using Fn = typename std::remove_reference<F>::type;
+        std::atomic<std::size_t> pending(chunks);
+        Task task;
+        task.call = [](void* ctx, std::size_t b, std::size_t e) { (*static_cast<Fn*>(ctx))(b, e); };
+        task.ctx = const_cast<void*>(static_cast<const void*>(&fn));
+        task.pending = &pending;
+
+        // Deal chunks round-robin, starting with our own queue.
+        const unsigned self = currentIndex();
+        const unsigned n = threadCount();
+        queued_.fetch_add(chunks, std::memory_order_release);
+        for (std::size_t c = 0; c < chunks; ++c) {
+            task.begin = first + c * grain;
+            task.end = std::min(last, task.begin + grain);
+            Queue& q = *queues_[(self + c) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(task);
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+        }
+        wake_.notify_all();
+
+        // Help out until our own chunks are done; may run other groups' work too.
+        while (pending.load(std::memory_order_acquire) != 0) {
+            Task t;
+            if (tryPop(self, t) || trySteal(self, t)) run(t);
+            else std::this_thread::yield();
+        }
+    }
+
+private:
+    struct Task {
+        void (*call)(void*, std::size_t, std::size_t) = nullptr;
+        void* ctx = nullptr;
+        std::size_t begin = 0, end = 0;
+        std::atomic<std::size_t>* pending = nullptr;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> queued_{0};
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+
+    static unsigned& threadIndex() {
+        thread_local unsigned index = 0; // threads outside the pool use queue 0
+        return index;
+    }
+    unsigned currentIndex() const { return threadIndex() % threadCount(); }
+
+    static void run(const Task& t) {
+        t.call(t.ctx, t.begin, t.end);
+        t.pending->fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    bool tryPop(unsigned self, Task& out) {
+        Queue& q = *queues_[self];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        out = q.tasks.back();
+        q.tasks.pop_back();
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool trySteal(unsigned self, Task& out) {
+        const unsigned n = threadCount();
+        for (unsigned k = 1; k < n; ++k) {
+            Queue& q = *queues_[(self + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            out = q.tasks.front();
+            q.tasks.pop_front();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(unsigned index) {
+        threadIndex() = index;
+        for (;;) {
+            Task t;
+            if (tryPop(index, t) || trySteal(index, t)) {
+                run(t);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            wake_.wait(lock, [this] { return stop_ || queued_.load(std::memory_order_acquire) > 0; });
+            if (stop_) return;
+        }
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,123 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "task_scheduler.hpp"
+
+namespace grav {
+
+// Motion trails: the last `length` positions of every body, drawn as one
+// line strip that fades out towards the oldest sample.
+//
+// Samples live in a ring of `length` slots shared by all bodies, one x and
+// one y array per slot (slot-major structure of arrays), so push() writes a
+// frame's positions with two contiguous copies and overwrites the oldest
+// slot; nothing moves and nothing is allocated. A body that jumps (a star
+// respawning) starts over with clear(i). Memory is fixed by bodies x length:
+// 8 bytes per sample for the ring plus one 20-byte vertex per sample for the
+// strip, about 180 MB for 64-sample trails on 100k bodies.
+//
+// build() gives every body the same stretch of the strip, so bodies are
+// written in parallel without counting first: oldest to newest sample, the
+// body's current position, and a transparent copy of it that hides the jump
+// to the next body's oldest sample (itself fully faded). Unused slots repeat
+// the last point and draw nothing.
+class Trails {
+public:
+    Trails() = default;
+    Trails(std::size_t bodies, std::size_t length) { reset(bodies, length); }
+
+    std::size_t size() const { return count_.size(); }
+    std::size_t length() const { return length_; }
+    std::size_t memoryBytes() const {
+        return (x_.capacity() + y_.capacity()) * sizeof(float) + count_.capacity() +
+               vertices_.capacity() * sizeof(sf::Vertex);
+    }
+
+    // Drops every trail and makes room for `length` samples on each body.
+    void reset(std::size_t bodies, std::size_t length) {
+        length_ = std::clamp<std::size_t>(length, 2, UINT16_MAX);
+        head_ = 0;
+        x_.assign(bodies * length_, 0.f);
+        y_.assign(bodies * length_, 0.f);
+        count_.assign(bodies, 0);
+        vertices_.resize(bodies * stride());
+    }
+
+    // Changes the body count; bodies below both counts keep their trails,
+    // new ones start empty. Costs a pass over the ring.
+    void resize(std::size_t bodies) {
+        const std::size_t old = size();
+        if (bodies == old) return;
+        std::vector<float> x(bodies * length_, 0.f), y(bodies * length_, 0.f);
+        const std::size_t keep = std::min(bodies, old);
+        for (std::size_t s = 0; s < length_ && keep > 0; ++s) {
+            std::memcpy(&x[s * bodies], &x_[s * old], keep * sizeof(float));
+            std::memcpy(&y[s * bodies], &y_[s * old], keep * sizeof(float));
+        }
+        x_.swap(x);
+        y_.swap(y);
+        count_.resize(bodies, 0);
+        vertices_.resize(bodies * stride());
+    }
+
+    void clear(std::size_t i) { count_[i] = 0; }
+
+    // Appends one sample to every body's trail, dropping its oldest.
+    void push(const float* x, const float* y) {
+        const std::size_t n = size();
+        if (n == 0) return;
+        std::memcpy(x_.data() + head_ * n, x, n * sizeof(float));
+        std::memcpy(y_.data() + head_ * n, y, n * sizeof(float));
+        head_ = (head_ + 1) % length_;
+        for (std::uint16_t& c : count_) c = std::uint16_t(std::min<std::size_t>(c + 1u, length_));
+    }
+
+    // Fills the strip: body i ends at (headX[i], headY[i]) and is drawn in
+    // color(i), fading to transparent at its oldest sample.
+    template <typename ColorFn>
+    void build(const float* headX, const float* headY, ColorFn&& color) {
+        const std::size_t n = size();
+        TaskScheduler::instance().parallelFor(0, n, 4096, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                sf::Vertex* v = &vertices_[i * stride()];
+                const sf::Color c = color(i);
+                const std::size_t count = count_[i];
+                const float fade = float(c.a) / float(count + 1);
+                std::size_t slot = (head_ + length_ - count) % length_;
+                sf::Color faded = c;
+                for (std::size_t k = 0; k < count; ++k) {
+                    faded.a = std::uint8_t(fade * float(k));
+                    v->position = sf::Vector2f(x_[slot * n + i], y_[slot * n + i]);
+                    v->color = faded;
+                    ++v;
+                    if (++slot == length_) slot = 0;
+                }
+                const sf::Vector2f head(headX[i], headY[i]);
+                for (std::size_t k = count; k < stride(); ++k, ++v) {
+                    v->position = head;
+                    v->color = k == count && count > 0 ? c : sf::Color::Transparent;
+                }
+            }
+        });
+    }
+
+    void draw(sf::RenderTarget& target, const sf::RenderStates& states = sf::RenderStates::Default) const {
+        if (!vertices_.empty()) target.draw(vertices_.data(), vertices_.size(), sf::LineStrip, states);
+    }
+
+private:
+    std::size_t length_ = 2;
+    std::size_t head_ = 0;                  // slot the next push() writes
+    std::vector<float> x_, y_;              // slot s of body i at [s * size() + i]
+    std::vector<std::uint16_t> count_;      // samples held per body, up to length_
+    std::vector<sf::Vertex> vertices_;
+
+    std::size_t stride() const { return length_ + 2; }
+};
+
+} // namespace grav
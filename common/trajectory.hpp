@@ -0,0 +1,530 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/types.h>
+#endif
+
+namespace grav {
+
+// Trajectory files: every body's state, frame after frame, for offline analysis.
+//
+// A frame is a time plus one value per body for each field (x, y, vx, ...).
+// Frames are gathered into chunks. Inside a chunk each value is quantised to
+// a multiple of its field's quantum and predicted from the two frames before
+// it (q[t] ~ 2 q[t-1] - q[t-2], exact for uniform motion); the residuals are
+// zigzag varints, a byte or two for a smooth orbit instead of eight. The
+// first frame of every chunk is stored relative to nothing, so chunks decode
+// independently.
+//
+//   header    "GRAVTRAJ", version, field count, bodies, then name and quantum per field
+//   chunk     "CHNK", frame count, first frame, payload bytes, times, residuals
+//   index     offset, first frame and frame count of every chunk
+//   footer    index offset, chunk count, frame count, "GRAVTEND"
+//
+// A file cut short (no footer) is still readable: the reader rebuilds the
+// index by walking the chunk headers.
+struct TrajectoryField {
+    std::string name;
+    double quantum = 1e-6;      // resolution kept; the largest error is half of it
+};
+
+namespace trajectory_detail {
+constexpr std::uint32_t VERSION = 1;
+
+inline std::uint64_t zigzag(std::int64_t v) { return (std::uint64_t(v) << 1) ^ std::uint64_t(v >> 63); }
+inline std::int64_t unzigzag(std::uint64_t v) { return std::int64_t(v >> 1) ^ -std::int64_t(v & 1); }
+
+inline std::uint8_t* putVarint(std::uint8_t* p, std::uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = std::uint8_t(v) | 0x80;
+        v >>= 7;
+    }
+    *p++ = std::uint8_t(v);
+    return p;
+}
+
+inline const std::uint8_t* getVarint(const std::uint8_t* p, const std::uint8_t* end, std::uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        const std::uint8_t b = *p++;
+        v |= std::uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return p;
+    }
+    return nullptr;
+}
+
+// Second-difference prediction from the two previous values; wraps rather
+// than overflows, identically in the writer and the reader.
+inline std::uint64_t predict(std::size_t t, std::int64_t q1, std::int64_t q2) {
+    return t == 0 ? 0 : t == 1 ? std::uint64_t(q1) : 2 * std::uint64_t(q1) - std::uint64_t(q2);
+}
+
+// 64-bit file offsets on every platform.
+inline int seekFile(std::FILE* f, std::int64_t offset, int origin) {
+#if defined(_WIN32)
+    return _fseeki64(f, offset, origin);
+#else
+    return fseeko(f, off_t(offset), origin);
+#endif
+}
+
+inline std::int64_t quantise(double v, double inverseQuantum) {
+    const double q = std::nearbyint(v * inverseQuantum);
+    return q >= 4.6e18 ? std::int64_t(4.6e18) : q <= -4.6e18 ? -std::int64_t(4.6e18) : std::int64_t(q);
+}
+
+struct ChunkHeader {
+    char magic[4];
+    std::uint32_t frames;
+    std::uint64_t firstFrame, payloadBytes;
+};
+
+struct IndexEntry {
+    std::uint64_t offset, firstFrame;
+    std::uint64_t frames;
+};
+
+struct Footer {
+    std::uint64_t indexOffset, chunks, frames;
+    char magic[8];
+};
+} // namespace trajectory_detail
+
+// Command-line switches for trajectory logging:
+//   --trajectory PATH          log every body's position and velocity to PATH
+//   --trajectory-every K       one frame every K physics steps (default 1)
+//   --trajectory-quantum Q     resolution of the stored values (default 1e-6)
+struct TrajectoryOptions {
+    std::string path;
+    std::uint64_t every = 1;
+    double quantum = 1e-6;
+
+    bool enabled() const { return !path.empty(); }
+    bool due(std::uint64_t step) const { return enabled() && step % every == 0; }
+
+    // The named fields, all at the chosen resolution.
+    std::vector<TrajectoryField> fields(std::initializer_list<const char*> names) const {
+        std::vector<TrajectoryField> out;
+        for (const char* name : names) out.push_back({name, quantum});
+        return out;
+    }
+};
+
+inline TrajectoryOptions parseTrajectory(int argc, char** argv) {
+    TrajectoryOptions opt;
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--trajectory") opt.path = argv[++i];
+        else if (arg == "--trajectory-every") opt.every = std::max<std::uint64_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--trajectory-quantum") opt.quantum = std::strtod(argv[++i], nullptr);
+    }
+    return opt;
+}
+
+// Appends frames from the simulation thread and compresses them elsewhere.
+// append() only copies the frame into the open chunk; full chunks go to
+// background threads that encode them and write them out in order. At most
+// `buffers` chunks exist at once, so memory stays bounded: if the encoders
+// fall that far behind, append() waits for one (and counts the wait).
+class TrajectoryWriter {
+public:
+    std::size_t chunkBytes = std::size_t(16) << 20;    // raw frame data per chunk
+    std::size_t maxChunkFrames = 1024;                   // caps seek cost for small systems
+    int threads = 1;                                     // encoder threads
+    int buffers = 4;                                     // chunks in memory at once
+
+    TrajectoryWriter() = default;
+    TrajectoryWriter(const TrajectoryWriter&) = delete;
+    TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+    ~TrajectoryWriter() { close(); }
+
+    bool open(const std::string& path, std::size_t bodies, const std::vector<TrajectoryField>& fields) {
+        using namespace trajectory_detail;
+        close();
+        out_ = std::fopen(path.c_str(), "wb");
+        if (!out_) return false;
+        bodies_ = bodies;
+        fields_ = fields;
+        const std::size_t frameBytes = std::max<std::size_t>(1, bodies * fields.size() * sizeof(double));
+        chunkFrames_ = std::clamp<std::size_t>(chunkBytes / frameBytes, 4, std::max<std::size_t>(4, maxChunkFrames));
+        frames_ = 0;
+        index_.clear();
+        error_ = false;
+        rawBytes_ = 0;
+        waitSeconds_ = 0.0;
+
+        char magic[8];
+        std::memcpy(magic, "GRAVTRAJ", 8);
+        const std::uint32_t version = VERSION, count = std::uint32_t(fields.size());
+        const std::uint64_t n = bodies;
+        bool ok = std::fwrite(magic, 8, 1, out_) == 1 && std::fwrite(&version, 4, 1, out_) == 1 &&
+                  std::fwrite(&count, 4, 1, out_) == 1 && std::fwrite(&n, 8, 1, out_) == 1;
+        for (const TrajectoryField& f : fields) {
+            char name[24] = {};
+            std::strncpy(name, f.name.c_str(), sizeof(name) - 1);
+            ok = ok && std::fwrite(name, sizeof(name), 1, out_) == 1 && std::fwrite(&f.quantum, 8, 1, out_) == 1;
+        }
+        written_ = std::uint64_t(std::ftell(out_));
+        if (!ok) {
+            std::fclose(out_);
+            out_ = nullptr;
+            return false;
+        }
+
+        free_.clear();
+        for (int i = 0; i < std::max(2, buffers); ++i) free_.push_back(std::make_unique<Chunk>());
+        closing_ = false;
+        nextWrite_ = submitted_ = 0;
+        for (int i = 0; i < std::max(1, threads); ++i) workers_.emplace_back([this] { encodeLoop(); });
+        return true;
+    }
+
+    bool isOpen() const { return out_ != nullptr; }
+    std::uint64_t frames() const { return frames_; }
+    std::uint64_t rawBytes() const { return rawBytes_; }
+    std::uint64_t bytesWritten() const { return written_; }
+    double waitSeconds() const { return waitSeconds_; }   // time append() spent blocked on the encoders
+    bool failed() const { return error_; }
+
+    // Copies one frame: fields[f][i] is field f of body i.
+    void append(double time, const double* const* fields) {
+        if (!out_) return;
+        if (!current_) current_ = takeBuffer();
+        Chunk& c = *current_;
+        if (c.frames == 0) {
+            c.firstFrame = frames_;
+            c.times.resize(chunkFrames_);
+            c.values.resize(chunkFrames_ * fields_.size() * bodies_);
+        }
+        c.times[c.frames] = time;
+        for (std::size_t f = 0; f < fields_.size(); ++f)
+            std::memcpy(&c.values[(c.frames * fields_.size() + f) * bodies_], fields[f], bodies_ * sizeof(double));
+        ++c.frames;
+        ++frames_;
+        rawBytes_ += bodies_ * fields_.size() * sizeof(double) + sizeof(double);
+        if (c.frames == chunkFrames_) submit();
+    }
+
+    void append(double time, std::initializer_list<const double*> fields) { append(time, fields.begin()); }
+
+    // Encodes what is left, writes the chunk index and closes the file.
+    bool close() {
+        using namespace trajectory_detail;
+        if (!out_) return false;
+        if (current_ && current_->frames > 0) submit();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closing_ = true;
+        }
+        queued_.notify_all();
+        for (std::thread& t : workers_) t.join();
+        workers_.clear();
+        current_.reset();
+        queue_.clear();
+        free_.clear();
+
+        Footer footer;
+        footer.indexOffset = written_;
+        footer.chunks = index_.size();
+        footer.frames = frames_;
+        std::memcpy(footer.magic, "GRAVTEND", 8);
+        bool ok = !error_;
+        if (!index_.empty()) ok = ok && std::fwrite(index_.data(), sizeof(IndexEntry), index_.size(), out_) == index_.size();
+        ok = ok && std::fwrite(&footer, sizeof(footer), 1, out_) == 1;
+        written_ += index_.size() * sizeof(IndexEntry) + sizeof(footer);
+        ok = std::fclose(out_) == 0 && ok;
+        out_ = nullptr;
+        return ok;
+    }
+
+private:
+    struct Chunk {
+        std::uint64_t sequence = 0, firstFrame = 0;
+        std::size_t frames = 0;
+        std::vector<double> times;
+        std::vector<double> values;         // [frame][field][body]
+        std::vector<std::uint8_t> encoded;
+    };
+
+    std::FILE* out_ = nullptr;
+    std::size_t bodies_ = 0, chunkFrames_ = 4;
+    std::vector<TrajectoryField> fields_;
+    std::uint64_t frames_ = 0, rawBytes_ = 0, written_ = 0, submitted_ = 0;
+    double waitSeconds_ = 0.0;
+    std::unique_ptr<Chunk> current_;
+    std::vector<trajectory_detail::IndexEntry> index_;
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable queued_, released_, turn_;
+    std::deque<std::unique_ptr<Chunk>> queue_;
+    std::vector<std::unique_ptr<Chunk>> free_;
+    bool closing_ = false, error_ = false;
+    std::uint64_t nextWrite_ = 0;
+
+    std::unique_ptr<Chunk> takeBuffer() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            const auto start = std::chrono::steady_clock::now();
+            released_.wait(lock, [&] { return !free_.empty(); });
+            waitSeconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::unique_ptr<Chunk> c = std::move(free_.back());
+        free_.pop_back();
+        c->frames = 0;
+        return c;
+    }
+
+    void submit() {
+        current_->sequence = submitted_++;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(current_));
+        }
+        queued_.notify_one();
+    }
+
+    void encodeLoop() {
+        using namespace trajectory_detail;
+        for (;;) {
+            std::unique_ptr<Chunk> c;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                queued_.wait(lock, [&] { return closing_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                c = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            encode(*c);
+
+            // Chunks are written in the order they were filled.
+            std::unique_lock<std::mutex> lock(mutex_);
+            turn_.wait(lock, [&] { return nextWrite_ == c->sequence; });
+            ChunkHeader header;
+            std::memcpy(header.magic, "CHNK", 4);
+            header.frames = std::uint32_t(c->frames);
+            header.firstFrame = c->firstFrame;
+            header.payloadBytes = c->frames * sizeof(double) + c->encoded.size();
+            const bool ok = std::fwrite(&header, sizeof(header), 1, out_) == 1 &&
+                            std::fwrite(c->times.data(), sizeof(double), c->frames, out_) == c->frames &&
+                            std::fwrite(c->encoded.data(), 1, c->encoded.size(), out_) == c->encoded.size() &&
+                            std::fflush(out_) == 0;   // whole chunks on disk survive a crash
+            if (!ok) error_ = true;
+            index_.push_back({written_, c->firstFrame, c->frames});
+            written_ += sizeof(header) + header.payloadBytes;
+            ++nextWrite_;
+            free_.push_back(std::move(c));
+            lock.unlock();
+            turn_.notify_all();
+            released_.notify_one();
+        }
+    }
+
+    // Field by field, body by body: quantise, predict from the two previous
+    // frames, store the zigzag varint of the miss.
+    void encode(Chunk& c) const {
+        using namespace trajectory_detail;
+        const std::size_t n = bodies_, nf = fields_.size(), stride = nf * n;
+        c.encoded.resize(c.frames * stride * 10);
+        std::uint8_t* p = c.encoded.data();
+        for (std::size_t f = 0; f < nf; ++f) {
+            const double inverse = 1.0 / fields_[f].quantum;
+            const double* base = &c.values[f * n];
+            for (std::size_t i = 0; i < n; ++i) {
+                std::int64_t q1 = 0, q2 = 0;
+                for (std::size_t t = 0; t < c.frames; ++t) {
+                    const std::int64_t q = quantise(base[t * stride + i], inverse);
+                    p = putVarint(p, zigzag(std::int64_t(std::uint64_t(q) - predict(t, q1, q2))));
+                    q2 = q1;
+                    q1 = q;
+                }
+            }
+        }
+        c.encoded.resize(std::size_t(p - c.encoded.data()));
+    }
+};
+
+// Random access to a trajectory file. frame() finds the chunk through the
+// index and decodes it whole; the last decoded chunk is kept, so reading
+// frames in order decodes each chunk once.
+class TrajectoryReader {
+public:
+    bool open(const std::string& path) {
+        using namespace trajectory_detail;
+        close();
+        in_ = std::fopen(path.c_str(), "rb");
+        if (!in_) return false;
+        char magic[8];
+        std::uint32_t version = 0, count = 0;
+        std::uint64_t n = 0;
+        if (std::fread(magic, 8, 1, in_) != 1 || std::memcmp(magic, "GRAVTRAJ", 8) != 0 ||
+            std::fread(&version, 4, 1, in_) != 1 || version != VERSION || std::fread(&count, 4, 1, in_) != 1 ||
+            std::fread(&n, 8, 1, in_) != 1)
+            return fail();
+        bodies_ = std::size_t(n);
+        fields_.resize(count);
+        for (TrajectoryField& f : fields_) {
+            char name[24];
+            if (std::fread(name, sizeof(name), 1, in_) != 1 || std::fread(&f.quantum, 8, 1, in_) != 1) return fail();
+            f.name.assign(name, strnlen(name, sizeof(name)));
+        }
+        const long dataStart = std::ftell(in_);
+        if (seekFile(in_, 0, SEEK_END) != 0) return fail();
+        size_ = std::uint64_t(std::ftell(in_));
+        if (!readIndex() && !scanIndex(std::uint64_t(dataStart))) return fail();
+        return true;
+    }
+
+    void close() {
+        if (in_) std::fclose(in_);
+        in_ = nullptr;
+        index_.clear();
+        cached_ = NO_CHUNK;
+        frames_ = 0;
+    }
+
+    bool isOpen() const { return in_ != nullptr; }
+    std::size_t bodies() const { return bodies_; }
+    std::uint64_t frames() const { return frames_; }
+    const std::vector<TrajectoryField>& fields() const { return fields_; }
+
+    // Field index by name, or -1.
+    int field(const std::string& name) const {
+        for (std::size_t f = 0; f < fields_.size(); ++f)
+            if (fields_[f].name == name) return int(f);
+        return -1;
+    }
+
+    // Time of frame `frame` and its values, out[f * bodies() + i] for field f
+    // of body i. False past the end or on a damaged chunk.
+    bool frame(std::uint64_t frame, double& time, std::vector<double>& out) {
+        if (frame >= frames_) return false;
+        const auto it = std::upper_bound(index_.begin(), index_.end(), frame,
+                                         [](std::uint64_t f, const trajectory_detail::IndexEntry& e) { return f < e.firstFrame; });
+        if (it == index_.begin()) return false;
+        const std::size_t chunk = std::size_t(it - index_.begin()) - 1;
+        if (chunk != cached_ && !decode(chunk)) return false;
+        const std::size_t t = std::size_t(frame - index_[chunk].firstFrame);
+        if (t >= times_.size()) return false;
+        const std::size_t stride = fields_.size() * bodies_;
+        time = times_[t];
+        out.assign(values_.begin() + std::ptrdiff_t(t * stride), values_.begin() + std::ptrdiff_t((t + 1) * stride));
+        return true;
+    }
+
+private:
+    std::FILE* in_ = nullptr;
+    std::size_t bodies_ = 0;
+    std::uint64_t frames_ = 0;
+    std::uint64_t size_ = 0;                // file bytes, bounding what a damaged header can ask for
+    std::vector<TrajectoryField> fields_;
+    std::vector<trajectory_detail::IndexEntry> index_;
+    static constexpr std::size_t NO_CHUNK = SIZE_MAX;  // index_ never holds that many chunks
+    std::size_t cached_ = NO_CHUNK;
+    std::vector<double> times_, values_;
+    std::vector<std::uint8_t> payload_;
+
+    bool fail() {
+        close();
+        return false;
+    }
+
+    bool seek(std::uint64_t offset) { return trajectory_detail::seekFile(in_, std::int64_t(offset), SEEK_SET) == 0; }
+
+    bool readIndex() {
+        using namespace trajectory_detail;
+        Footer footer;
+        if (seekFile(in_, -std::int64_t(sizeof(footer)), SEEK_END) != 0 || std::fread(&footer, sizeof(footer), 1, in_) != 1 ||
+            std::memcmp(footer.magic, "GRAVTEND", 8) != 0 || footer.indexOffset > size_ ||
+            footer.chunks > (size_ - footer.indexOffset) / sizeof(IndexEntry) || !seek(footer.indexOffset))
+            return false;
+        index_.resize(std::size_t(footer.chunks));
+        if (!index_.empty() && std::fread(index_.data(), sizeof(IndexEntry), index_.size(), in_) != index_.size())
+            return false;
+        // The chunks must tile [0, frames) in order, as frame() looks them up.
+        std::uint64_t next = 0;
+        for (const IndexEntry& e : index_) {
+            if (e.firstFrame != next || e.frames == 0 || e.frames > footer.frames - next) return false;
+            next += e.frames;
+        }
+        if (next != footer.frames) return false;
+        frames_ = footer.frames;
+        return true;
+    }
+
+    // Walks the chunk headers of a file whose writer never closed it.
+    bool scanIndex(std::uint64_t offset) {
+        using namespace trajectory_detail;
+        index_.clear();
+        frames_ = 0;
+        ChunkHeader header;
+        while (seek(offset) && std::fread(&header, sizeof(header), 1, in_) == 1 &&
+               std::memcmp(header.magic, "CHNK", 4) == 0 && header.firstFrame == frames_) {
+            // A chunk whose payload was cut short ends the usable file.
+            if (!seek(offset + sizeof(header) + header.payloadBytes - 1) || std::fgetc(in_) == EOF) break;
+            index_.push_back({offset, header.firstFrame, header.frames});
+            frames_ += header.frames;
+            offset += sizeof(header) + header.payloadBytes;
+        }
+        return true;
+    }
+
+    bool decode(std::size_t chunk) {
+        using namespace trajectory_detail;
+        cached_ = NO_CHUNK;                 // until this chunk has decoded whole
+        const IndexEntry& entry = index_[chunk];
+        ChunkHeader header;
+        if (!seek(entry.offset) || std::fread(&header, sizeof(header), 1, in_) != 1) return false;
+        const std::size_t frames = header.frames, n = bodies_, nf = fields_.size(), stride = nf * n;
+        // The chunk must be the one indexed and fit in the file, with room for
+        // its times and at least a byte per value, before anything is sized
+        // from it.
+        const std::uint64_t timeBytes = std::uint64_t(frames) * sizeof(double);
+        if (header.frames != entry.frames || header.payloadBytes > size_ - entry.offset - sizeof(header) ||
+            header.payloadBytes < timeBytes || (stride > 0 && (header.payloadBytes - timeBytes) / stride < frames))
+            return false;
+        times_.resize(frames);
+        values_.resize(frames * stride);
+        payload_.resize(std::size_t(header.payloadBytes - timeBytes));
+        if (std::fread(times_.data(), sizeof(double), frames, in_) != frames ||
+            std::fread(payload_.data(), 1, payload_.size(), in_) != payload_.size())
+            return false;
+
+        const std::uint8_t* p = payload_.data();
+        const std::uint8_t* end = p + payload_.size();
+        for (std::size_t f = 0; f < nf; ++f) {
+            const double quantum = fields_[f].quantum;
+            for (std::size_t i = 0; i < n; ++i) {
+                std::int64_t q1 = 0, q2 = 0;
+                for (std::size_t t = 0; t < frames; ++t) {
+                    std::uint64_t z;
+                    if (!(p = getVarint(p, end, z))) return false;
+                    const std::int64_t q = std::int64_t(predict(t, q1, q2) + std::uint64_t(unzigzag(z)));
+                    values_[t * stride + f * n + i] = double(q) * quantum;
+                    q2 = q1;
+                    q1 = q;
+                }
+            }
+        }
+        cached_ = chunk;
+        return true;
+    }
+};
+
+} // namespace grav
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+namespace grav {
+
+// Lock-free single-producer/single-consumer hand-off of the latest value.
+// The writer fills its back slot and publishes it by swapping with the shared
+// middle slot; the reader swaps the middle slot in whenever it is fresh. Neither
+// side ever waits, and a slow reader simply skips intermediate values.
+//
+// ReaderSlots > 1 lets the reader keep older values alive as well (e.g. the
+// previous state for interpolation) at the cost of one extra slot each.
+template <typename T, std::size_t ReaderSlots = 1>
+class TripleBuffer {
+public:
+    static constexpr std::size_t SLOTS = ReaderSlots + 2;
+
+    TripleBuffer() {
+        for (std::size_t i = 0; i < ReaderSlots; ++i) reader_[i] = unsigned(i + 2);
+    }
+
+    explicit TripleBuffer(const T& initial) : TripleBuffer() {
+        for (auto& s : slots_) s.value = initial;
+    }
+
+    // Writer side.
+    T& write() { return slots_[back_].value; }
+
+    void publish() {
+        const unsigned old = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+        back_ = old & INDEX;
+    }
+
+    // Reader side: pulls the newest published value in; false if nothing new.
+    bool update() {
+        if (!(middle_.load(std::memory_order_relaxed) & FRESH)) return false;
+        const unsigned oldest = reader_[ReaderSlots - 1];
+        for (std::size_t i = ReaderSlots - 1; i > 0; --i) reader_[i] = reader_[i - 1];
+        reader_[0] = middle_.exchange(oldest, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // age 0 is the newest value the reader holds, age 1 the one before, ...
+    const T& read(std::size_t age = 0) const { return slots_[reader_[age]].value; }
+
+private:
+    static constexpr unsigned FRESH = 0x100;
+    static constexpr unsigned INDEX = 0xff;
+
+    struct alignas(64) Slot {
+        T value{};
+    };
+
+    Slot slots_[SLOTS];
+    alignas(64) std::atomic<unsigned> middle_{1};
+    alignas(64) unsigned back_ = 0;
+    alignas(64) unsigned reader_[ReaderSlots];
+};
+
+} // namespace grav
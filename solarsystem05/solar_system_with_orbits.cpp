@@ -3,6 +3,19 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <iostream>
+
+#include "../common/asset_cache.hpp"
+#include "../common/headless.hpp"
+#include "../common/kepler.hpp"
+#include "../common/orbit_paths.hpp"
+#include "../common/physics_thread.hpp"
+#include "../common/trajectory.hpp"
+#include "../common/profiler_overlay.hpp"
+#include "../common/scenario.hpp"
+#include "../common/triple_buffer.hpp"
+
+constexpr double PHYSICS_DT = 0.001; // seconds per physics step (1000 Hz)
 
 struct Planet {
     std::string name;
@@ -10,102 +23,160 @@ struct Planet {
     float orbitRadius;      // Visual orbit radius
     float orbitalPeriod;    // In Earth years
     sf::Color color;
-    float angle = 0.0f;     // Current position in orbit (radians)
 
     sf::CircleShape shape;
     sf::Text label;
     sf::Text info;
 };
 
-int main() {
+int main(int argc, char** argv) {
+    const grav::HeadlessOptions headless = grav::parseHeadless(argc, argv);
+    const grav::ProfileOptions profile = grav::parseProfile(argc, argv);
+    const grav::TrajectoryOptions trajectory = grav::parseTrajectory(argc, argv);
+
+    // --scenario picks the bodies: the first is the Sun, its children the planets
+    const std::string scenarioPath = grav::parseScenario(argc, argv, "../scenarios/solar_system.txt");
+    grav::Scenario scenario;
+    std::string error;
+    if (!grav::loadScenario(scenarioPath, scenario, error) || scenario.size() == 0) {
+        std::cerr << (error.empty() ? scenarioPath + ": no bodies" : error) << "\n";
+        return 1;
+    }
+    std::vector<Planet> planets;
+    grav::KeplerOrbits orbits;
+    for (std::uint32_t i : scenario.children(0)) {
+        planets.push_back({std::string(scenario.name(i)), scenario.radius[i], scenario.orbit[i],
+                           float(scenario.period[i] / 365.25), sf::Color(scenario.color[i])});
+        orbits.add(scenario.orbit[i], scenario.eccentricity[i], scenario.period[i], scenario.angle[i],
+                   scenario.inclination[i], scenario.node[i], scenario.periapsis[i], scenario.precession[i]);
+    }
+
+    float simulationSpeed = 1.0f; // Default time multiplier
+    grav::TripleBuffer<float> speedControl(simulationSpeed);
+
+    // The orbits are closed-form (common/kepler.hpp), so the physics thread only
+    // keeps the clock, in simulated days (50 per second at speed 1). --day D
+    // starts D days in, which costs no more than starting at 0.
+    double days = 0.0;
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == "--day") days = std::strtod(argv[i + 1], nullptr);
+
+    // --trajectory logs the planets from the physics thread, with its own copy
+    // of the orbits; the velocities are the exact derivative of the ellipses.
+    grav::TrajectoryWriter trajectoryLog;
+    if (trajectory.enabled() &&
+        !trajectoryLog.open(trajectory.path, planets.size(), trajectory.fields({"x", "y", "vx", "vy"}))) {
+        std::cerr << "Cannot write trajectory " << trajectory.path << "\n";
+        return 1;
+    }
+    std::uint64_t steps = 0;
+    grav::KeplerOrbits logOrbits = orbits;
+    logOrbits.velocities = true;
+    std::vector<double> x(planets.size()), y(planets.size()), vx(planets.size()), vy(planets.size());
+
+    auto step = [&](double h) {
+        speedControl.update();
+        days += h * speedControl.read() * 50.0;
+        if (trajectory.due(++steps)) {
+            logOrbits.propagate(days);
+            x.assign(logOrbits.x.begin(), logOrbits.x.end());
+            y.assign(logOrbits.y.begin(), logOrbits.y.end());
+            vx.assign(logOrbits.vx.begin(), logOrbits.vx.end());
+            vy.assign(logOrbits.vy.begin(), logOrbits.vy.end());
+            trajectoryLog.append(days, {x.data(), y.data(), vx.data(), vy.data()});
+        }
+    };
+
+    if (headless.enabled)
+        return grav::runHeadless("solar_system_with_orbits", headless, PHYSICS_DT, planets.size(), step, [&](std::ostream& os) {
+            orbits.propagate(days);
+            os << "day " << days << "\n";
+            for (std::size_t i = 0; i < planets.size(); ++i)
+                os << planets[i].name << " " << orbits.x[i] << " " << orbits.y[i] << "\n";
+        });
+
     sf::RenderWindow window(sf::VideoMode(1400, 1000), "Solar System Simulation");
     window.setFramerateLimit(60);
 
-    sf::Font font;
-    if (!font.loadFromFile("/usr/share/fonts/truetype/dejavu/DejaVuSans-Bold.ttf"))
+    const sf::Font* font = grav::AssetCache::instance().font("/usr/share/fonts/truetype/dejavu/DejaVuSans-Bold.ttf");
+    if (!font)
         return -1;
+    grav::AssetCache::instance().report(std::clog);
 
     sf::Vector2f sunPos(window.getSize().x / 2.f, window.getSize().y / 2.f);
 
-    std::vector<Planet> planets = {
-        {"Mercury",  4.f,   60.f,   0.24f, sf::Color(200, 200, 200)},
-        {"Venus",    6.f,   90.f,   0.62f, sf::Color(255, 165, 0)},
-        {"Earth",    7.f,  120.f,   1.00f, sf::Color::Blue},
-        {"Mars",     5.f,  150.f,   1.88f, sf::Color(255, 80, 80)},
-        {"Jupiter", 13.f,  200.f,  11.86f, sf::Color(255, 200, 150)},
-        {"Saturn",  11.f,  260.f,  29.45f, sf::Color(255, 230, 150)},
-        {"Uranus",   9.f,  310.f,  84.02f, sf::Color(150, 255, 255)},
-        {"Neptune",  9.f,  360.f, 164.8f,  sf::Color(100, 150, 255)},
-        {"Pluto",    3.f,  400.f, 248.0f,  sf::Color(180, 180, 200)}
-    };
-
     // Setup visuals
     for (auto& p : planets) {
         p.shape.setRadius(p.radius);
         p.shape.setOrigin(p.radius, p.radius);
         p.shape.setFillColor(p.color);
 
-        p.label.setFont(font);
+        p.label.setFont(*font);
         p.label.setCharacterSize(12);
         p.label.setFillColor(sf::Color::White);
         p.label.setString(p.name);
 
         std::stringstream ss;
         ss << "Period: " << p.orbitalPeriod << "y";
-        p.info.setFont(font);
+        p.info.setFont(*font);
         p.info.setCharacterSize(10);
         p.info.setFillColor(sf::Color(180, 180, 180));
         p.info.setString(ss.str());
     }
 
     // Sun
-    sf::CircleShape sun(30.f);
-    sun.setOrigin(30.f, 30.f);
+    sf::CircleShape sun(scenario.radius[0]);
+    sun.setOrigin(scenario.radius[0], scenario.radius[0]);
     sun.setPosition(sunPos);
-    sun.setFillColor(sf::Color::Yellow);
-
-    // Orbit rings
-    std::vector<sf::CircleShape> orbits;
-    for (const auto& p : planets) {
-        sf::CircleShape orbit(p.orbitRadius);
-        orbit.setOrigin(p.orbitRadius, p.orbitRadius);
-        orbit.setPosition(sunPos);
-        orbit.setFillColor(sf::Color::Transparent);
-        orbit.setOutlineColor(sf::Color(80, 80, 80));
-        orbit.setOutlineThickness(1);
-        orbits.push_back(orbit);
-    }
+    sun.setFillColor(sf::Color(scenario.color[0]));
 
-    float simulationSpeed = 1.0f; // Default time multiplier
-    sf::Clock clock;
+    // Orbit paths, built once into one vertex buffer around the Sun and turned
+    // with the planets where the scenario gives a precession
+    grav::OrbitPaths orbitPaths;
+    const std::size_t aroundSun = orbitPaths.addGroup(sunPos);
+    for (std::size_t i = 0; i < orbits.size(); ++i)
+        orbitPaths.add(aroundSun, orbits, i, sf::Color(80, 80, 80));
+
+    grav::PhysicsThread<double> physics(PHYSICS_DT, step, [&](double& out) { out = days; });
+    physics.setRate(1.0 / PHYSICS_DT);
+    physics.start();
+    profile.apply();
+    grav::ProfilerOverlay overlay(profile.overlay);
 
     while (window.isOpen()) {
+        grav::ProfilePhases phase("events");
         sf::Event e;
         while (window.pollEvent(e)) {
+            overlay.handle(e);
             if (e.type == sf::Event::Closed)
                 window.close();
             if (e.type == sf::Event::KeyPressed) {
                 if (e.key.code == sf::Keyboard::Up) simulationSpeed *= 1.2f;
                 if (e.key.code == sf::Keyboard::Down) simulationSpeed /= 1.2f;
+                speedControl.write() = simulationSpeed;
+                speedControl.publish();
             }
         }
 
-        float dt = clock.restart().asSeconds();
+        // Evaluate the orbits at the time blended from the two latest physics snapshots
+        phase.next("scene");
+        physics.poll();
+        const double prev = physics.previous().state, curr = physics.current().state;
+        const double now = prev + (curr - prev) * physics.alpha();
+        orbits.propagate(now);
+        orbitPaths.setTime(now);
 
         window.clear(sf::Color::Black);
         window.draw(sun);
 
-        // Draw orbits
-        for (const auto& orbit : orbits)
-            window.draw(orbit);
+        // Draw orbits, one draw call for all of them
+        orbitPaths.draw(window);
 
         // Update planets
-        for (auto& p : planets) {
-            float angularSpeed = 2 * 3.14159f / (p.orbitalPeriod * 365.25f); // radians/day
-            p.angle += angularSpeed * dt * simulationSpeed * 50.0f;
-
-            float x = sunPos.x + std::cos(p.angle) * p.orbitRadius;
-            float y = sunPos.y + std::sin(p.angle) * p.orbitRadius;
+        for (std::size_t i = 0; i < planets.size(); ++i) {
+            auto& p = planets[i];
+            float x = sunPos.x + orbits.x[i];
+            float y = sunPos.y + orbits.y[i];
 
             p.shape.setPosition(x, y);
             p.label.setPosition(x - p.label.getLocalBounds().width / 2, y - p.radius - 20);
@@ -116,8 +187,11 @@ int main() {
             window.draw(p.info);
         }
 
+        phase.next("display");
+        overlay.draw(window);
         window.display();
     }
 
+    profile.writeTrace(std::clog);
     return 0;
 }
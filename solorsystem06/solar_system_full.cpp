@@ -1,169 +1,325 @@
 #include <SFML/Graphics.hpp>
+#include <algorithm>
 #include <cmath>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <cstdlib>
+
+#include "../common/circle_batch.hpp"
+#include "../common/asset_cache.hpp"
+#include "../common/bvh.hpp"
+#include "../common/force_bench.hpp"
+#include "../common/headless.hpp"
+#include "../common/nbody.hpp"
+#include "../common/orbit_paths.hpp"
+#include "../common/physics_thread.hpp"
+#include "../common/trajectory.hpp"
+#include "../common/profiler_overlay.hpp"
+#include "../common/scenario.hpp"
+#include "../common/scene_graph.hpp"
+#include "../common/triple_buffer.hpp"
+
+constexpr double PI = 3.14159265358979;
+
+using SolarSystem = grav::NBodySystem<double, 2>;
+
+// Simulated body positions handed from the physics thread to the renderer
+struct Snapshot {
+    std::vector<double> x, y;
+};
 
+// How one body is drawn. Body i of the scenario is node i of the scene graph
+// and body i of the simulation.
 struct CelestialBody {
     float radius;               // visual size
-    float orbitRadius;          // distance from parent
-    float orbitalPeriod;        // in Earth days or years (will normalize)
+    float orbitRadius;          // distance from parent on screen
     sf::Color color;
-    float initialAngle;         // starting angle in radians
-    sf::Vector2f position;
-
-    sf::CircleShape shape;
-    sf::CircleShape ring;       // for planets with rings
     bool hasRings = false;
+    double displayScale = 1.0;  // screen pixels per simulated unit of distance from the parent
 
-    CelestialBody* parent = nullptr;
-    std::vector<CelestialBody> moons;
-
-    // Initialize shape and ring
-    void init() {
-        shape.setRadius(radius);
-        shape.setOrigin(radius, radius);
-        shape.setFillColor(color);
-
-        if (hasRings) {
-            ring.setRadius(radius * 1.7f);
-            ring.setOrigin(ring.getRadius(), ring.getRadius());
-            ring.setFillColor(sf::Color::Transparent);
-            ring.setOutlineThickness(radius * 0.15f);
-            ring.setOutlineColor(sf::Color(200, 180, 100, 150));
-        }
+    float ringRadius() const { return radius * 1.7f; }
+    float ringThickness() const { return radius * 0.15f; }
+};
+
+// Adds scenario body i, starting on a circular orbit around its parent (or at
+// rest at the origin if it has none), and returns its display scale. The period
+// fixes the true orbital radius through Kepler's third law; the orbit column
+// only says how far from the parent the body is drawn, since moon orbits are
+// not to scale.
+double addToSimulation(SolarSystem& sim, const grav::Scenario& scenario, std::size_t i, double gmSun) {
+    const std::uint32_t p = scenario.parent[i];
+    const double mass = scenario.state.mass[i];
+    if (p == grav::Scenario::NO_PARENT || scenario.period[i] <= 0.0) {
+        double origin[2] = {0.0, 0.0};
+        sim.bodies.add(origin, origin, gmSun * mass);
+        return 1.0;
+    }
+    const double periodDays = scenario.period[i], angle = scenario.angle[i];
+    const double gm = gmSun * (scenario.state.mass[p] + mass);
+    const double a = std::cbrt(gm * periodDays * periodDays / (4.0 * PI * PI));
+    const double v = std::sqrt(gm / a);
+    const auto& b = sim.bodies;
+    double pos[2] = {b.pos[0][p] + a * std::cos(angle), b.pos[1][p] + a * std::sin(angle)};
+    double vel[2] = {b.vel[0][p] - v * std::sin(angle), b.vel[1][p] + v * std::cos(angle)};
+    sim.bodies.add(pos, vel, gmSun * mass);
+    return scenario.orbit[i] > 0.f ? scenario.orbit[i] / a : 1.0;
+}
+
+// The scenario's bodies as scene graph nodes, in file order: the file lists
+// parents before their moons, which is the order the graph needs.
+std::vector<CelestialBody> buildScene(const grav::Scenario& scenario, const std::vector<double>& displayScale,
+                                      grav::SceneGraph& scene) {
+    std::vector<CelestialBody> bodies;
+    bodies.reserve(scenario.size());
+    scene.clear();
+    scene.reserve(scenario.size());
+    for (std::uint32_t i = 0; i < scenario.size(); ++i) {
+        const std::uint32_t p = scenario.parent[i];
+        scene.add(p == grav::Scenario::NO_PARENT ? grav::SceneGraph::NO_PARENT : p);
+        bodies.push_back({scenario.radius[i], scenario.orbit[i], sf::Color(scenario.color[i]), scenario.rings[i] != 0,
+                          displayScale[i]});
+    }
+    return bodies;
+}
 
-        for (auto& moon : moons)
-            moon.init();
+// Moves every node to its body's simulated offset from the parent; roots are
+// placed relative to the centre of the window.
+void placeBodies(grav::SceneGraph& scene, const std::vector<CelestialBody>& bodies, const Snapshot& sim,
+                 const sf::Vector2f& sunPos) {
+    for (std::uint32_t i = 0; i < bodies.size(); ++i) {
+        const std::uint32_t p = scene.parent(i);
+        const bool root = p == grav::SceneGraph::NO_PARENT;
+        const double dx = sim.x[i] - (root ? 0.0 : sim.x[p]);
+        const double dy = sim.y[i] - (root ? 0.0 : sim.y[p]);
+        scene.setLocal(i, (root ? sunPos.x : 0.f) + float(dx * bodies[i].displayScale),
+                       (root ? sunPos.y : 0.f) + float(dy * bodies[i].displayScale));
     }
+}
 
-    // Calculate position exactly by angle based on elapsed time, no drift
-    void updatePosition(const sf::Vector2f& parentPos, float elapsedDays) {
-        float periodDays = orbitalPeriod;
-        if (parent == nullptr)
-            periodDays *= 365.25f; // planets have period in years
+// Bounding-volume hierarchy over the bodies, refitted every frame, so that
+// only what the window shows gets batched.
+struct SceneCulling {
+    grav::CircleBvh tree;
+    std::vector<std::uint32_t> visible;
+};
 
-        float angle = initialAngle + 2.f * 3.14159265f * (elapsedDays / periodDays);
-        float x = parentPos.x + std::cos(angle) * orbitRadius;
-        float y = parentPos.y + std::sin(angle) * orbitRadius;
-        position = sf::Vector2f(x, y);
-        shape.setPosition(position);
+// Orbit rings as static geometry: one group per body with moons, centred on
+// that body every frame. groupCentre[g] is the scene node group g follows.
+struct OrbitRings {
+    grav::OrbitPaths paths;
+    std::vector<std::uint32_t> groupCentre;
+};
 
-        if (hasRings)
-            ring.setPosition(position);
+void buildOrbitRings(const grav::SceneGraph& scene, const std::vector<CelestialBody>& bodies, OrbitRings& rings) {
+    std::vector<std::uint32_t> groupOf(bodies.size(), grav::SceneGraph::NO_PARENT);
+    for (std::uint32_t i = 0; i < bodies.size(); ++i) {
+        const std::uint32_t p = scene.parent(i);
+        if (p == grav::SceneGraph::NO_PARENT) continue;
+        if (groupOf[p] == grav::SceneGraph::NO_PARENT) {
+            groupOf[p] = std::uint32_t(rings.paths.addGroup());
+            rings.groupCentre.push_back(p);
+        }
+        rings.paths.addCircle(groupOf[p], bodies[i].orbitRadius, sf::Color(100, 100, 100, 100));
+    }
+}
 
-        for (auto& moon : moons)
-            moon.updatePosition(position, elapsedDays);
+// Appends the visible planetary rings and bodies to their layers; each layer
+// is drawn with a single draw call once everything has been added. Bodies
+// under a pixel become points and crowds of them one splat.
+void batchBodies(const grav::SceneGraph& scene, const std::vector<CelestialBody>& bodies, SceneCulling& culling,
+                 const sf::FloatRect& screen, grav::CircleBatch& ringLayer, grav::CircleBatch& bodyLayer) {
+    using Circle = grav::CircleBvh::Circle;
+    const float zoom = scene.zoom();
+    culling.tree.update(bodies.size(), [&](std::uint32_t i) {
+        const CelestialBody& b = bodies[i];
+        return Circle{scene.worldX(i), scene.worldY(i), b.hasRings ? b.ringRadius() + b.ringThickness() : b.radius};
+    });
+    const grav::CircleBvh::Box view{(screen.left - scene.panX()) / zoom, (screen.top - scene.panY()) / zoom,
+                                    (screen.left + screen.width - scene.panX()) / zoom,
+                                    (screen.top + screen.height - scene.panY()) / zoom};
+
+    // Visible bodies go out in scene order, so moons still cover their planets
+    culling.visible.clear();
+    culling.tree.query(view, 2.f / zoom, [&](std::uint32_t i) { culling.visible.push_back(i); },
+                           [&](float x, float y, std::uint32_t first, std::uint32_t n) {
+                               sf::Color color = bodies[culling.tree.item(first)].color;
+                               color.a = std::uint8_t(std::min(255u, 64u + 16u * n));
+                               bodyLayer.addPoint(sf::Vector2f(x * zoom + scene.panX(), y * zoom + scene.panY()), color,
+                                                  2.f);
+                           });
+    std::sort(culling.visible.begin(), culling.visible.end());
+    for (std::uint32_t i : culling.visible) {
+        const CelestialBody& b = bodies[i];
+        const sf::Vector2f screenPos(scene.screenX(i), scene.screenY(i));
+        if (b.hasRings && b.ringRadius() * zoom >= 1.f)
+            ringLayer.addRing(screenPos, b.ringRadius() * zoom, b.ringThickness() * zoom, sf::Color(200, 180, 100, 150));
+        if (b.radius * zoom >= 1.f) bodyLayer.addDisc(screenPos, b.radius * zoom, b.color);
+        else bodyLayer.addPoint(screenPos, b.color);
     }
+}
 
-    void draw(sf::RenderWindow& window, float zoom, const sf::Vector2f& panOffset) const {
-        // Draw orbit ring around parent
-        if (parent != nullptr) {
-            sf::CircleShape orbitRing(orbitRadius * zoom);
-            orbitRing.setOrigin(orbitRadius * zoom, orbitRadius * zoom);
-            orbitRing.setPosition(parent->position * zoom + panOffset);
-            orbitRing.setFillColor(sf::Color::Transparent);
-            orbitRing.setOutlineColor(sf::Color(100, 100, 100, 100));
-            orbitRing.setOutlineThickness(1.f);
-            window.draw(orbitRing);
+int main(int argc, char** argv) {
+    const grav::HeadlessOptions headless = grav::parseHeadless(argc, argv);
+    const grav::ProfileOptions profile = grav::parseProfile(argc, argv);
+    const grav::CheckpointOptions checkpoint = grav::parseCheckpoint(argc, argv);
+    const grav::TrajectoryOptions trajectory = grav::parseTrajectory(argc, argv);
+
+    // --integrator picks the N-body integrator, --dt its (largest) step in days,
+    // --forces the force backend; --bench-forces compares the backends and exits
+    grav::Integrator integrator = grav::Integrator::Leapfrog;
+    grav::ForceBackend forces = grav::ForceBackend::BarnesHut;
+    bool benchForces = false;
+    for (int i = 1; i < argc; ++i)
+        if (std::string(argv[i]) == "--bench-forces") benchForces = true;
+    double stepDays = 0.002;            // leapfrog needs this to resolve Phobos' 7.6 hour orbit
+    for (int i = 1; i + 1 < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--integrator" && !grav::parseIntegrator(argv[i + 1], integrator)) {
+            std::cerr << "Unknown integrator " << argv[i + 1] << " (leapfrog, yoshida4, rk45, hermite4)\n";
+            return 1;
+        }
+        if (arg == "--forces" && !grav::parseForceBackend(argv[i + 1], forces)) {
+            std::cerr << "Unknown force backend " << argv[i + 1] << " (direct, barnes-hut, fmm)\n";
+            return 1;
         }
+        if (arg == "--dt") stepDays = std::strtod(argv[i + 1], nullptr);
+    }
 
-        // Draw rings if any
-        if (hasRings) {
-            sf::CircleShape ringDraw = ring;
-            ringDraw.setScale(zoom, zoom);
-            ringDraw.move(panOffset);
-            window.draw(ringDraw);
+    // --scenario picks the bodies. Body i of the file is body i of the simulation.
+    const std::string scenarioPath = grav::parseScenario(argc, argv, "../scenarios/solar_system_moons.txt");
+    grav::Scenario scenario;
+    std::string error;
+    if (!grav::loadScenario(scenarioPath, scenario, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    const std::size_t count = scenario.size();
+
+    // N-body initial conditions, in screen pixels and days. The Sun's GM is
+    // chosen so that Earth's drawn orbit is also its true one; masses are in
+    // solar masses. A scenario that gives x, y, vx and vy starts every body
+    // there instead and its masses are taken as GM.
+    const double gmSun = 4.0 * PI * PI * 130.0 * 130.0 * 130.0 / (365.25 * 365.25);
+    SolarSystem sim;
+    sim.tree.theta = 0.3;
+    sim.integrator = integrator;
+    sim.forces = forces;
+    std::vector<double> displayScale(count, 1.0);
+    if (scenario.has(grav::Scenario::X)) {
+        sim.bodies = scenario.state;
+    } else {
+        sim.bodies.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+            displayScale[i] = addToSimulation(sim, scenario, i, gmSun);
+    }
+    sim.moveToCenterOfMass();
+    sim.init();
+
+    // --restart continues a checkpointed run; the scenario must be the same one
+    if (!checkpoint.restart.empty()) {
+        if (!sim.restore(checkpoint.restart) || sim.bodies.size() != count) {
+            std::cerr << "Cannot restart from " << checkpoint.restart << "\n";
+            return 1;
         }
+        integrator = sim.integrator;
+        std::clog << "restarted from " << checkpoint.restart << " at step " << sim.steps << ", day " << sim.time << "\n";
+    }
 
-        sf::CircleShape shapeDraw = shape;
-        shapeDraw.setScale(zoom, zoom);
-        shapeDraw.move(panOffset);
-        window.draw(shapeDraw);
+    if (benchForces) {
+        grav::ForceBenchOptions opt;
+        opt.theta = sim.tree.theta;
+        std::cout.precision(3);
+        grav::printForceBenchHeader(std::cout);
+        grav::benchForceBackends("solorsystem06", sim.bodies, sim.G, sim.tree.softening, opt, std::cout);
+        return 0;
+    }
 
-        // Draw moons recursively
-        for (const auto& moon : moons)
-            moon.draw(window, zoom, panOffset);
+    std::clog << grav::integratorName(integrator) << " integrator, step " << stepDays << " days, "
+              << grav::forceBackendName(forces) << " forces\n";
+
+    // --trajectory logs every body's state from the physics thread; declared
+    // before the thread so the file is closed after the last step
+    grav::TrajectoryWriter trajectoryLog;
+    if (trajectory.enabled() &&
+        !trajectoryLog.open(trajectory.path, sim.bodies.size(), trajectory.fields({"x", "y", "vx", "vy"}))) {
+        std::cerr << "Cannot write trajectory " << trajectory.path << "\n";
+        return 1;
     }
-};
 
-int main() {
+    // The I key cycles the integrator; the physics thread picks it up before its next step
+    grav::TripleBuffer<grav::Integrator> integratorControl(integrator);
+    auto step = [&](double dt) {
+        integratorControl.update();
+        sim.integrator = integratorControl.read();
+        sim.step(dt);
+        if (checkpoint.due(sim.steps) && !sim.save(checkpoint.path, "length=px time=day mass=GM G=1"))
+            std::cerr << "Failed to write checkpoint " << checkpoint.path << "\n";
+        if (trajectory.due(sim.steps)) {
+            const auto& b = sim.bodies;
+            trajectoryLog.append(sim.time, {b.pos[0].data(), b.pos[1].data(), b.vel[0].data(), b.vel[1].data()});
+        }
+    };
+
+    if (headless.enabled)
+        return grav::runHeadless("solar_system_full", headless, stepDays, sim.bodies.size(), step, [&](std::ostream& os) {
+            const auto& b = sim.bodies;
+            os << "forces " << sim.forceEvaluations << "\n";
+            for (std::size_t i = 0; i < b.size(); ++i)
+                os << "body " << i << " " << b.pos[0][i] << " " << b.pos[1][i] << " "
+                   << b.vel[0][i] << " " << b.vel[1][i] << "\n";
+        });
+
     sf::RenderWindow window(sf::VideoMode(1400, 1000), "Solar System Clean");
     window.setFramerateLimit(60);
 
     sf::Vector2f sunPos(window.getSize().x / 2.f, window.getSize().y / 2.f);
+    grav::SceneGraph scene;
+    const std::vector<CelestialBody> bodies = buildScene(scenario, displayScale, scene);
 
-    CelestialBody sun{
-        30.f, 0.f, 0.f,
-        sf::Color::Yellow,
-        0.f,
-        sunPos,
-        sf::CircleShape(), sf::CircleShape(), false,
-        nullptr,
-        {}
-    };
-    sun.init();
-
-    auto makeMoon = [](float radius, float orbitR, float period, sf::Color c, float initialAngle = 0.f) {
-        CelestialBody moon{radius, orbitR, period, c, initialAngle};
-        moon.parent = nullptr;
-        moon.init();
-        return moon;
-    };
+    // The N-body system belongs to the physics thread from here on
+    grav::PhysicsThread<Snapshot> physics(stepDays, step,
+        [&](Snapshot& out) {
+            out.x = sim.bodies.pos[0];
+            out.y = sim.bodies.pos[1];
+        });
 
-    std::vector<CelestialBody> planets = {
-        {6.f, 60.f, 0.24f, sf::Color(200, 200, 200), 0.1f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-        {9.f, 90.f, 0.62f, sf::Color(255, 165, 0), 0.5f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-        {10.f, 130.f, 1.00f, sf::Color::Blue, 1.0f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {
-            {3.f, 20.f, 27.3f, sf::Color(150,150,150), 0.f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}}
-        }},
-        {8.f, 170.f, 1.88f, sf::Color(255, 80, 80), 1.8f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {
-            {2.f, 15.f, 0.319f, sf::Color(160,160,160), 0.3f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-            {2.f, 22.f, 1.263f, sf::Color(180,180,180), 0.6f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}}
-        }},
-        {25.f, 220.f, 11.86f, sf::Color(255, 200, 150), 3.0f, {}, sf::CircleShape(), sf::CircleShape(), true, nullptr, {
-            {4.f, 30.f, 1.77f, sf::Color(255, 200, 100), 0.1f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-            {4.f, 38.f, 3.55f, sf::Color(180, 180, 220), 0.3f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-            {5.f, 46.f, 7.15f, sf::Color(150, 150, 200), 0.5f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-            {5.f, 54.f, 16.7f, sf::Color(140, 140, 160), 0.7f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}}
-        }},
-        {22.f, 280.f, 29.45f, sf::Color(255, 230, 150), 5.0f, {}, sf::CircleShape(), sf::CircleShape(), true, nullptr, {
-            {5.f, 30.f, 15.95f, sf::Color(230, 200, 150), 0.2f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-            {4.f, 40.f, 4.52f, sf::Color(220, 210, 200), 0.5f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-            {4.f, 48.f, 79.3f, sf::Color(200, 190, 180), 0.7f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}}
-        }},
-        {18.f, 340.f, 84.02f, sf::Color(150, 255, 255), 7.0f, {}, sf::CircleShape(), sf::CircleShape(), true, nullptr, {
-            {3.f, 22.f, 1.41f, sf::Color(180, 200, 200), 0.3f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-            {4.f, 30.f, 2.52f, sf::Color(160, 190, 190), 0.6f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}},
-            {4.f, 38.f, 4.14f, sf::Color(140, 170, 170), 0.9f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}}
-        }},
-        {17.f, 390.f, 164.8f, sf::Color(100, 150, 255), 8.0f, {}, sf::CircleShape(), sf::CircleShape(), true, nullptr, {
-            {5.f, 28.f, 5.88f, sf::Color(120, 170, 210), 0.4f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}}
-        }},
-        {5.f, 430.f, 248.0f, sf::Color(180, 180, 200), 9.0f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {
-            {3.f, 20.f, 6.39f, sf::Color(160, 160, 180), 0.1f, {}, sf::CircleShape(), sf::CircleShape(), false, nullptr, {}}
-        }}
-    };
-
-    for (auto& planet : planets) {
-        planet.parent = &sun;
-        planet.init();
-        for (auto& moon : planet.moons)
-            moon.parent = &planet;
+    float simulationSpeed = 1.0f; // days per second
+    physics.setRate(simulationSpeed / stepDays);
+    physics.start();
+    Snapshot shown;
+    grav::CircleBatch ringLayer, bodyLayer;
+    SceneCulling culling;
+    OrbitRings orbitRings;
+    buildOrbitRings(scene, bodies, orbitRings);
+
+    // Speed info text, loaded once; the HUD is optional if the font is missing
+    const sf::Font* font = grav::AssetCache::instance().font("/usr/share/fonts/truetype/dejavu/DejaVuSans-Bold.ttf");
+    grav::AssetCache::instance().report(std::clog);
+    sf::Text speedText;
+    float shownSpeed = 0.f;
+    grav::Integrator shownIntegrator = integrator;
+    if (font) {
+        speedText.setFont(*font);
+        speedText.setCharacterSize(18);
+        speedText.setFillColor(sf::Color::White);
+        speedText.setPosition(10, 10);
     }
 
-    float simulationSpeed = 1.0f; // days per second
     float zoom = 1.0f;
     sf::Vector2f panOffset(0.f, 0.f);
 
-    sf::Clock clock;
     bool dragging = false;
     sf::Vector2i dragStart;
     sf::Vector2f panStart;
+    profile.apply();
+    grav::ProfilerOverlay overlay(profile.overlay);
 
     while (window.isOpen()) {
+        grav::ProfilePhases phase("events");
         sf::Event event;
         while (window.pollEvent(event)) {
+            overlay.handle(event);
             if (event.type == sf::Event::Closed)
                 window.close();
 
@@ -190,6 +346,12 @@ int main() {
                 if (event.key.code == sf::Keyboard::Down) simulationSpeed /= 1.2f;
                 if (simulationSpeed < 0.01f) simulationSpeed = 0.01f;
                 if (simulationSpeed > 100.f) simulationSpeed = 100.f;
+                physics.setRate(simulationSpeed / stepDays);
+                if (event.key.code == sf::Keyboard::I) {
+                    integrator = grav::Integrator((int(integrator) + 1) % 4);
+                    integratorControl.write() = integrator;
+                    integratorControl.publish();
+                }
             }
         }
 
@@ -199,38 +361,55 @@ int main() {
             panOffset = panStart + sf::Vector2f(delta.x, delta.y);
         }
 
-        float dt = clock.restart().asSeconds();
-        static float elapsedDays = 0.f;
-        elapsedDays += dt * simulationSpeed;
+        // Blend the two latest physics snapshots
+        phase.next("scene");
+        physics.poll();
+        const Snapshot& prev = physics.previous().state;
+        const Snapshot& curr = physics.current().state;
+        const double t = physics.alpha();
+        shown.x.resize(curr.x.size());
+        shown.y.resize(curr.y.size());
+        for (std::size_t i = 0; i < curr.x.size(); ++i) {
+            shown.x[i] = prev.x[i] + (curr.x[i] - prev.x[i]) * t;
+            shown.y[i] = prev.y[i] + (curr.y[i] - prev.y[i]) * t;
+        }
 
         window.clear(sf::Color::Black);
 
-        // Draw Sun at center + pan + zoom
-        sf::Vector2f sunScreenPos = sunPos * zoom + panOffset;
-        sun.shape.setPosition(sunScreenPos);
-        sun.shape.setScale(zoom, zoom);
-        window.draw(sun.shape);
-
-        // Draw planet orbits + planets + moons
-        for (auto& planet : planets) {
-            planet.updatePosition(sunScreenPos, elapsedDays);
-            planet.draw(window, zoom, panOffset);
+        // Batch the Sun, planets and moons, one draw call per layer; the orbit
+        // rings are already on the GPU and only need moving with their centres
+        ringLayer.clear();
+        bodyLayer.clear();
+        placeBodies(scene, bodies, shown, sunPos);
+        scene.setView(zoom, panOffset.x, panOffset.y);
+        scene.update();
+        const sf::FloatRect screen(0.f, 0.f, float(window.getSize().x), float(window.getSize().y));
+        batchBodies(scene, bodies, culling, screen, ringLayer, bodyLayer);
+        for (std::size_t g = 0; g < orbitRings.groupCentre.size(); ++g) {
+            const std::uint32_t c = orbitRings.groupCentre[g];
+            orbitRings.paths.setCentre(g, sf::Vector2f(scene.worldX(c), scene.worldY(c)));
         }
-
-        // Show simulation speed info (optional)
-        sf::Font font;
-        if (font.loadFromFile("/usr/share/fonts/truetype/dejavu/DejaVuSans-Bold.ttf")) {
-            sf::Text speedText;
-            speedText.setFont(font);
-            speedText.setCharacterSize(18);
-            speedText.setFillColor(sf::Color::White);
-            speedText.setPosition(10, 10);
-            speedText.setString("Speed (Up/Down): " + std::to_string(simulationSpeed) + " days/sec\n"
-                                "Mouse drag to pan\nMouse wheel to zoom");
+        phase.next("draw");
+        orbitRings.paths.draw(window, zoom, panOffset);
+        ringLayer.draw(window);
+        bodyLayer.draw(window);
+
+        // Show simulation speed info (optional); the text only changes with the settings
+        if (font) {
+            if (simulationSpeed != shownSpeed || integrator != shownIntegrator) {
+                shownSpeed = simulationSpeed;
+                shownIntegrator = integrator;
+                speedText.setString("Speed (Up/Down): " + std::to_string(simulationSpeed) + " days/sec\n"
+                                    "Integrator (I): " + grav::integratorName(integrator) + "\n"
+                                    "Mouse drag to pan\nMouse wheel to zoom");
+            }
             window.draw(speedText);
         }
 
+        phase.next("display");
+        overlay.draw(window);
         window.display();
     }
+    profile.writeTrace(std::clog);
     return 0;
 }
@@ -1,14 +1,36 @@
 #include <SFML/Graphics.hpp>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 
+#include "../common/asset_cache.hpp"
+#include "../common/circle_batch.hpp"
+#include "../common/headless.hpp"
+#include "../common/kepler.hpp"
+#include "../common/physics_thread.hpp"
+#include "../common/trajectory.hpp"
+#include "../common/profiler_overlay.hpp"
+#include "../common/triple_buffer.hpp"
+
 constexpr float PI = 3.14159265f;
-constexpr float TWO_PI = 2.f * PI;
 constexpr float EARTH_YEAR_DAYS = 365.25f;
 constexpr float LUNAR_MONTH_DAYS = 29.53f; // Moon cycle approx
 constexpr float FPS = 60.f;
+constexpr double PHYSICS_DT = 0.001; // seconds per physics step (1000 Hz)
+
+// Speed controls from the render thread
+struct Controls {
+    float targetSpeed = 1.f;
+    bool paused = false;
+};
+
+// Simulation clock handed to the renderer
+struct Snapshot {
+    double simDays = 0.0;
+    float speed = 1.f;
+};
 
 struct ClockDisplay {
     int year=0, day=0, hour=0, minute=0;
@@ -41,10 +63,22 @@ struct Celestial {
     }
     void setPos(sf::Vector2f p) { shape.setPosition(p); }
     sf::Vector2f getPos() const { return shape.getPosition(); }
+
+    // Just enough outline points for the size the body is drawn at
+    void setDetail(float zoom) {
+        const unsigned points = grav::CircleBatch::segmentsFor(radius * zoom);
+        if (points != shape.getPointCount()) shape.setPointCount(points);
+    }
 };
 
-void drawTerminator(sf::RenderWindow& w, sf::Vector2f pos, float R, float angle) {
-    int SEG = 60;
+// Whether anything within r of c can show in the view
+bool inView(const sf::View& view, sf::Vector2f c, float r) {
+    const sf::Vector2f half = view.getSize() / 2.f;
+    const sf::Vector2f d = c - view.getCenter();
+    return std::abs(d.x) <= half.x + r && std::abs(d.y) <= half.y + r;
+}
+
+void drawTerminator(sf::RenderWindow& w, sf::Vector2f pos, float R, float angle, int SEG) {
     sf::VertexArray fan(sf::TriangleFan, SEG+2);
     fan[0] = {pos, sf::Color::Transparent};
     for(int i=0; i<=SEG; i++) {
@@ -144,24 +178,93 @@ void drawMoonShadowOnEarth(sf::RenderWindow& w, sf::Vector2f sunPos, sf::Vector2
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    const grav::HeadlessOptions headless = grav::parseHeadless(argc, argv);
+    const grav::ProfileOptions profile = grav::parseProfile(argc, argv);
+    const grav::TrajectoryOptions trajectory = grav::parseTrajectory(argc, argv);
+
+    double simDays = 0.0;
+    float speed = 1.f;
+    float targetSpeed = 1.f;
+    bool paused = false;
+
+    // Earth around the Sun and the Moon around the Earth on fixed ellipses
+    // (common/kepler.hpp), in screen pixels and days. The eccentricities and the
+    // Moon's 5.1 degree tilt are the real ones; the sizes are not.
+    grav::KeplerOrbits orbits;
+    orbits.add(220.0, 0.0167, EARTH_YEAR_DAYS, 0.0);
+    orbits.add(50.0, 0.0549, LUNAR_MONTH_DAYS, 0.0, 0.0898);
+
+    // --trajectory logs Earth and Moon around the Sun in screen pixels, time in
+    // days, from the physics thread's own copy of the orbits. The velocities
+    // (px/day) are the exact derivative of the ellipses.
+    grav::TrajectoryWriter trajectoryLog;
+    if (trajectory.enabled() && !trajectoryLog.open(trajectory.path, 2, trajectory.fields({"x", "y", "vx", "vy"}))) {
+        std::cerr << "Cannot write trajectory " << trajectory.path << "\n";
+        return 1;
+    }
+    std::uint64_t steps = 0;
+    grav::KeplerOrbits logOrbits = orbits;
+    logOrbits.velocities = true;
+    auto logState = [&] {
+        logOrbits.propagate(simDays);
+        const auto& o = logOrbits;
+        const double x[2] = {o.x[0], o.x[0] + o.x[1]}, y[2] = {o.y[0], o.y[0] + o.y[1]};
+        const double vx[2] = {o.vx[0], o.vx[0] + o.vx[1]}, vy[2] = {o.vy[0], o.vy[0] + o.vy[1]};
+        trajectoryLog.append(simDays, {x, y, vx, vy});
+    };
+
+    grav::TripleBuffer<Controls> controls;
+    auto step = [&](double h) {
+        float dt = float(h);
+        controls.update();
+        const Controls& in = controls.read();
+
+        speed += (in.targetSpeed - speed) * dt * 5.f;
+
+        if(in.paused) dt = 0.f;
+
+        simDays += dt * FPS * speed;
+        if (trajectory.due(++steps)) logState();
+    };
+
+    if (headless.enabled)
+        return grav::runHeadless("sun_earth_moon", headless, PHYSICS_DT, 2, step, [&](std::ostream& os) {
+            orbits.propagate(simDays);
+            os << "days " << simDays << " speed " << speed << "\n"
+               << "earth " << orbits.x[0] << " " << orbits.y[0] << "\n"
+               << "moon " << orbits.x[1] << " " << orbits.y[1] << "\n";
+        });
+
     sf::RenderWindow window(sf::VideoMode(900, 600), "Sun-Earth-Moon Simulation");
     window.setFramerateLimit(60);
 
-    sf::Font font;
-    if (!font.loadFromFile("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf")) {
+    const sf::Font* font = grav::AssetCache::instance().font("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf");
+    if (!font) {
         std::cerr << "Failed to load font\n";
         return -1;
     }
+    grav::AssetCache::instance().report(std::clog);
+
+    // HUD text is set up once and only re-laid out when its string changes
+    sf::Text hudText;
+    hudText.setFont(*font);
+    hudText.setCharacterSize(16);
+    hudText.setFillColor(sf::Color::White);
+    hudText.setPosition(10.f, 10.f);
+    std::string hudString;
 
     Celestial sun(50.f, sf::Color(255, 255, 100));
     Celestial earth(20.f, sf::Color(100, 150, 255));
     Celestial moon(8.f, sf::Color(200, 200, 200));
 
-    float simDays = 0.f;
-    float speed = 1.f;
-    float targetSpeed = 1.f;
-    bool paused = false;
+    grav::PhysicsThread<Snapshot> physics(PHYSICS_DT, step,
+        [&](Snapshot& out) {
+            out.simDays = simDays;
+            out.speed = speed;
+        });
+    physics.setRate(1.0 / PHYSICS_DT);
+    physics.start();
 
     sf::Vector2f pan(0.f,0.f);
     float zoom = 1.f;
@@ -171,13 +274,15 @@ int main() {
 
     ClockDisplay clockDisp;
 
-    sf::Clock deltaClock;
-
     sf::Vector2f center(450, 300);
+    profile.apply();
+    grav::ProfilerOverlay overlay(profile.overlay);
 
     while(window.isOpen()) {
+        grav::ProfilePhases phase("events");
         sf::Event event;
         while(window.pollEvent(event)) {
+            overlay.handle(event);
             if(event.type == sf::Event::Closed) window.close();
 
             if(event.type == sf::Event::MouseWheelScrolled) {
@@ -213,21 +318,25 @@ int main() {
             pan = panStart + sf::Vector2f(mp - dragStart);
         }
 
-        float dt = deltaClock.restart().asSeconds();
-
-        speed += (targetSpeed - speed) * dt * 5.f;
-
-        if(paused) dt = 0.f;
-
-        simDays += dt * FPS * speed;
-
-        // Calculate positions
-        float earthAngle = TWO_PI * (simDays / EARTH_YEAR_DAYS);
-        sf::Vector2f earthPos = center + sf::Vector2f(std::cos(earthAngle), std::sin(earthAngle)) * 220.f;
+        controls.write() = Controls{targetSpeed, paused};
+        controls.publish();
+
+        // Blend the two latest physics snapshots
+        phase.next("scene");
+        physics.poll();
+        const Snapshot& prev = physics.previous().state;
+        const Snapshot& curr = physics.current().state;
+        const double t = physics.alpha();
+        const float shownDays = float(prev.simDays + (curr.simDays - prev.simDays) * t);
+        const float shownSpeed = curr.speed;
+
+        // Calculate positions; the Moon's tilt only shows as a slightly flattened orbit
+        orbits.propagate(prev.simDays + (curr.simDays - prev.simDays) * t);
+        float earthAngle = std::atan2(orbits.y[0], orbits.x[0]);
+        sf::Vector2f earthPos = center + sf::Vector2f(orbits.x[0], orbits.y[0]);
         earth.setPos(earthPos);
 
-        float moonAngle = TWO_PI * (simDays / LUNAR_MONTH_DAYS);
-        sf::Vector2f moonPos = earthPos + sf::Vector2f(std::cos(moonAngle), std::sin(moonAngle)) * 50.f;
+        sf::Vector2f moonPos = earthPos + sf::Vector2f(orbits.x[1], orbits.y[1]);
         moon.setPos(moonPos);
 
         window.clear(sf::Color(10,10,20));
@@ -237,25 +346,39 @@ int main() {
         view.setSize(window.getSize().x / zoom, window.getSize().y / zoom);
         window.setView(view);
 
+        // Only what the view shows is drawn, with as much detail as its size on
+        // screen needs; a body under a pixel is drawn without its shading
+        for (Celestial* body : {&sun, &earth, &moon}) body->setDetail(zoom);
+        const bool earthShows = inView(view, earthPos, earth.radius * 2.f);
+        const bool earthShaded = earthShows && earth.radius * zoom >= 1.f;
+
         sun.setPos(center);
-        window.draw(sun.shape);
+        if (inView(view, center, sun.radius))
+            window.draw(sun.shape);
 
-        drawSunBeam(window, center, earthPos);
+        const sf::Vector2f beamMid = (center + earthPos) / 2.f;
+        if (inView(view, beamMid, std::hypot(earthPos.x - beamMid.x, earthPos.y - beamMid.y) + 40.f))
+            drawSunBeam(window, center, earthPos);
 
-        drawEarthShadow(window, earthPos, earth.radius);
+        if (earthShaded) {
+            drawEarthShadow(window, earthPos, earth.radius);
 
-        drawTerminator(window, earthPos, earth.radius, earthAngle);
+            drawTerminator(window, earthPos, earth.radius, earthAngle,
+                           int(std::max(2u, grav::CircleBatch::segmentsFor(earth.radius * zoom) / 2)));
 
-        sf::CircleShape glow(earth.radius + 4.f);
-        glow.setOrigin(earth.radius + 4.f, earth.radius + 4.f);
-        glow.setPosition(earthPos);
-        glow.setFillColor(sf::Color(50, 100, 255, 50));
-        window.draw(glow);
+            sf::CircleShape glow(earth.radius + 4.f, earth.shape.getPointCount());
+            glow.setOrigin(earth.radius + 4.f, earth.radius + 4.f);
+            glow.setPosition(earthPos);
+            glow.setFillColor(sf::Color(50, 100, 255, 50));
+            window.draw(glow);
+        }
 
-        window.draw(earth.shape);
+        if (earthShows)
+            window.draw(earth.shape);
 
         // Draw Moon shadow on Earth (solar eclipse)
-        drawMoonShadowOnEarth(window, center, earthPos, earth.radius, moonPos, moon.radius);
+        if (earthShaded)
+            drawMoonShadowOnEarth(window, center, earthPos, earth.radius, moonPos, moon.radius);
 
         // Lunar eclipse detection (moon in Earth's shadow cone)
         bool inEclipse = false;
@@ -268,37 +391,41 @@ int main() {
         if (proj > 0 && proj < 50 && dist < earth.radius*0.7f)
             inEclipse = true;
 
-        if (inEclipse) {
-            sf::CircleShape bloodMoon(moon.radius);
-            bloodMoon.setOrigin(moon.radius, moon.radius);
-            bloodMoon.setPosition(moonPos);
-            bloodMoon.setFillColor(sf::Color(120, 20, 20, 200));
-            window.draw(bloodMoon);
-        } else {
-            drawMoon(window, moonPos, moon.radius, center);
+        const bool moonShows = inView(view, moonPos, moon.radius);
+        if (moonShows && moon.radius * zoom >= 1.f) {
+            if (inEclipse) {
+                sf::CircleShape bloodMoon(moon.radius, moon.shape.getPointCount());
+                bloodMoon.setOrigin(moon.radius, moon.radius);
+                bloodMoon.setPosition(moonPos);
+                bloodMoon.setFillColor(sf::Color(120, 20, 20, 200));
+                window.draw(bloodMoon);
+            } else {
+                drawMoon(window, moonPos, moon.radius, center);
+            }
         }
 
-        window.draw(moon.shape);
+        if (moonShows)
+            window.draw(moon.shape);
 
         window.setView(window.getDefaultView());
 
-        sf::Text hudText;
-        hudText.setFont(font);
-        hudText.setCharacterSize(16);
-        hudText.setFillColor(sf::Color::White);
-        hudText.setPosition(10.f, 10.f);
-
-        clockDisp.update(simDays);
+        clockDisp.update(shownDays);
         std::ostringstream hudStream;
         hudStream << "Simulation Time: " << clockDisp.str() << "\n";
-        hudStream << "Speed: " << std::fixed << std::setprecision(2) << speed << "x " << (paused ? "(Paused)" : "") << "\n";
+        hudStream << "Speed: " << std::fixed << std::setprecision(2) << shownSpeed << "x " << (paused ? "(Paused)" : "") << "\n";
         hudStream << "Controls:\n - Arrow Up/Down: Speed\n - Space: Pause\n - Mouse Drag: Pan\n - Mouse Wheel: Zoom\n";
-        hudText.setString(hudStream.str());
+        if (hudStream.str() != hudString) {
+            hudString = hudStream.str();
+            hudText.setString(hudString);
+        }
 
         window.draw(hudText);
 
+        phase.next("display");
+        overlay.draw(window);
         window.display();
     }
 
+    profile.writeTrace(std::clog);
     return 0;
 }
@@ -0,0 +1,108 @@
+// Scenario files (common/scenario.hpp): prints what a file holds and how long
+// it takes to load, converts between the text and binary forms, and generates
+// large disk scenarios for benchmarking.
+//
+//   g++ -O2 tools/scenario_tool.cpp -o tools/scenario_tool
+//   ./tools/scenario_tool info FILE
+//   ./tools/scenario_tool convert IN OUT        OUT ending in .txt is text, anything else binary
+//   ./tools/scenario_tool disk N OUT [--seed S] a central mass and N - 1 stars on circular orbits
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../common/scenario.hpp"
+
+namespace {
+
+constexpr double PI = 3.14159265358979;
+
+bool isText(const std::string& path) {
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".txt") == 0;
+}
+
+bool load(const std::string& path, grav::Scenario& sc, double* ms = nullptr) {
+    const auto t0 = std::chrono::steady_clock::now();
+    std::string error;
+    if (!grav::loadScenario(path, sc, error)) {
+        std::cerr << error << "\n";
+        return false;
+    }
+    if (ms) *ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return true;
+}
+
+bool save(const std::string& path, const grav::Scenario& sc) {
+    if (isText(path) ? grav::writeScenarioText(path, sc) : grav::writeScenarioBinary(path, sc)) return true;
+    std::cerr << "Cannot write " << path << "\n";
+    return false;
+}
+
+// Equal-mass stars uniform over an annulus of radius 150..300 around a body
+// as heavy as all of them together, each on the circular orbit of the central
+// mass plus the stars inside it; G = 1.
+grav::Scenario disk(std::size_t n, std::uint64_t seed) {
+    std::uint64_t state = seed;
+    auto next = [&] {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return double(state >> 11) * (1.0 / 9007199254740992.0);
+    };
+    grav::Scenario sc;
+    sc.title = "Disk of " + std::to_string(n) + " bodies";
+    sc.units = "G=1";
+    sc.columns = 1u << grav::Scenario::Mass | 1u << grav::Scenario::X | 1u << grav::Scenario::Y |
+                 1u << grav::Scenario::VX | 1u << grav::Scenario::VY;
+    sc.reserve(n);
+    if (n == 0) return sc;
+    sc.add();
+    sc.state.mass[0] = 1.0;
+    const double star = 1.0 / double(n > 1 ? n - 1 : 1);
+    for (std::size_t i = 1; i < n; ++i) {
+        const double u = next();
+        const double r = std::sqrt(150.0 * 150.0 + u * (300.0 * 300.0 - 150.0 * 150.0));
+        const double a = 2.0 * PI * next();
+        const double v = std::sqrt((1.0 + u) / r);
+        const std::size_t b = sc.add();
+        sc.state.mass[b] = star;
+        sc.state.pos[0][b] = r * std::cos(a);
+        sc.state.pos[1][b] = r * std::sin(a);
+        sc.state.vel[0][b] = -v * std::sin(a);
+        sc.state.vel[1][b] = v * std::cos(a);
+    }
+    return sc;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string command = argc > 1 ? argv[1] : "";
+    if (command == "info" && argc == 3) {
+        grav::Scenario sc;
+        double ms = 0.0;
+        if (!load(argv[2], sc, &ms)) return 1;
+        std::cout << "scenario \"" << sc.title << "\"  units \"" << sc.units << "\"  bodies " << sc.size()
+                  << "  loaded in " << ms << " ms\ncolumns ";
+        for (std::uint32_t c = 0; c < grav::Scenario::COLUMN_COUNT; ++c)
+            if (sc.has(grav::Scenario::Column(c))) std::cout << " " << grav::Scenario::columnName(grav::Scenario::Column(c));
+        std::size_t roots = 0;
+        for (std::size_t i = 0; i < sc.size(); ++i) roots += sc.parent[i] == grav::Scenario::NO_PARENT;
+        std::cout << "\nroots " << roots << "\n";
+        return 0;
+    }
+    if (command == "convert" && argc == 4) {
+        grav::Scenario sc;
+        return load(argv[2], sc) && save(argv[3], sc) ? 0 : 1;
+    }
+    if (command == "disk" && argc >= 4) {
+        std::uint64_t seed = 1;
+        for (int i = 4; i + 1 < argc; ++i)
+            if (std::string(argv[i]) == "--seed") seed = std::strtoull(argv[i + 1], nullptr, 10);
+        return save(argv[3], disk(std::strtoull(argv[2], nullptr, 10), seed)) ? 0 : 1;
+    }
+    std::cerr << "usage: scenario_tool info FILE\n"
+                 "       scenario_tool convert IN OUT\n"
+                 "       scenario_tool disk N OUT [--seed S]\n";
+    return 1;
+}
@@ -0,0 +1,59 @@
+// Prints a snapshot's header and, for every column, its type, length and
+// value range. The file is memory-mapped, so only the columns asked about are
+// read from disk.
+//
+//   g++ -O2 tools/snapshot_info.cpp -o tools/snapshot_info
+//   ./tools/snapshot_info checkpoint.snap [column ...]
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../common/snapshot.hpp"
+
+namespace {
+
+template <typename T>
+bool printRange(const grav::SnapshotFile& file, const std::string& name, const char* type) {
+    std::size_t n = 0;
+    const T* values = file.column<T>(name, &n);
+    if (!values) return false;
+    std::cout << std::left << std::setw(20) << name << std::setw(6) << type << std::setw(12) << n;
+    if (n > 0) {
+        const auto range = std::minmax_element(values, values + n);
+        std::cout << +*range.first << " .. " << +*range.second;
+    }
+    std::cout << "\n";
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: snapshot_info FILE [column ...]\n";
+        return 1;
+    }
+    grav::SnapshotFile file(argv[1]);
+    if (!file.isOpen()) {
+        std::cerr << "Not a snapshot: " << argv[1] << "\n";
+        return 1;
+    }
+    const grav::SnapshotInfo& info = file.info();
+    std::cout << "bodies " << info.count << "  step " << info.step << "  time " << info.time << "  integrator "
+              << info.integrator << "  dims " << info.dims << "  units " << info.units << "\n";
+
+    std::vector<std::string> names(argv + 2, argv + argc);
+    if (names.empty()) names = file.columnNames();
+    std::cout.precision(9);
+    for (const std::string& name : names) {
+        if (!printRange<double>(file, name, "f64") && !printRange<float>(file, name, "f32") &&
+            !printRange<std::uint32_t>(file, name, "u32") && !printRange<std::uint64_t>(file, name, "u64") &&
+            !printRange<std::uint8_t>(file, name, "u8"))
+            std::cout << name << ": no such column\n";
+    }
+    return 0;
+}